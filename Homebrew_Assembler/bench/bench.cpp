@@ -0,0 +1,326 @@
+#include "assembler.h"
+#include "keyword.h"
+#include "parser.h"
+#include "symboltable.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Microbenchmarks of the assembler's hot paths -- the time and the heap allocations of one
+// operation, each measured over enough iterations to run for MEASURE_TIME.
+//
+//   hba_bench [filter] [code dir]
+//
+// Only the benchmarks whose name contains the filter are run. The architecture is read from the
+// code dir (the repository's code/ by default) and copied to a temp dir, so no roms are written
+// next to the sources.
+
+#ifndef HBA_CODE_DIR
+#define HBA_CODE_DIR "code"
+#endif
+
+static constexpr std::chrono::milliseconds MEASURE_TIME(200);
+static constexpr std::chrono::milliseconds CALIBRATE_TIME(20);
+
+// every heap allocation made by the process, including those of the standard library
+static std::atomic<uint64_t> allocations{ 0 };
+
+void* operator new(size_t n)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(n ? n : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t n)
+{
+	return operator new(n);
+}
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	return std::malloc(n ? n : 1);
+}
+
+void* operator new[](size_t n, const std::nothrow_t& t) noexcept
+{
+	return operator new(n, t);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// Keeps a result alive so the work that produced it is not optimized away
+static volatile uint64_t sink;
+
+template <typename T>
+static void keep(const T& value)
+{
+	sink = sink + static_cast<uint64_t>(value);
+}
+
+static void keep(std::string_view s)
+{
+	sink = sink + s.size();
+}
+
+class benchmarks
+{
+public:
+	explicit benchmarks(std::string_view filter) : _filter(filter)
+	{
+		std::printf("%-44s %12s %12s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op");
+	}
+
+	// body(n) runs the operation n times
+	template <typename Body>
+	void run(std::string_view name, Body body)
+	{
+		if (!_filter.empty() && name.find(_filter) == std::string_view::npos)
+			return;
+
+		using clock = std::chrono::steady_clock;
+
+		// find an iteration count that takes CALIBRATE_TIME, then scale it up to MEASURE_TIME
+		uint64_t n = 1;
+		clock::duration elapsed{};
+		for (;;)
+		{
+			const clock::time_point start = clock::now();
+			body(n);
+			elapsed = clock::now() - start;
+
+			if (elapsed >= CALIBRATE_TIME || n >= (uint64_t(1) << 40))
+				break;
+
+			n *= elapsed < CALIBRATE_TIME / 10 ? 10 : 2;
+		}
+
+		n = std::max<uint64_t>(1, static_cast<uint64_t>(double(n) * MEASURE_TIME / elapsed));
+
+		const uint64_t allocsBefore = allocations.load(std::memory_order_relaxed);
+		const clock::time_point start = clock::now();
+		body(n);
+		elapsed = clock::now() - start;
+		const uint64_t allocs = allocations.load(std::memory_order_relaxed) - allocsBefore;
+
+		const double ns = std::chrono::duration<double, std::nano>(elapsed).count() / double(n);
+		std::printf("%-44.*s %12llu %12.1f %12.2f\n", static_cast<int>(name.size()), name.data(),
+			static_cast<unsigned long long>(n), ns, double(allocs) / double(n));
+	}
+
+private:
+	std::string_view _filter;
+};
+
+static void parserBenchmarks(benchmarks& b)
+{
+	parser& p = parser::instance();
+	const std::string_view line = "loop:	mov [dx], a	; store the next character";
+	const std::string_view args = "a, [dx], #$1f, label+2";
+
+	b.run("parser::strip_comment", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+		{
+			std::string_view s = line;
+			p.strip_comment(s);
+			keep(s);
+		}
+	});
+
+	b.run("parser::extract_token_ws (whole line)", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+		{
+			std::string_view s = line;
+			while (auto token = p.extract_token_ws(s))
+				keep(token.value());
+		}
+	});
+
+	b.run("parser::extract_token_ws_comma (operands)", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+		{
+			std::string_view s = args;
+			while (auto token = p.extract_token_ws_comma(s))
+				keep(token.value());
+		}
+	});
+
+	b.run("parser::is_label", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+			keep(p.is_label((i & 1) ? "loop:" : "mov"));
+	});
+
+	const std::string_view literals[] = { "$1f", "%10100101", "1234", "0x7fff" };
+	b.run("parser::get_num_type + parse_literal", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+		{
+			std::string_view s = literals[i & 3];
+			const LiteralNumType type = p.get_num_type(s);
+
+			uint64_t value = 0;
+			if (p.parse_literal(s, type, value) == LiteralStatus::Ok)
+				keep(value);
+		}
+	});
+}
+
+static void keywordBenchmarks(benchmarks& b, assembler& a)
+{
+	const std::string_view tokens[] = { ".org", "seq", "mov", OPCODE_SEQ_IF_STR, ".include", "jnz", "opcode", "label:" };
+	b.run("keywords::classify", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+			keep(static_cast<int>(keywords::classify(tokens[i & 7])));
+	});
+
+	b.run("keywords::dispatch (.org)", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+			keywords::dispatch(a, Keyword::Origin, "$100", 1);
+	});
+}
+
+static void matcherBenchmarks(benchmarks& b, const architecture& arch)
+{
+	const std::string_view lines[][2] = { { "mov", "a, #$42" }, { "mov", "b, [dx]" }, { "jnz", "inner" }, { "dec", "c" } };
+	b.run("instructionMatcher::match", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+		{
+			instructionMatch m;
+			if (arch.matcher.match(lines[i & 3][0], lines[i & 3][1], m))
+				keep(m.value);
+		}
+	});
+}
+
+static void symbolBenchmarks(benchmarks& b)
+{
+	// the table is cleared every NAMES adds, like it is at the start of every assembly
+	constexpr size_t NAMES = 4096;
+	std::vector<std::string> names;
+	for (size_t i = 0; i < NAMES; i++)
+		names.push_back("label_" + std::to_string(i));
+
+	b.run("symbolTable::add (4096 then clear)", [&](uint64_t n)
+	{
+		symbolTable table;
+		for (uint64_t i = 0; i < n; i++)
+		{
+			if ((i % NAMES) == 0)
+				table.clear();
+
+			keep(table.add(names[i % NAMES], SymbolType::Label, static_cast<int>(i), 1));
+		}
+	});
+
+	symbolTable table;
+	for (size_t i = 0; i < NAMES; i++)
+		table.add(names[i], SymbolType::Label, static_cast<int>(i), 1);
+
+	b.run("symbolTable::find (hit)", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+			keep(table.find(names[i % NAMES]) != nullptr);
+	});
+
+	b.run("symbolTable::find (miss)", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+			keep(table.find((i & 1) ? "not_a_label" : "loop_end") != nullptr);
+	});
+}
+
+// One whole opcode definition as pass0 reads it: the opcode line and its seq lines, each
+// classified and dispatched. The opcode is redefined every time (its old cycles stay unused).
+static void archBenchmarks(benchmarks& b, assembler& a)
+{
+	const std::string_view lines[][2] =
+	{
+		{ "opcode", "$ff bench a, #" },
+		{ "seq", "fetch" },
+		{ "seq", "_mem_write_data | a_read_data | _pc_write_addr | pc_inc" },
+		{ OPCODE_SEQ_IF_STR, "xxxx1 : _alu_write_data | b_read_data" },
+		{ OPCODE_SEQ_ELSE_STR, "_alu_write_data | c_read_data" },
+		{ "seq", "_tcuEndSeq" },
+	};
+
+	b.run("archOpcodeSeq (opcode + 5 seq lines)", [&](uint64_t n)
+	{
+		for (uint64_t i = 0; i < n; i++)
+		{
+			for (const auto& line : lines)
+				keywords::dispatch(a, keywords::classify(line[0]), line[1], 1);
+		}
+	});
+}
+
+int main(int argc, char* argv[])
+{
+	const std::string_view filter = argc > 1 ? argv[1] : "";
+	const std::filesystem::path codeDir = argc > 2 ? argv[2] : HBA_CODE_DIR;
+
+	try
+	{
+		// a program of its own next to a copy of the architecture, so the roms go to the temp dir
+		const std::filesystem::path dir = std::filesystem::temp_directory_path() / "hba_bench";
+		std::filesystem::create_directories(dir);
+		std::filesystem::copy_file(codeDir / "homebrew.arch", dir / "homebrew.arch", std::filesystem::copy_options::overwrite_existing);
+
+		const std::filesystem::path program = dir / "bench.s";
+		std::ofstream(program) <<
+			".include \"homebrew.arch\"\n"
+			"	mov c, #200\n"
+			"outer:\n"
+			"	mov b, #0\n"
+			"inner:\n"
+			"	dec b\n"
+			"	jnz inner\n"
+			"	dec c\n"
+			"	jnz outer\n"
+			"done:\n"
+			"	jmp done\n";
+
+		assembler a(program.string());
+		a.setEcho(0);
+		a.setArchImages(false);
+		a.assemble();
+
+		benchmarks b(filter);
+		parserBenchmarks(b);
+		keywordBenchmarks(b, a);
+		matcherBenchmarks(b, *a.getArchitecture());
+		symbolBenchmarks(b);
+		archBenchmarks(b, a);
+
+		std::filesystem::remove_all(dir);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Fatal error: " << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,434 @@
+#include "assembler.h"
+#include "logger.h"
+#include "workload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
+
+// End-to-end scaling benchmark. Generates synthetic workloads, assembles each one in a process of
+// its own (so its peak RSS is its own) and compares the wall time, peak RSS and throughput with a
+// stored baseline. The exit code is 1 when a workload is slower or bigger than the baseline by
+// more than the threshold.
+//
+//   hba_scale [--filter <text>] [--repeat <n>] [--threshold <percent>]
+//             [--baseline <file>] [--update-baseline]
+//
+// The fastest of the repeated runs counts. --update-baseline writes the results as the new
+// baseline instead of comparing -- baselines only compare on the machine that wrote them.
+//
+//   hba_scale --generate <dir> [--opcodes <n>] [--flags <n>] [--controls <n>] [--cycles <n>]
+//             [--lines <n>] [--depth <n>] [--fanout <n>] [--label-every <n>]
+//             [--references <percent>] [--seed <n>]
+//
+// only writes one workload of that shape to dir, to assemble by hand.
+
+#ifndef HBA_BASELINE_FILE
+#define HBA_BASELINE_FILE "baseline.json"
+#endif
+
+static constexpr const char* ASSEMBLE_ARG = "--assemble";
+
+class scaleResult
+{
+public:
+	std::string name;
+	int64_t lines = 0;
+	double wallMs = 0;
+	int64_t peakRssKb = 0;		// 0 where it can not be measured
+
+	double linesPerSecond() const { return wallMs > 0 ? double(lines) * 1000.0 / wallMs : 0; }
+};
+
+static std::vector<workloadSpec> standardWorkloads()
+{
+	std::vector<workloadSpec> w;
+
+	workloadSpec s;
+	s.name = "lines-100k";
+	w.push_back(s);
+
+	s.name = "lines-1m";
+	s.lines = 1000000;
+	w.push_back(s);
+
+	s.name = "lines-4m";
+	s.lines = 4000000;
+	w.push_back(s);
+
+	s = workloadSpec();
+	s.name = "include-chain-64";
+	s.lines = 200000;
+	s.includeDepth = 64;
+	w.push_back(s);
+
+	s = workloadSpec();
+	s.name = "include-tree-4x4";
+	s.lines = 200000;
+	s.includeDepth = 4;
+	s.includeFanout = 4;
+	w.push_back(s);
+
+	s = workloadSpec();
+	s.name = "dense-labels";
+	s.lines = 500000;
+	s.labelEvery = 2;
+	s.referencePercent = 100;
+	w.push_back(s);
+
+	s = workloadSpec();
+	s.name = "wide-arch";
+	s.opcodes = 256;
+	s.flags = 8;
+	s.controlLines = 70;
+	s.maxCycles = 8;
+	s.lines = 10000;
+	w.push_back(s);
+
+	return w;
+}
+
+// Runs "self --assemble file" and waits for it, returns false if it failed
+static bool runChild(const std::string& self, const std::filesystem::path& file, scaleResult& r)
+{
+	const std::string path = file.string();
+	const auto start = std::chrono::steady_clock::now();
+
+#ifdef _WIN32
+	const std::string command = "\"\"" + self + "\" " + ASSEMBLE_ARG + " \"" + path + "\"\"";
+	const bool ok = std::system(command.c_str()) == 0;
+	r.peakRssKb = 0;
+#else
+	std::vector<char*> argv = { const_cast<char*>(self.c_str()), const_cast<char*>(ASSEMBLE_ARG), const_cast<char*>(path.c_str()), nullptr };
+
+	pid_t pid = 0;
+	if (posix_spawn(&pid, self.c_str(), nullptr, nullptr, argv.data(), environ) != 0)
+		return false;
+
+	int status = 0;
+	struct rusage usage = {};
+	if (wait4(pid, &status, 0, &usage) != pid)
+		return false;
+
+	const bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+#ifdef __APPLE__
+	r.peakRssKb = usage.ru_maxrss / 1024;
+#else
+	r.peakRssKb = usage.ru_maxrss;
+#endif
+#endif
+
+	r.wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return ok;
+}
+
+// The child side -- assembles quietly (warnings and errors only)
+static int assembleFile(const char* file)
+{
+	int result = 0;
+
+	try
+	{
+		assembler a(file);
+		a.setArchImages(false);
+		a.setEcho(0x10);
+		a.assemble();
+	}
+	catch (const std::exception& e)
+	{
+		LOG(LogLevel::Status) << "Fatal error: " << e.what() << "\n";
+		result = 1;
+	}
+
+	logger::instance().flush();
+	return result;
+}
+
+// The baseline is written by writeBaseline below, so reading it only needs the workload objects
+// and their string and number members
+static std::map<std::string, scaleResult> readBaseline(const std::string& file)
+{
+	std::map<std::string, scaleResult> baseline;
+
+	std::ifstream stream(file);
+	if (!stream)
+		return baseline;
+
+	std::stringstream buffer;
+	buffer << stream.rdbuf();
+	const std::string text = buffer.str();
+
+	scaleResult entry;
+	std::string key;
+	bool value = false;
+
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		const char c = text[i];
+
+		if (c == '{' || c == '[')
+		{
+			entry = scaleResult();
+			value = false;
+		}
+		else if (c == '}' || c == ']')
+		{
+			if (c == '}' && !entry.name.empty())
+				baseline[entry.name] = entry;
+
+			entry = scaleResult();
+			value = false;
+		}
+		else if (c == ':')
+		{
+			value = true;
+		}
+		else if (c == ',')
+		{
+			value = false;
+		}
+		else if (c == '"')
+		{
+			const size_t end = text.find('"', i + 1);
+			if (end == std::string::npos)
+				break;
+
+			const std::string s = text.substr(i + 1, end - i - 1);
+			if (!value)
+				key = s;
+			else if (key == "name")
+				entry.name = s;
+
+			i = end;
+		}
+		else if (value && (c == '-' || (c >= '0' && c <= '9')))
+		{
+			char* end = nullptr;
+			const double n = std::strtod(text.c_str() + i, &end);
+			i = static_cast<size_t>(end - text.c_str()) - 1;
+
+			if (key == "lines") entry.lines = static_cast<int64_t>(n);
+			if (key == "wall_ms") entry.wallMs = n;
+			if (key == "peak_rss_kb") entry.peakRssKb = static_cast<int64_t>(n);
+		}
+	}
+
+	return baseline;
+}
+
+static void writeBaseline(const std::string& file, const std::vector<scaleResult>& results)
+{
+	std::ofstream stream(file);
+	stream << "{\n\t\"workloads\": [\n";
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const scaleResult& r = results[i];
+
+		char line[256];
+		std::snprintf(line, sizeof(line), "\t\t{ \"name\": \"%s\", \"lines\": %lld, \"wall_ms\": %.1f, \"peak_rss_kb\": %lld, \"lines_per_s\": %.0f }%s\n",
+			r.name.c_str(), static_cast<long long>(r.lines), r.wallMs, static_cast<long long>(r.peakRssKb), r.linesPerSecond(),
+			i + 1 < results.size() ? "," : "");
+
+		stream << line;
+	}
+
+	stream << "\t]\n}\n";
+
+	if (!stream)
+		throw std::runtime_error("Can not write the baseline [" + file + "]!");
+}
+
+static double percentOver(double value, double base)
+{
+	return base > 0 ? (value / base - 1.0) * 100.0 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc == 3 && std::string_view(argv[1]) == ASSEMBLE_ARG)
+		return assembleFile(argv[2]);
+
+	std::string filter;
+	std::string baselineFile = HBA_BASELINE_FILE;
+	std::string generateDir;
+	bool updateBaseline = false;
+	double threshold = 25;
+	int repeat = 5;
+	workloadSpec custom;
+	custom.name = "custom";
+
+	try
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			if (arg == "--update-baseline") updateBaseline = true;
+			else if (arg == "--filter" && hasValue) filter = argv[++i];
+			else if (arg == "--baseline" && hasValue) baselineFile = argv[++i];
+			else if (arg == "--threshold" && hasValue) threshold = std::stod(argv[++i]);
+			else if (arg == "--repeat" && hasValue) repeat = std::max(1, std::stoi(argv[++i]));
+			else if (arg == "--generate" && hasValue) generateDir = argv[++i];
+			else if (arg == "--opcodes" && hasValue) custom.opcodes = std::stoi(argv[++i]);
+			else if (arg == "--flags" && hasValue) custom.flags = std::stoi(argv[++i]);
+			else if (arg == "--controls" && hasValue) custom.controlLines = std::stoi(argv[++i]);
+			else if (arg == "--cycles" && hasValue) custom.maxCycles = std::stoi(argv[++i]);
+			else if (arg == "--lines" && hasValue) custom.lines = std::stoll(argv[++i]);
+			else if (arg == "--depth" && hasValue) custom.includeDepth = std::stoi(argv[++i]);
+			else if (arg == "--fanout" && hasValue) custom.includeFanout = std::stoi(argv[++i]);
+			else if (arg == "--label-every" && hasValue) custom.labelEvery = std::stoi(argv[++i]);
+			else if (arg == "--references" && hasValue) custom.referencePercent = std::stoi(argv[++i]);
+			else if (arg == "--seed" && hasValue) custom.seed = static_cast<uint32_t>(std::stoul(argv[++i]));
+			else
+			{
+				std::fprintf(stderr, "Unknown option [%s]!\n", arg.c_str());
+				return 2;
+			}
+		}
+
+		if (!generateDir.empty())
+		{
+			const workloadFiles files = workloadGenerator(custom).write(generateDir);
+			std::printf("Wrote %d files, %lld lines, %lld labels (%llu bytes) -- assemble %s\n", files.files, static_cast<long long>(files.lines),
+				static_cast<long long>(files.labels), static_cast<unsigned long long>(files.bytes), files.main.string().c_str());
+			return 0;
+		}
+
+#ifdef __linux__
+		const std::string self = std::filesystem::read_symlink("/proc/self/exe").string();
+#else
+		const std::string self = std::filesystem::absolute(argv[0]).string();
+#endif
+
+		std::map<std::string, scaleResult> baseline = readBaseline(baselineFile);
+		const std::filesystem::path root = std::filesystem::temp_directory_path() / "hba_scale";
+
+		std::vector<scaleResult> results;
+		int regressions = 0;
+
+		std::printf("%-18s %10s %10s %10s %8s %10s %10s %8s %10s  %s\n", "workload", "lines", "wall ms", "base ms", "change", "peak MB", "base MB",
+			"change", "Mlines/s", "status");
+
+		for (const workloadSpec& spec : standardWorkloads())
+		{
+			if (!filter.empty() && spec.name.find(filter) == std::string::npos)
+				continue;
+
+			const std::filesystem::path dir = root / spec.name;
+			std::filesystem::remove_all(dir);
+			const workloadFiles files = workloadGenerator(spec).write(dir);
+
+			scaleResult best;
+			best.name = spec.name;
+			best.lines = files.lines;
+
+			for (int run = 0; run < repeat; run++)
+			{
+				scaleResult r = best;
+				if (!runChild(self, files.main, r))
+				{
+					std::filesystem::remove_all(dir);
+					throw std::runtime_error("Workload [" + spec.name + "] failed to assemble!");
+				}
+
+				if (run == 0 || r.wallMs < best.wallMs)
+					best.wallMs = r.wallMs;
+
+				if (run == 0 || r.peakRssKb < best.peakRssKb)
+					best.peakRssKb = r.peakRssKb;
+			}
+
+			std::filesystem::remove_all(dir);
+			results.push_back(best);
+
+			// slower, or bigger where both runs could measure it -- a workload the generator now
+			// writes differently can not be compared
+			std::string status = "new";
+			double wallChange = 0;
+			double rssChange = 0;
+
+			const auto base = baseline.find(spec.name);
+			const bool known = base != baseline.end();
+			if (known)
+			{
+				wallChange = percentOver(best.wallMs, base->second.wallMs);
+				rssChange = best.peakRssKb > 0 ? percentOver(double(best.peakRssKb), double(base->second.peakRssKb)) : 0;
+			}
+
+			if (updateBaseline)
+			{
+				status = "recorded";
+			}
+			else if (known && base->second.lines != best.lines)
+			{
+				status = "workload changed";
+			}
+			else if (known)
+			{
+				status = "ok";
+				if (wallChange > threshold)
+					status = "REGRESSION (time)";
+
+				if (rssChange > threshold)
+					status = status == "ok" ? "REGRESSION (memory)" : "REGRESSION (time, memory)";
+
+				regressions += status == "ok" ? 0 : 1;
+			}
+
+			std::printf("%-18s %10lld %10.1f %10.1f %7.1f%% %10.1f %10.1f %7.1f%% %10.2f  %s\n", spec.name.c_str(), static_cast<long long>(best.lines),
+				best.wallMs, known ? base->second.wallMs : 0.0, wallChange, best.peakRssKb / 1024.0, known ? base->second.peakRssKb / 1024.0 : 0.0,
+				rssChange, best.linesPerSecond() / 1e6, status.c_str());
+			std::fflush(stdout);
+		}
+
+		std::filesystem::remove_all(root);
+
+		if (updateBaseline)
+		{
+			// workloads that were filtered out keep their old numbers
+			for (const scaleResult& r : results)
+				baseline[r.name] = r;
+
+			results.clear();
+			for (const workloadSpec& spec : standardWorkloads())
+			{
+				if (baseline.count(spec.name) > 0)
+					results.push_back(baseline[spec.name]);
+			}
+
+			writeBaseline(baselineFile, results);
+			std::printf("\nBaseline written to %s\n", baselineFile.c_str());
+		}
+		else if (regressions > 0)
+		{
+			std::printf("\n%d workload(s) more than %.0f%% over the baseline in %s\n", regressions, threshold, baselineFile.c_str());
+			return 1;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::fprintf(stderr, "Fatal error: %s\n", e.what());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,357 @@
+#include "workload.h"
+#include "include.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// the decoder rom takes one address bit per opcode, cycle and flag bit
+static constexpr int MAX_DECODER_INPUTS = 24;
+// the architecture takes one of the files the assembler can load
+static constexpr int64_t MAX_FILES = sourceLocation::MAX_FILES - 1;
+
+// the forms of one mnemonic, by opcode value % 8 -- register operands are 8 bit, so their
+// values are one byte, and other value operands are addresses
+static const char* const FORMS[8] =
+{
+	"",
+	" r0",
+	" r1, r2",
+	" r0, #",
+	" r1, #",
+	" #",
+	" r2, [#]",
+	" [#], r3",
+};
+
+static int bitsFor(int64_t n)
+{
+	int bits = 0;
+	while ((int64_t(1) << bits) < n)
+		bits++;
+
+	return bits;
+}
+
+static std::string hexString(uint64_t v, int digits)
+{
+	static const char* const HEX = "0123456789abcdef";
+
+	std::string s(static_cast<size_t>(digits), '0');
+	for (int i = digits - 1; i >= 0; i--, v >>= 4)
+		s[static_cast<size_t>(i)] = HEX[v & 15];
+
+	return s;
+}
+
+// Writes a file through a small buffer, so a workload of millions of lines never has to be in
+// memory -- the benchmark driver runs the assembler as its child, and shares its peak RSS
+class fileWriter
+{
+public:
+	static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+	explicit fileWriter(const std::filesystem::path& file) : _file(file), _stream(file, std::ios::binary) { text.reserve(BUFFER_SIZE + 256); }
+
+	// call after each line appended to text
+	void lineDone()
+	{
+		if (text.size() >= BUFFER_SIZE)
+			flush();
+	}
+
+	void close(workloadFiles& out)
+	{
+		flush();
+		_stream.close();
+
+		if (!_stream)
+		{
+			std::stringstream msg;
+			msg << "Can not write workload file [" << _file.string() << "]!";
+			throw std::runtime_error(msg.str());
+		}
+
+		out.files++;
+		out.lines += _lines;
+		out.bytes += _bytes;
+	}
+
+	std::string text;
+
+private:
+	void flush()
+	{
+		_lines += std::count(text.begin(), text.end(), '\n');
+		_bytes += text.size();
+		_stream.write(text.data(), static_cast<std::streamsize>(text.size()));
+		text.clear();
+	}
+
+	std::filesystem::path _file;
+	std::ofstream _stream;
+	int64_t _lines = 0;
+	uint64_t _bytes = 0;
+};
+
+workloadGenerator::workloadGenerator(const workloadSpec& spec)
+	:
+	_spec(spec)
+{
+	const int cycleBits = bitsFor(_spec.maxCycles);
+	const int decoderInputs = 8 + cycleBits + _spec.flags;
+	const int64_t files = _spec.includeFanout < 1 ? 1 : fileCount();
+
+	std::stringstream msg;
+	if (_spec.opcodes < 1 || _spec.opcodes > MAX_OPCODES)
+		msg << _spec.opcodes << " opcodes, 1 to " << MAX_OPCODES << " are supported";
+	else if (_spec.controlLines < 1 || _spec.controlLines > CONTROL_FIELDS * 7)
+		msg << _spec.controlLines << " control lines, 1 to " << CONTROL_FIELDS * 7 << " are supported";
+	else if (_spec.flags < 0 || _spec.maxCycles < 2 || decoderInputs > MAX_DECODER_INPUTS)
+		msg << _spec.flags << " flags and " << _spec.maxCycles << " cycles, they need " << decoderInputs << " decoder rom inputs (at most " << MAX_DECODER_INPUTS << ")";
+	else if (_spec.lines < 1 || _spec.labelEvery < 1 || _spec.referencePercent < 0 || _spec.referencePercent > 100)
+		msg << _spec.lines << " lines with a label every " << _spec.labelEvery << " and " << _spec.referencePercent << "% label references";
+	else if (_spec.includeDepth < 0 || _spec.includeFanout < 1 || files > MAX_FILES)
+		msg << "an include tree " << _spec.includeDepth << " deep and " << _spec.includeFanout << " wide, at most " << MAX_FILES << " program files are supported";
+	else if (_spec.lines * (1 + addressBytes()) > (int64_t(1) << 31))
+		msg << _spec.lines << " lines, the program rom would be over 2 GB";
+
+	if (!msg.str().empty())
+	{
+		std::stringstream error;
+		error << "Workload [" << _spec.name << "] can not be built with " << msg.str() << "!";
+		throw std::runtime_error(error.str());
+	}
+}
+
+int64_t workloadGenerator::fileCount() const
+{
+	// stops counting past MAX_FILES, so a huge tree can not overflow
+	int64_t files = 1;
+	for (int64_t level = 1, width = 1; level <= _spec.includeDepth && files <= MAX_FILES; level++)
+	{
+		width *= _spec.includeFanout;
+		files += width;
+	}
+
+	return files;
+}
+
+int workloadGenerator::addressBytes() const
+{
+	// enough to address the program rom even if every instruction takes an address operand
+	for (int bytes = 2; bytes < 4; bytes++)
+	{
+		if (_spec.lines * (1 + bytes) <= (int64_t(1) << (8 * bytes)))
+			return bytes;
+	}
+
+	return 4;
+}
+
+int workloadGenerator::programRomBits() const
+{
+	return std::max(8, bitsFor(_spec.lines * (1 + addressBytes())));
+}
+
+workloadFiles workloadGenerator::write(const std::filesystem::path& dir) const
+{
+	std::filesystem::create_directories(dir);
+
+	workloadFiles out;
+	writeArchitecture(dir / "workload.arch", out);
+	writeProgram(dir, out);
+
+	return out;
+}
+
+void workloadGenerator::writeArchitecture(const std::filesystem::path& file, workloadFiles& out) const
+{
+	std::mt19937 rng(_spec.seed);
+	std::ostringstream s;
+
+	const int fields = (_spec.controlLines + 6) / 7;
+	auto linesIn = [&](int field) { return std::min(7, _spec.controlLines - field * 7); };
+	auto lineName = [](int field, int line) { return "c" + std::to_string(field) + "_" + std::to_string(line + 1); };
+
+	s << "; generated workload architecture [" << _spec.name << "]\n\n";
+	s << "instruction_width\t1\n";
+	s << "address_width\t\t" << addressBytes() << "\n\n";
+	s << "decoder_rom\t\t1\t\t" << 8 + bitsFor(_spec.maxCycles) + _spec.flags << " 16\n";
+	s << "program_rom\t\t1\t\t" << programRomBits() << " 8\n\n";
+	s << "register\t\t8\t\tr0, r1, r2, r3\n";
+
+	if (_spec.flags > 0)
+	{
+		s << "flag ";
+		for (int f = 0; f < _spec.flags; f++)
+			s << (f > 0 ? ", f" : "f") << f;
+
+		s << "\n";
+	}
+
+	// 3 bit fields, and the end of sequence line on a bit of its own above them
+	s << "\n";
+	for (int field = 0; field < fields; field++)
+	{
+		for (int line = 0; line < linesIn(field); line++)
+			s << "control " << lineName(field, line) << "\t\t" << line + 1 << " << " << field * 3 << "\n";
+	}
+
+	s << "control _tcuEndSeq\t\t1 << " << CONTROL_FIELDS * 3 << "\n";
+	s << "control fetch = " << lineName(0, 0) << (fields > 1 ? " | " + lineName(1, 0) : std::string()) << "\n";
+
+	// one to three lines of different fields
+	auto controls = [&]()
+	{
+		std::string text;
+		int field = static_cast<int>(rng() % fields);
+		const int n = 1 + static_cast<int>(rng() % std::min(3, fields));
+
+		for (int i = 0; i < n; i++, field = (field + 1) % fields)
+			text += (i > 0 ? " | " : "") + lineName(field, static_cast<int>(rng() % linesIn(field)));
+
+		return text;
+	};
+
+	auto condition = [&]()
+	{
+		std::string text(static_cast<size_t>(_spec.flags), 'x');
+		text[rng() % _spec.flags] = (rng() & 1) ? '1' : '0';
+		return text;
+	};
+
+	for (int v = 0; v < _spec.opcodes; v++)
+	{
+		s << "\nopcode $" << hexString(static_cast<uint64_t>(v), 2) << " m" << v / 8 << FORMS[v % 8] << "\n{\n\tseq fetch\n";
+
+		const int cycles = 2 + static_cast<int>(rng() % (_spec.maxCycles - 1));
+		for (int c = 2; c < cycles; c++)
+		{
+			if (_spec.flags > 0 && rng() % 10 < 3)
+			{
+				s << "\tseq_if " << condition() << " : " << controls() << "\n";
+				s << "\tseq_else " << controls() << "\n";
+			}
+			else
+			{
+				s << "\tseq " << controls() << "\n";
+			}
+		}
+
+		s << "\tseq " << controls() << " | _tcuEndSeq\n}\n";
+	}
+
+	fileWriter writer(file);
+	writer.text = s.str();
+	writer.close(out);
+}
+
+void workloadGenerator::writeProgram(const std::filesystem::path& dir, workloadFiles& out) const
+{
+	std::mt19937 rng(_spec.seed + 1);
+
+	const int addressDigits = 2 * addressBytes();
+	const uint64_t addressLimit = uint64_t(1) << programRomBits();
+	const int64_t labels = (_spec.lines + _spec.labelEvery - 1) / _spec.labelEvery;
+
+	const int64_t files = fileCount();
+	const int64_t linesPerFile = _spec.lines / files;
+	int64_t line = 0;
+	int nextFile = 1;
+
+	auto operand = [&](std::string& text, char kind)
+	{
+		if (kind == 'v')
+		{
+			switch (rng() % 3)
+			{
+			case 0: text += "$" + hexString(rng() & 0xFF, 2); break;
+			case 1: text += std::to_string(rng() & 0xFF); break;
+			default: text += "%" + std::to_string(rng() & 1) + "010" + std::to_string(rng() & 1) + "1"; break;
+			}
+		}
+		else if (static_cast<int>(rng() % 100) < _spec.referencePercent)
+		{
+			text += "l" + std::to_string(static_cast<int64_t>(rng() % static_cast<uint64_t>(labels)));
+		}
+		else
+		{
+			text += "$" + hexString(rng() % addressLimit, addressDigits);
+		}
+	};
+
+	auto instruction = [&](std::string& text)
+	{
+		const int v = static_cast<int>(rng() % _spec.opcodes);
+		const std::string_view form = FORMS[v % 8];
+
+		text += "\tm" + std::to_string(v / 8);
+
+		// the form with each # replaced by a value (after a register) or an address
+		const bool registerForm = form.find('r') != std::string_view::npos;
+		for (char c : form)
+		{
+			if (c == '#')
+				operand(text, registerForm && form.find('[') == std::string_view::npos ? 'v' : 'a');
+			else
+				text += c;
+		}
+
+		if (rng() % 8 == 0)
+			text += "\t\t; generated";
+
+		text += "\n";
+	};
+
+	// files are written depth first, which is the order pass1 assembles them in, so labels
+	// numbered by line are in program order
+	auto writeTree = [&](auto& self, int64_t index, int depth) -> void
+	{
+		const std::string name = index == 0 ? std::string("main.s") : "part_" + std::to_string(index) + ".s";
+		const int children = depth < _spec.includeDepth ? _spec.includeFanout : 0;
+		const int64_t count = index == 0 ? _spec.lines - linesPerFile * (files - 1) : linesPerFile;
+
+		fileWriter writer(dir / name);
+		std::string& text = writer.text;
+		if (index == 0)
+			text += "; generated workload [" + _spec.name + "]\n.include \"workload.arch\"\n\n";
+
+		std::vector<int64_t> childIndex;
+		for (int c = 0; c < children; c++)
+			childIndex.push_back(nextFile++);
+
+		// the includes are spread through the code, each after an equal share of the lines
+		int64_t written = 0;
+		for (int c = 0; c <= children; c++)
+		{
+			const int64_t until = count * (c + 1) / (children + 1);
+			for (; written < until; written++, line++)
+			{
+				if (line % _spec.labelEvery == 0)
+					text += "l" + std::to_string(line / _spec.labelEvery) + ":\n";
+				else
+					instruction(text);
+
+				writer.lineDone();
+			}
+
+			if (c < children)
+			{
+				text += ".include \"part_" + std::to_string(childIndex[c]) + ".s\"\n";
+				self(self, childIndex[c], depth + 1);
+			}
+		}
+
+		writer.close(out);
+	};
+
+	writeTree(writeTree, 0, 0);
+
+	out.main = dir / "main.s";
+	out.labels = labels;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// The shape of a synthetic workload: an architecture and a program that uses it
+class workloadSpec
+{
+public:
+	std::string name;
+
+	// architecture
+	int opcodes = 64;			// at most 256 (one byte instructions)
+	int flags = 4;
+	int controlLines = 32;		// at most CONTROL_FIELDS * 7, plus the end of sequence line
+	int maxCycles = 4;			// cycles per opcode, fetch included (2 or more)
+
+	// program
+	int64_t lines = 100000;		// over every program file, labels included
+	int includeDepth = 0;		// levels of included files below the main file
+	int includeFanout = 1;		// files each program file includes (a chain when 1)
+	int labelEvery = 16;		// a label every n lines
+	int referencePercent = 50;	// address operands that name a label (the rest are numbers)
+
+	uint32_t seed = 1;
+};
+
+// What was written for a workload
+class workloadFiles
+{
+public:
+	std::filesystem::path main;		// the file to assemble
+	int files = 0;					// architecture and program files
+	int64_t lines = 0;				// lines of every file, the architecture included
+	int64_t labels = 0;
+	uint64_t bytes = 0;
+};
+
+// Writes workloads of any size, always the same files for the same spec.
+//
+// The architecture has one byte opcodes in groups of eight forms sharing a mnemonic (no operand,
+// registers, immediates, addresses and indirect addresses), so the matcher sees the same kind of
+// branching as a real instruction set. Its control lines are 3 bit fields of 7 lines each, and
+// its opcodes are a fetch followed by random seq and seq_if cycles.
+//
+// The program is spread evenly over a tree of include files, and assembled where each one is
+// included. Labels are numbered in program order, and address operands pick any of them, so
+// about half the references are forward ones that go through the fixup table.
+class workloadGenerator
+{
+public:
+	static constexpr int CONTROL_FIELDS = 10;
+	static constexpr int MAX_OPCODES = 256;
+
+	explicit workloadGenerator(const workloadSpec& spec);
+
+	// Writes the architecture and the program files to dir (created if needed), throws when the
+	// spec can not be built
+	workloadFiles write(const std::filesystem::path& dir) const;
+
+private:
+	void writeArchitecture(const std::filesystem::path& file, workloadFiles& out) const;
+	void writeProgram(const std::filesystem::path& dir, workloadFiles& out) const;
+
+	int64_t fileCount() const;
+	int addressBytes() const;
+	int programRomBits() const;
+
+private:
+	workloadSpec _spec;
+};
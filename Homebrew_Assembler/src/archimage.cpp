@@ -0,0 +1,407 @@
+#include "archimage.h"
+#include "assembler.h"
+#include "config.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+// On-disk layout -- every record is made of 32-bit fields so the sections stay 4-byte aligned
+// and can be read straight out of the mapping
+
+static constexpr char IMAGE_MAGIC[8] = { 'H', 'B', 'A', 'R', 'C', 'H', 'I', 'M' };
+static constexpr uint32_t IMAGE_VERSION = 3;
+static constexpr uint32_t IMAGE_BYTE_ORDER = 0x01020304;
+
+// imageHeader::flags, the architecture settings the image holds
+static constexpr uint32_t HasInstructionWidth = 1;
+static constexpr uint32_t HasAddressWidth = 2;
+static constexpr uint32_t HasDecoderRom = 4;
+static constexpr uint32_t HasProgramRom = 8;
+
+class imageSection
+{
+public:
+	uint32_t offset;
+	uint32_t count;
+};
+
+class imageString
+{
+public:
+	uint32_t offset;
+	uint32_t length;
+};
+
+class imageSymbol
+{
+public:
+	imageString name;
+	int32_t value;
+	int32_t line;
+};
+
+class imageOpcode
+{
+public:
+	int32_t value;
+	imageString mnemonic;
+	uint32_t firstArg;
+	uint32_t numArgs;
+	uint32_t firstPattern;
+	uint32_t numPatterns;
+};
+
+class imageArg
+{
+public:
+	uint32_t type;
+	imageString text;
+};
+
+class imagePattern
+{
+public:
+	uint32_t pattern;
+	uint32_t type;
+	uint32_t mask;	// flag condition
+	uint32_t value;
+	uint32_t branch;  // 0 = starts a new cycle, otherwise another branch of the last cycle
+};
+
+class imageHeader
+{
+public:
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t hash;
+	uint32_t size;
+	uint32_t flags;
+
+	int32_t instructionWidth;
+	int32_t addressWidth;
+	int32_t decoderWrite;
+	int32_t decoderInputs;
+	int32_t decoderOutputs;
+	int32_t programWrite;
+	int32_t programInputs;
+	int32_t programOutputs;
+
+	imageSection registers;
+	imageSection flagSymbols;
+	imageSection controlLines;
+	imageSection opcodes;
+	imageSection opcodeAliases;
+	imageSection args;
+	imageSection patterns;
+	imageSection strings;
+};
+
+static_assert(sizeof(imageHeader) % 8 == 0, "image header must keep the sections aligned");
+static_assert(sizeof(imageSymbol) == 16 && sizeof(imageOpcode) == 28 && sizeof(imageArg) == 12 && sizeof(imagePattern) == 20,
+	"image records must not contain padding");
+
+// The records of a section, read in place from the mapping
+template <class t>
+static const t* sectionRecords(const char* base, const imageSection& s)
+{
+	return reinterpret_cast<const t*>(base + s.offset);
+}
+
+std::string archImage::imageName(const std::string& archFile)
+{
+	return std::filesystem::path(archFile).replace_extension(ARCH_IMAGE_EXT).string();
+}
+
+// Builds the flat image in memory, then writes it in one go
+class imageWriter
+{
+public:
+	template <class t>
+	imageSection section(const std::vector<t>& records)
+	{
+		imageSection s;
+		s.offset = static_cast<uint32_t>(bytes.size());
+		s.count = static_cast<uint32_t>(records.size());
+
+		const char* data = reinterpret_cast<const char*>(records.data());
+		bytes.insert(bytes.end(), data, data + records.size() * sizeof(t));
+		return s;
+	}
+
+	imageString string(const std::string& s)
+	{
+		imageString i;
+		i.offset = static_cast<uint32_t>(strings.size());
+		i.length = static_cast<uint32_t>(s.size());
+		strings.insert(strings.end(), s.begin(), s.end());
+		return i;
+	}
+
+	std::vector<char> bytes;
+	std::vector<char> strings;
+};
+
+bool archImage::write(assembler& a, const archImageBuilder& b, const std::string& imageFile, uint64_t hash)
+{
+	imageWriter w;
+
+	auto symbols = [&](const std::vector<std::string>& names)
+	{
+		std::vector<imageSymbol> records;
+		for (const std::string& n : names)
+		{
+			const symbol* s = a.findSymbol(n);
+			if (s == nullptr)
+				continue;
+
+			records.push_back({ w.string(n), s->getAddress(), s->getLine() });
+		}
+
+		return records;
+	};
+
+	std::vector<imageSymbol> registers = symbols(b.registers);
+	std::vector<imageSymbol> flags = symbols(b.flags);
+	std::vector<imageSymbol> controlLines = symbols(b.controlLines);
+
+	std::vector<imageOpcode> opcodes;
+	std::vector<imageOpcode> aliases;
+	std::vector<imageArg> args;
+	std::vector<imagePattern> patterns;
+	const microcodeStore& microcode = a.getMicrocode();
+
+	auto addOpcode = [&](opcode& oc, std::vector<imageOpcode>& into, bool withPatterns)
+	{
+		imageOpcode r;
+		r.value = oc.value();
+		r.mnemonic = w.string(oc.mnemonic());
+		r.firstArg = static_cast<uint32_t>(args.size());
+		r.numArgs = oc.numArgs();
+		r.firstPattern = static_cast<uint32_t>(patterns.size());
+
+		for (int i = 0; i < oc.numArgs(); i++)
+		{
+			opcode::arg arg = oc.getArg(i);
+			args.push_back({ static_cast<uint32_t>(arg._type), w.string(arg._string) });
+		}
+
+		for (int i = 0; withPatterns && i < microcode.numCycles(r.value); i++)
+		{
+			const int cycle = microcode.firstCycle(r.value) + i;
+			for (int j = 0; j < microcode.numBranches(cycle); j++)
+			{
+				const int branch = microcode.firstBranch(cycle) + j;
+
+				imagePattern ip;
+				ip.pattern = microcode.pattern(branch);
+				ip.type = static_cast<uint32_t>(microcode.type(branch));
+				ip.mask = microcode.condition(branch).mask;
+				ip.value = microcode.condition(branch).value;
+				ip.branch = j;
+				patterns.push_back(ip);
+			}
+		}
+
+		r.numPatterns = static_cast<uint32_t>(patterns.size()) - r.firstPattern;
+		into.push_back(r);
+	};
+
+	for (int v : b.opcodes)
+		addOpcode(a.getOpcode(v), opcodes, true);
+
+	for (int v : b.opcodeAliases)
+		addOpcode(a.getOpcodeAlias(v), aliases, false);
+
+	imageHeader h = {};
+	memcpy(h.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+	h.version = IMAGE_VERSION;
+	h.byteOrder = IMAGE_BYTE_ORDER;
+	h.hash = hash;
+	h.flags = (b.instructionWidth ? HasInstructionWidth : 0u) | (b.addressWidth ? HasAddressWidth : 0u) |
+		(b.decoderRom ? HasDecoderRom : 0u) | (b.programRom ? HasProgramRom : 0u);
+
+	h.instructionWidth = a.getInstructionWidth();
+	h.addressWidth = a.getAddressWidth();
+	h.decoderWrite = a.getWriteDecoderRom() ? 1 : 0;
+	h.decoderInputs = a.getDecoderRomInputs();
+	h.decoderOutputs = a.getDecoderRomOutputs();
+	h.programWrite = a.getWriteProgramRom() ? 1 : 0;
+	h.programInputs = a.getProgramRomInputs();
+	h.programOutputs = a.getProgramRomOutputs();
+
+	w.bytes.resize(sizeof(imageHeader));
+	h.registers = w.section(registers);
+	h.flagSymbols = w.section(flags);
+	h.controlLines = w.section(controlLines);
+	h.opcodes = w.section(opcodes);
+	h.opcodeAliases = w.section(aliases);
+	h.args = w.section(args);
+	h.patterns = w.section(patterns);
+	h.strings = w.section(w.strings);
+	h.size = static_cast<uint32_t>(w.bytes.size());
+
+	memcpy(w.bytes.data(), &h, sizeof(h));
+
+	// write to a temporary name first so a reader never maps a half-written image
+	const std::string temporary = imageFile + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		if (!out)
+			return false;
+
+		out.write(w.bytes.data(), w.bytes.size());
+		if (!out)
+			return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temporary, imageFile, ec);
+	if (ec)
+	{
+		std::filesystem::remove(temporary, ec);
+		return false;
+	}
+
+	return true;
+}
+
+bool archImage::tryLoad(assembler& a, const std::string& imageFile, uint64_t hash)
+{
+	std::error_code ec;
+	if (!std::filesystem::is_regular_file(imageFile, ec))
+		return false;
+
+	sourceFile mapping;
+	try
+	{
+		mapping.open(imageFile);
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	const std::string_view bytes = mapping.text();
+	if (bytes.size() < sizeof(imageHeader))
+		return false;
+
+	imageHeader h;
+	memcpy(&h, bytes.data(), sizeof(h));
+
+	if (memcmp(h.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 || h.version != IMAGE_VERSION ||
+		h.byteOrder != IMAGE_BYTE_ORDER || h.hash != hash || h.size != bytes.size())
+		return false;
+
+	// every section must lie inside the mapping
+	auto fits = [&](const imageSection& s, size_t recordSize)
+	{
+		return s.offset % 4 == 0 && s.offset <= bytes.size() && s.count <= (bytes.size() - s.offset) / recordSize;
+	};
+
+	if (!fits(h.registers, sizeof(imageSymbol)) || !fits(h.flagSymbols, sizeof(imageSymbol)) ||
+		!fits(h.controlLines, sizeof(imageSymbol)) || !fits(h.opcodes, sizeof(imageOpcode)) ||
+		!fits(h.opcodeAliases, sizeof(imageOpcode)) || !fits(h.args, sizeof(imageArg)) ||
+		!fits(h.patterns, sizeof(imagePattern)) || !fits(h.strings, 1))
+		return false;
+
+	const char* base = bytes.data();
+	const imageSymbol* registers = sectionRecords<imageSymbol>(base, h.registers);
+	const imageSymbol* flags = sectionRecords<imageSymbol>(base, h.flagSymbols);
+	const imageSymbol* controlLines = sectionRecords<imageSymbol>(base, h.controlLines);
+	const imageOpcode* opcodes = sectionRecords<imageOpcode>(base, h.opcodes);
+	const imageOpcode* aliases = sectionRecords<imageOpcode>(base, h.opcodeAliases);
+	const imageArg* args = sectionRecords<imageArg>(base, h.args);
+	const imagePattern* patterns = sectionRecords<imagePattern>(base, h.patterns);
+	const std::string_view strings(base + h.strings.offset, h.strings.count);
+
+	auto text = [&strings](const imageString& s) { return s.offset <= strings.size() ? strings.substr(s.offset, s.length) : std::string_view(); };
+
+	// make sure every index stays in range before touching the assembler
+	auto opcodesValid = [&](const imageOpcode* ops, uint32_t count)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (ops[i].firstArg > h.args.count || ops[i].numArgs > h.args.count - ops[i].firstArg ||
+				ops[i].firstPattern > h.patterns.count || ops[i].numPatterns > h.patterns.count - ops[i].firstPattern)
+				return false;
+		}
+
+		return true;
+	};
+
+	if (!opcodesValid(opcodes, h.opcodes.count) || !opcodesValid(aliases, h.opcodeAliases.count))
+		return false;
+
+	// opcode values index the opcode tables, and a cycle must start with its first branch
+	for (uint32_t i = 0; i < h.opcodes.count; i++)
+	{
+		if (opcodes[i].value < 0 || (opcodes[i].numPatterns > 0 && patterns[opcodes[i].firstPattern].branch != 0))
+			return false;
+	}
+
+	for (uint32_t i = 0; i < h.opcodeAliases.count; i++)
+	{
+		if (aliases[i].value < 0)
+			return false;
+	}
+
+	// apply everything in the order the text parser would have
+	if (h.flags & HasInstructionWidth) a.setInstructionWidth(h.instructionWidth);
+	if (h.flags & HasAddressWidth) a.setAddressWidth(h.addressWidth);
+	if (h.flags & HasDecoderRom) a.addDecoderRom(h.decoderWrite == 1, h.decoderInputs, h.decoderOutputs);
+	if (h.flags & HasProgramRom) a.addProgramRom(h.programWrite == 1, h.programInputs, h.programOutputs);
+
+	for (uint32_t i = 0; i < h.registers.count; i++)
+		a.addRegister(text(registers[i].name), registers[i].value, registers[i].line);
+
+	for (uint32_t i = 0; i < h.flagSymbols.count; i++)
+		a.addFlag(text(flags[i].name), flags[i].value, flags[i].line);
+
+	for (uint32_t i = 0; i < h.controlLines.count; i++)
+		a.addControlLine(text(controlLines[i].name), controlLines[i].value, controlLines[i].line);
+
+	auto makeOpcode = [&](const imageOpcode& r)
+	{
+		opcode oc(a.archAllocator());
+		oc.setValue(r.value);
+		oc.setMnemonic(std::string(text(r.mnemonic)));
+
+		for (uint32_t j = 0; j < r.numArgs; j++)
+		{
+			opcode::arg arg;
+			arg._type = static_cast<ArgType>(args[r.firstArg + j].type);
+			arg._string = std::string(text(args[r.firstArg + j].text));
+			oc.addArgument(arg);
+		}
+
+		return oc;
+	};
+
+	for (uint32_t i = 0; i < h.opcodes.count; i++)
+	{
+		a.addOpcode(opcodes[i].value, makeOpcode(opcodes[i]));
+
+		for (uint32_t j = 0; j < opcodes[i].numPatterns; j++)
+		{
+			const imagePattern& p = patterns[opcodes[i].firstPattern + j];
+
+			microBranch b;
+			b.pattern = p.pattern;
+			b.type = static_cast<PatternType>(p.type);
+			b.when.mask = p.mask;
+			b.when.value = p.value;
+
+			if (p.branch == 0)
+				a.addCycle(b);
+			else
+				a.addBranch(b);
+		}
+	}
+
+	for (uint32_t i = 0; i < h.opcodeAliases.count; i++)
+		a.addOpcodeAlias(aliases[i].value, makeOpcode(aliases[i]));
+
+	return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Collects what an architecture file defines while it is parsed as text, so the result can be
+// saved as a precompiled image once the file (and everything it includes) is finished
+class archImageBuilder
+{
+public:
+	std::vector<std::string> registers;
+	std::vector<std::string> flags;
+	std::vector<std::string> controlLines;
+	std::vector<int> opcodes;
+	std::vector<int> opcodeAliases;
+
+	bool instructionWidth = false;
+	bool addressWidth = false;
+	bool decoderRom = false;
+	bool programRom = false;
+};
+
+// A precompiled architecture image. The image is a flat, pointer-free layout of fixed-size
+// records (registers, flags, control lines, opcodes, their argument forms and microcode branches
+// with their flag conditions) followed by a string table, all addressed by offsets from the start
+// of the file. It is keyed by a content hash of the .arch file and everything it includes, and is
+// mapped read-only and applied without any parsing on later runs.
+class archImage
+{
+public:
+	// <name>.arch -> <name><ARCH_IMAGE_EXT>
+	static std::string imageName(const std::string& archFile);
+
+	// Applies the image to the assembler if it exists and was built from the same sources.
+	// Returns false (and leaves the assembler untouched) otherwise.
+	static bool tryLoad(class assembler& a, const std::string& imageFile, uint64_t hash);
+
+	// Writes an image of everything recorded by the builder. Returns false if it could not be written.
+	static bool write(class assembler& a, const archImageBuilder& b, const std::string& imageFile, uint64_t hash);
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "config.h"
+#include "decoder.h"
+#include "expression.h"
+#include "matcher.h"
+#include "microcode.h"
+#include "opcode.h"
+#include "symboltable.h"
+
+#include <algorithm>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+// Everything the architecture files define: the widths, the architecture symbols (registers,
+// flags and control lines), the opcodes with their microcode, the instruction matcher, the rom
+// layouts and the decoder rom image. It is filled in by the assembler that reads the architecture
+// and never changes after that, so one instance can be shared read-only by any number of
+// assemblers working on different programs at the same time (see batch.h).
+class architecture
+{
+public:
+	architecture() = default;
+	architecture(const architecture&) = delete;
+	architecture& operator=(const architecture&) = delete;
+
+	// canonical names of the files the architecture was read from
+	bool hasFile(const std::string& canonicalName) const { return std::find(files.begin(), files.end(), canonicalName) != files.end(); }
+
+	// bytes taken by value operand i of a matched instruction
+	int operandBytesOf(const instructionMatch& m, int i) const
+	{
+		const std::pmr::vector<uint8_t>& widths = m.alias ? aliasOperandBytes : operandBytes;
+		return widths[m.value * instructionMatch::MAX_OPERANDS + i];
+	}
+
+public:
+	// everything below is allocated from here, and freed with the architecture
+	std::pmr::monotonic_buffer_resource arena{ ARENA_BLOCK_SIZE };
+
+	int instructionWidth = 0;
+	int addressWidth = 0;
+	int nFlags = 0;
+
+	symbolTable symbols{ &arena };
+	controlExpressions expressions{ symbols, &arena };
+
+	// indexed by opcode value (undefined entries have a value of -1)
+	std::pmr::vector<opcode> opcodes{ &arena };
+	std::pmr::vector<opcode> opcodeAliases{ &arena };
+	microcodeStore microcode{ &arena };
+	instructionMatcher matcher{ &arena };
+
+	// bytes each value operand of an opcode takes in the program rom, MAX_OPERANDS entries per
+	// opcode value (see assembler::buildMatcher)
+	std::pmr::vector<uint8_t> operandBytes{ &arena };
+	std::pmr::vector<uint8_t> aliasOperandBytes{ &arena };
+
+	int maxControlLineValue = -1;
+	int maxOpcodeValue = -1;
+
+	// decoder rom
+	bool writeDecoderRom = false;
+	int decoderInputs = 0;
+	int decoderOutputs = 0;
+	decoderRom decoder;
+
+	// program rom layout (the image itself belongs to each program)
+	bool writeProgramRom = false;
+	int programInputs = 0;
+	int programOutputs = 0;
+
+	std::vector<std::string> files;
+};
@@ -5,67 +5,67 @@
 #include "parser.h"
 #include "opcode.h"
 
+#include <algorithm>
 #include <sstream>
-
-enum Operation { None, OR, AND, NOT, EQUALITY };
+#include <stdexcept>
 
 class archBitWidth : public command
 {
 public:
-	void process(assembler& assembler, const std::string& label, std::string remainder, int line) const override
+	void process(assembler& assembler, std::string_view label, std::string_view remainder, int line) const override
 	{
 		auto sizeToken = parser::instance().extract_token_ws_comma(remainder);
 		if (!sizeToken.has_value())
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! There is no valid size!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		if (!isdigit(std::string(sizeToken.value())[0]))
+		if (!isdigit(sizeToken.value()[0]))
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! Invalid command size [";
 			msg << sizeToken.value() << "]!!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
+		if (logEnabled(LogLevel::ParsedMajor) && logEnabled(LogLevel::Architecture))
 		{
 			if (label == INSTRUCTION_WIDTH_STR)
-				std::cout << "          *** Instruction Width set to " << std::string(sizeToken.value()) << "\n\n";
+				logLine() << "          *** Instruction Width set to " << sizeToken.value() << "\n\n";
 
 			if (label == ADDRESS_WIDTH_STR)
-				std::cout << "          *** Address Width set to " << std::string(sizeToken.value()) << "\n\n";
+				logLine() << "          *** Address Width set to " << sizeToken.value() << "\n\n";
 		}
 
 		if (label == INSTRUCTION_WIDTH_STR)
-			assembler.setInstructionWidth(stoi(std::string(sizeToken.value())));
+			assembler.setInstructionWidth(static_cast<int>(literal(sizeToken.value(), label, line, 8)));
 		
 		if (label == ADDRESS_WIDTH_STR)
-			assembler.setAddressWidth(stoi(std::string(sizeToken.value())));
+			assembler.setAddressWidth(static_cast<int>(literal(sizeToken.value(), label, line, 8)));
 	}
 };
 
 class archRom : public command
 {
 public:
-	void process(assembler& assembler, const std::string& label, std::string remainder, int line) const override
+	void process(assembler& assembler, std::string_view label, std::string_view remainder, int line) const override
 	{
 		auto writeToken = parser::instance().extract_token_ws_comma(remainder);
 		if (!writeToken.has_value())
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! There is no valid write token!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		if (!isdigit(std::string(writeToken.value())[0]))
+		if (!isdigit(writeToken.value()[0]))
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! Invalid command size [";
 			msg << writeToken.value() << "]!!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
 		auto inSizeToken = parser::instance().extract_token_ws_comma(remainder);
@@ -73,15 +73,15 @@ public:
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! There is no valid input size!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		if (!isdigit(std::string(inSizeToken.value())[0]))
+		if (!isdigit(inSizeToken.value()[0]))
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! Invalid command size [";
 			msg << inSizeToken.value() << "]!!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
 		auto outSizeToken = parser::instance().extract_token_ws_comma(remainder);
@@ -89,62 +89,64 @@ public:
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! There is no valid output size!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		if (!isdigit(std::string(outSizeToken.value())[0]))
+		if (!isdigit(outSizeToken.value()[0]))
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! Invalid command size [";
 			msg << outSizeToken.value() << "]!!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		bool write = std::stoi(std::string(writeToken.value())) == 1;
+		bool write = literal(writeToken.value(), label, line) == 1;
 
-		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
+		if (logEnabled(LogLevel::ParsedMajor) && logEnabled(LogLevel::Architecture))
 		{
+			logLine out;
+
 			if (label == DECODER_ROM_STR)
-				std::cout << "          *** Decoder Rom with " << std::string(inSizeToken.value()) << " inputs and " << std::string(outSizeToken.value()) << " outputs (";
+				out << "          *** Decoder Rom with " << inSizeToken.value() << " inputs and " << outSizeToken.value() << " outputs (";
 			
 			if (label == PROGRAM_ROM_STR)
-				std::cout << "          *** Program Rom with " << std::string(inSizeToken.value()) << " inputs and " << std::string(outSizeToken.value()) << " outputs (";
+				out << "          *** Program Rom with " << inSizeToken.value() << " inputs and " << outSizeToken.value() << " outputs (";
 
 			if (write)
-				std::cout << "write)\n";
+				out << "write)\n";
 			else
-				std::cout << "non-write)\n";
+				out << "non-write)\n";
 
-			std::cout << "\n";
+			out << "\n";
 		}
 
 		if (label == DECODER_ROM_STR)
-			assembler.addDecoderRom(write, stoi(inSizeToken.value()), stoi(outSizeToken.value()));
+			assembler.addDecoderRom(write, static_cast<int>(literal(inSizeToken.value(), label, line, 8)), static_cast<int>(literal(outSizeToken.value(), label, line, 8)));
 
 		if (label == PROGRAM_ROM_STR)
-			assembler.addProgramRom(write, stoi(inSizeToken.value()), stoi(outSizeToken.value()));
+			assembler.addProgramRom(write, static_cast<int>(literal(inSizeToken.value(), label, line, 8)), static_cast<int>(literal(outSizeToken.value(), label, line, 8)));
 	}
 };
 
 class archRegister : public command
 {
 public:
-	void process(assembler& assembler, const std::string& label, std::string remainder, int line) const override
+	void process(assembler& assembler, std::string_view label, std::string_view remainder, int line) const override
 	{
 		auto sizeToken = parser::instance().extract_token_ws_comma(remainder);
 		if (!sizeToken.has_value())
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! There is no valid size!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		if (!isdigit(std::string(sizeToken.value())[0]))
+		if (!isdigit(sizeToken.value()[0]))
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! Invalid command size [";
 			msg << sizeToken.value() << "]!!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
 		bool tokensRemain = true;
@@ -153,12 +155,12 @@ public:
 			auto nameToken = parser::instance().extract_token_ws_comma(remainder);
 			if (nameToken.has_value())
 			{
-				std::string nameTokenString = std::string(nameToken.value());
+				std::string_view nameTokenString = nameToken.value();
 
-				if (assembler.echoParsedMajor() && assembler.echoArchitecture())
-					std::cout << "          *** Adding " << std::string(sizeToken.value()) << "-bit Register [" << nameTokenString << "]\n";
+				if (logEnabled(LogLevel::ParsedMajor) && logEnabled(LogLevel::Architecture))
+					logLine() << "          *** Adding " << sizeToken.value() << "-bit Register [" << nameTokenString << "]\n";
 
-				assembler.addRegister(nameTokenString, stoi(std::string(sizeToken.value())), line);
+				assembler.addRegister(nameTokenString, static_cast<int>(literal(sizeToken.value(), label, line, 8)), line);
 			}
 			else
 			{
@@ -166,15 +168,15 @@ public:
 			}
 		}
 
-		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
-			std::cout << "\n";
+		if (logEnabled(LogLevel::ParsedMajor) && logEnabled(LogLevel::Architecture))
+			logLine() << "\n";
 	}
 };
 
 class archFlagDevice : public command
 {
 public:
-	void process(assembler& assembler, const std::string& label, std::string remainder, int line) const override
+	void process(assembler& assembler, std::string_view label, std::string_view remainder, int line) const override
 	{
 		bool tokensRemain = true;
 		while (tokensRemain)
@@ -182,15 +184,15 @@ public:
 			auto nameToken = parser::instance().extract_token_ws_comma(remainder);
 			if (nameToken.has_value())
 			{
-				std::string nameTokenString = std::string(nameToken.value());
+				std::string_view nameTokenString = nameToken.value();
 
-				if (assembler.echoParsedMajor() && assembler.echoArchitecture())
+				if (logEnabled(LogLevel::ParsedMajor) && logEnabled(LogLevel::Architecture))
 				{
 					if (label == FLAG_STR)
-						std::cout << "          *** Adding flag [" << nameTokenString << "]\n";
+						logLine() << "          *** Adding flag [" << nameTokenString << "]\n";
 
 					if (label == DEVICE_STR)
-						std::cout << "          *** Adding device [" << nameTokenString << "]\n";
+						logLine() << "          *** Adding device [" << nameTokenString << "]\n";
 				}
 
 				if (label == FLAG_STR)
@@ -202,149 +204,60 @@ public:
 			}
 		}
 
-		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
-			std::cout << "\n";
+		if (logEnabled(LogLevel::ParsedMajor) && logEnabled(LogLevel::Architecture))
+			logLine() << "\n";
 	}
 };
 
 class archControlLine : public command
 {
 public:
-	void process(assembler& assembler, const std::string& label, std::string remainder, int line) const override
+	void process(assembler& assembler, std::string_view label, std::string_view remainder, int line) const override
 	{
 		auto nameToken = parser::instance().extract_token_ws(remainder);
 		if (!nameToken.has_value())
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! No label provided for control line!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		if (std::string(nameToken.value()) == "fetch")
-			std::cout << "";
+		int finalNum = assembler.evaluateControl(remainder, label, line);
 
-		bool tokensRemain = true;
-		int firstNum = -1;
-		int op = 0;
-		int secondNum = -1;
-		while (tokensRemain)
+		if (logEnabled(LogLevel::ParsedMajor))
 		{
-			// Get the rest of 
-			auto nextToken = parser::instance().extract_token_ws_comma(remainder);
-			if (nextToken.has_value())
-			{
-				std::string tokenString = std::string(nextToken.value());
-				LiteralNumType type = parser::instance().get_num_type(tokenString);
+			logLine out;
+			out << "          *** Saving control line = ";
+			out << " = $" << hex8 << finalNum;
 
-				if (type != LiteralNumType::None)
-				{
-					int num = parser::instance().parse_literal_num(tokenString, type);
-					if (num != -1)
-					{
-						if (op == 0) firstNum = num;
-						else         secondNum = num;
-					}
-					else
-					{
-						std::stringstream msg;
-						msg << "Assembling command " << label << " at line <" << line << ">! Bad int literal parse type!";
-						throw std::exception(msg.str().c_str());
-					}
-				}
-				else
-				{
-					if (tokenString[0] == '<' && tokenString[1] == '<') op = -1;
-					else if (tokenString[0] == '>' && tokenString[1] == '>') op = 1;
-					else
-					{
-						if (!isdigit(tokenString.c_str()[0]))
-						{
-							if (tokenString[0] == '|')
-							{
-								op = Operation::OR;
-							}
-							else if (tokenString[0] == '=')
-							{
-								continue;
-							}
-							else
-							{
-								if (firstNum == -1)
-									firstNum = 0;
-
-								if (op == Operation::OR)
-								{
-									if (tokenString[0] == '_')
-										firstNum = firstNum ^ assembler.getSymbolAddress(tokenString);
-									else
-										firstNum = firstNum | assembler.getSymbolAddress(tokenString);
-
-									op = Operation::None;
-								}
-								else
-								{
-									firstNum = assembler.getSymbolAddress(tokenString);
-								}
-							}
-						}
-						else
-						{
-							std::stringstream msg;
-							msg << "Assembling command " << label << " at line <" << line << ">! Expected a symbol reference -- found !" << tokenString;
-							throw std::exception(msg.str().c_str());
-						}
-					}
-				}
-			}
-			else
-			{
-				tokensRemain = false;
-			}
-		}
-
-		int finalNum = -1;
-		if (op != 0)
-		{
-			if (op == -1) finalNum = firstNum << secondNum;
-			if (op == 1)  finalNum = firstNum >> secondNum;
-		}
-		else
-		{
-			finalNum = firstNum;
-		}
-
-		if (assembler.echoParsedMajor())
-		{
-			std::cout << "          *** Saving control line = ";
-			std::cout << " = $" << hex8 << finalNum;
+			if (logEnabled(LogLevel::ParsedMinor))
+				out << " = %" << std::bitset<sizeof(int) * 8>(finalNum);
 
-			if (assembler.echoParsedMinor())
-				std::cout << " = %" << std::bitset<sizeof(int) * 8>(finalNum);
-
-			std::cout << "\n\n";
+			out << "\n\n";
 		}
 
-		assembler.addControlLine(std::string(nameToken.value()), finalNum, line);
+		assembler.addControlLine(nameToken.value(), finalNum, line);
 	}
 };
 
 class archOpcode : public command
 {
 public:
-	virtual void process(assembler& assembler, const std::string& label, std::string remainder, int line) const override
+	virtual void process(assembler& assembler, std::string_view label, std::string_view remainder, int line) const override
 	{
-		opcode opcode;
+		opcode opcode(assembler.archAllocator());
 
 		auto valueToken = parser::instance().extract_token_ws_comma(remainder);
 		if (!valueToken.has_value())
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! Opcode is not assigned a valid value!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		std::string valueString = std::string(valueToken.value());
-		int parsedValue = parser::instance().parse_literal_num(valueString);
+		// the value has to fit the instruction width (and an int, whatever the width)
+		const int width = assembler.getInstructionWidth();
+		int parsedValue = static_cast<int>(literal(valueToken.value(), label, line, width > 0 ? std::min(width * 8, 31) : 31));
 
 		opcode.setValue(parsedValue);
 
@@ -353,32 +266,29 @@ public:
 		{
 			std::stringstream msg;
 			msg << "Assembling command " << label << " at line <" << line << ">! Opcode is not assigned a valid label!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
 		opcode.setMnemonic(std::string(nameToken.value()));
 
+		// The arguments are followed by an optional control expression (opcodes only)
+		std::string_view expression;
 		bool tokensRemain = true;
-		Operation op = Operation::None;
-		int seq = 0;
-		int num = -1;
 		while (tokensRemain)
 		{
+			std::string_view before = remainder;
 			auto nextToken = parser::instance().extract_token_ws_comma(remainder);
 
 			if (nextToken.has_value())
 			{
-				std::string tokenString = std::string(nextToken.value());
+				std::string_view tokenString = nextToken.value();
 
 				bool isAddress = parser::instance().try_strip_indirect(tokenString);
 
-				if (tokenString[0] == '|' && label != OPCODE_ALIAS_STR)
-				{
-					op = Operation::OR;
-				}
-				else if (tokenString[0] == '=' && label != OPCODE_ALIAS_STR)
+				if ((tokenString[0] == '|' || tokenString[0] == '=') && label != OPCODE_ALIAS_STR)
 				{
-					continue;
+					expression = before;
+					tokensRemain = false;
 				}
 				else if (tokenString[0] == '#')
 				{
@@ -396,12 +306,12 @@ public:
 
 					opcode.addArgument(newArg);
 
-					if (assembler.echoParsedMinor() && assembler.echoArchitecture())
+					if (logEnabled(LogLevel::ParsedMinor) && logEnabled(LogLevel::Architecture))
 					{
 						if (!isAddress)
-							std::cout << "					*** Adding an immediate value argument = " << newArg._string << "\n";
+							logLine() << "					*** Adding an immediate value argument = " << newArg._string << "\n";
 						else
-							std::cout << "					*** Adding a dereferenced value argument = " << newArg._string << "\n";
+							logLine() << "					*** Adding a dereferenced value argument = " << newArg._string << "\n";
 					}
 				}
 				else if (assembler.getSymbolType(tokenString) == SymbolType::Register)
@@ -410,42 +320,28 @@ public:
 					if (isAddress)
 					{
 						newArg._type = ArgType::DerefReg;
-						newArg._string = "[" + tokenString + "]";
+						newArg._string = "[" + std::string(tokenString) + "]";
 					}
 					else
 					{
 						newArg._type = ArgType::Register;
-						newArg._string = tokenString;
+						newArg._string = std::string(tokenString);
 					}
 
 					opcode.addArgument(newArg);
 
-					if (assembler.echoParsedMinor() && assembler.echoArchitecture())
+					if (logEnabled(LogLevel::ParsedMinor) && logEnabled(LogLevel::Architecture))
 					{
 						if (!isAddress)
-							std::cout << "					*** Adding a register value argument = " << newArg._string << "\n";
+							logLine() << "					*** Adding a register value argument = " << newArg._string << "\n";
 						else
-							std::cout << "					*** Adding a dereferenced register value argument = " << newArg._string << "\n";
+							logLine() << "					*** Adding a dereferenced register value argument = " << newArg._string << "\n";
 					}
 				}
 				else if (label != OPCODE_ALIAS_STR)
 				{
-					if (num == -1)
-						num = 0;
-
-					if (op == Operation::OR)
-					{
-						if (tokenString[0] == '_')
-							num = num ^ assembler.getSymbolAddress(tokenString);
-						else
-							num = num | assembler.getSymbolAddress(tokenString);
-
-						op = Operation::None;
-					}
-					else
-					{
-						num = assembler.getSymbolAddress(tokenString);
-					}
+					expression = before;
+					tokensRemain = false;
 				}
 			}
 			else
@@ -454,55 +350,53 @@ public:
 			}
 		}
 
-		assembler.addOpcode(parsedValue, opcode);
-
-		if (num != -1 && label != OPCODE_ALIAS_STR)
+		if (label == OPCODE_ALIAS_STR)
+		{
+			assembler.addOpcodeAlias(parsedValue, opcode);
+		}
+		else
 		{
-			controlPattern cp;
-			cp.pattern = num;
+			assembler.addOpcode(parsedValue, opcode);
 
-			for (int i = 0; i < pow(2, assembler.getFlagCount()); i++)
+			// the inline expression is the first cycle (more can follow with seq lines)
+			if (!expression.empty())
 			{
-				cp.flags.push_back(i);
-				cp.type = PatternType::Seq;
+				microBranch b;
+				b.pattern = static_cast<uint32_t>(assembler.evaluateControl(expression, label, line));
+				assembler.addCycle(b);
 			}
-
-			opcode.addNewControlPattern(cp);
 		}
 
-		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
+		if (logEnabled(LogLevel::ParsedMajor) && logEnabled(LogLevel::Architecture))
 		{
-			std::cout << "          *** Saving opcode " << std::string(nameToken.value()) << " ";
+			logLine out;
+			out << "          *** Saving opcode " << nameToken.value() << " ";
 
 			for (int i = 0; i < opcode.numArgs(); i++)
 			{
-				std::cout << opcode.getArg(i)._string;
+				out << opcode.getArg(i)._string;
 
 				if (i != opcode.numArgs() - 1)
-					std::cout << ", ";
+					out << ", ";
 			}
 
 			if (label != OPCODE_ALIAS_STR)
-				std::cout << " -- val = $";
+				out << " -- val = $";
 			else
-				std::cout << " -- to existing opcode with val = $";
+				out << " -- to existing opcode with val = $";
 
-			std::cout << hex2 << opcode.value();
+			out << hex2 << opcode.value();
 
 			if (label != OPCODE_ALIAS_STR)
 			{
-				std::cout << ", control sequence : ";
-				for (int i = 0; i < opcode.numCycles(); i++)
-				{
-					for (int j = 0; j < opcode.getPatterns(i).cpattern[0].flags.size(); i++)
-					{
-						controlPattern p = opcode.getPatterns(i).cpattern[0];
-						std::cout << "              " << dec << i << ": $" << hex8 << p.pattern << " and flag pattern = " << p.flags[j] << "\n";
-					}
-				}
+				out << ", control sequence : ";
+
+				const microcodeStore& microcode = assembler.getMicrocode();
+				if (microcode.lastCycle() >= 0)
+					out << "$" << hex8 << microcode.pattern(microcode.firstBranch(microcode.lastCycle()));
 			}
 
-			std::cout << ", unique_str = " << opcode.getUniqueString() << "\n";
+			out << ", unique_str = " << opcode.getUniqueString() << "\n";
 		}
 	}
 };
@@ -510,102 +404,89 @@ public:
 class archOpcodeSeq : public command
 {
 public:
-	void process(assembler& assembler, const std::string& label, std::string remainder, int line) const override
+	void process(assembler& assembler, std::string_view label, std::string_view remainder, int line) const override
 	{
-		bool tokensRemain = true;
-		bool colonFound = false;
-		Operation op = Operation::None;
-
-		assembler.lastAddedFlags.clear();
+		if (assembler.lastOpcodeIndex() < 0)
+		{
+			std::stringstream msg;
+			msg << "Assembling command " << label << " at line <" << line << ">! There is no opcode for this sequence!";
+			throw std::runtime_error(msg.str());
+		}
 
-		controlPattern cp;
-		int num = 0;
-		while (tokensRemain)
+		// seq_elif and seq_else add branches to the cycle started by a seq_if
+		const bool branch = label == OPCODE_SEQ_ELIF_STR || label == OPCODE_SEQ_ELSE_STR;
+		if (branch)
 		{
-			auto nextToken = parser::instance().extract_token_ws_comma(remainder);
+			const microcodeStore& microcode = assembler.getMicrocode();
+			const int cycle = microcode.lastCycle();
+			const PatternType last = cycle < 0 ? PatternType::None : microcode.type(microcode.firstBranch(cycle) + microcode.numBranches(cycle) - 1);
 
-			if (nextToken.has_value())
+			if (last != PatternType::Seq_If && last != PatternType::Seq_Elif)
 			{
-				std::string tokenString = std::string(nextToken.value());
+				std::stringstream msg;
+				msg << "Assembling command " << label << " at line <" << line << ">! There is no seq_if for this " << label << "!";
+				throw std::runtime_error(msg.str());
+			}
+		}
 
-				if (tokenString[0] == ':')
-				{
-					colonFound = true;
-				}
-				else if (tokenString[0] == '|')
-				{
-					op = Operation::OR;
-				}
-				else if (tokenString[0] == '=')
+		// seq_if xxxx1 : expression -- the flag conditions come before the colon, and each one
+		// becomes a branch of its own
+		std::vector<flagCondition> conditions;
+		if (label == OPCODE_SEQ_IF_STR || label == OPCODE_SEQ_ELIF_STR)
+		{
+			size_t colon = remainder.find(':');
+			std::string_view text = remainder.substr(0, colon);
+			remainder = colon == std::string_view::npos ? std::string_view() : remainder.substr(colon + 1);
+
+			while (auto nextToken = parser::instance().extract_token_ws_comma(text))
+			{
+				flagCondition c;
+				if (!flagCondition::parse(nextToken.value(), assembler.getFlagCount(), c))
 				{
-					continue;
+					std::stringstream msg;
+					msg << "Assembling command " << label << " at line <" << line << ">! Invalid flag condition [" << nextToken.value() << "]!";
+					throw std::runtime_error(msg.str());
 				}
-				else
-				{
-					if (!colonFound && label == OPCODE_SEQ_IF_STR)
-					{
-						int nFlags = assembler.getFlagCount();
-						for (int i = 0; i < pow(2, nFlags); i++)
-						{
-							std::string currFlag = std::bitset<5>(i).to_string();
-
-							bool patternMatch = true;
-							for (int j = 0; j < nFlags; j++)
-							{
-								bool digit_j_matches = tokenString[j] == 'x' || tokenString[j] == currFlag[j];
-								patternMatch = patternMatch && digit_j_matches;
-							}
-
-							if (patternMatch)
-							{
-								cp.flags.push_back(i);
-								assembler.lastAddedFlags.push_back(i);
-							}
-						}
-					}
-					else if (op == Operation::OR)
-					{
-						if (tokenString[0] == '_')
-							num = num ^ assembler.getSymbolAddress(tokenString);
-						else
-							num = num | assembler.getSymbolAddress(tokenString);
 
-						op = Operation::None;
-					}
-					else
-					{
-						num = assembler.getSymbolAddress(tokenString);
-					}
-				}
+				conditions.push_back(c);
 			}
-			else
+
+			if (conditions.empty() || colon == std::string_view::npos)
 			{
-				tokensRemain = false;
+				std::stringstream msg;
+				msg << "Assembling command " << label << " at line <" << line << ">! Expected flag conditions followed by a ':'!";
+				throw std::runtime_error(msg.str());
 			}
 		}
-
-		cp.pattern = num;
-
-		if (label == OPCODE_SEQ_STR) cp.type = PatternType::Seq;
-		if (label == OPCODE_SEQ_IF_STR) cp.type = PatternType::Seq_If;
-		if (label == OPCODE_SEQ_ELSE_STR) cp.type = PatternType::Seq_Else;
-
-		if (label != OPCODE_SEQ_IF_STR)
+		else
 		{
-			for (int i = 0; i < pow(2, assembler.getFlagCount()); i++)
-			{
-				cp.flags.push_back(i);
-			}
+			// seq and seq_else hold for every flag state
+			conditions.push_back(flagCondition());
 		}
 
-		assembler.addNewControlPatternToCurrentOpcode(cp);
+		microBranch b;
+		b.pattern = static_cast<uint32_t>(assembler.evaluateControl(remainder, label, line));
 
-		opcode opcode = assembler.getOpcode(assembler.lastOpcodeIndex());
+		if (label == OPCODE_SEQ_STR) b.type = PatternType::Seq;
+		if (label == OPCODE_SEQ_IF_STR) b.type = PatternType::Seq_If;
+		if (label == OPCODE_SEQ_ELIF_STR) b.type = PatternType::Seq_Elif;
+		if (label == OPCODE_SEQ_ELSE_STR) b.type = PatternType::Seq_Else;
 
-		if (assembler.echoParsedMajor() && assembler.echoArchitecture())
+		for (size_t i = 0; i < conditions.size(); i++)
 		{
-			for (int i = 0; i < cp.flags.size(); i++)
-				std::cout << "              *** new cycle added = $" << hex8 << num << " with flag pattern = " << cp.flags[i] << "\n";
+			b.when = conditions[i];
+
+			if (i == 0 && !branch)
+				assembler.addCycle(b);
+			else
+				assembler.addBranch(b);
+
+			if (logEnabled(LogLevel::ParsedMajor) && logEnabled(LogLevel::Architecture))
+			{
+				logLine out;
+				out << "              *** " << (i == 0 && !branch ? "new cycle added" : "branch added") << " = $" << hex8 << b.pattern;
+				out << " with flag pattern = " << b.when.str(assembler.getFlagCount()) << "\n";
+			}
 		}
 	}
-};
\ No newline at end of file
+};
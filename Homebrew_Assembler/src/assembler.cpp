@@ -1,366 +1,1201 @@
 #include "assembler.h"
 #include "parser.h"
 #include "config.h"
-#include "directive.h"
-#include "archtag.h"
+#include "keyword.h"
 #include "instruction.h"
-
+#include "redundancy.h"
+#include "controlpack.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+// every instruction line goes through this one handler (directives and architecture tags go
+// through the keyword table, see keyword.cpp)
+static const opcodeInstruction instruction;
 
-assembler::assembler(std::string filename)
+assembler::assembler(std::string filename, std::shared_ptr<const architecture> shared)
 {
-	// set file exceptions, save the start file, add to file stack
-	_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	// save the start file and set up the default include search path
 	_startFile = filename;
+	_includes.addSearchPath(DEFAULT_INCLUDE_PATH);
 
-	registerOperations();
+	_arch = std::move(shared);
+	_sharedArch = _arch != nullptr;
 }
 
-void assembler::registerOperations()
+void assembler::assemble()
 {
-	registerDirective<includeDirective>(INCLUDE_STR);
-	registerDirective<originDirective>(ORIGIN_STR);
+	// stays set if anything below throws, so the next reassemble starts from scratch
+	_needsFullRebuild = true;
+
+	reset();
+
+	// the start file itself may be a precompiled architecture, leaving nothing to walk
+	if (pushFile(_startFile) == IncludeResult::Pushed)
+	{
+		// read and lex the whole include tree in parallel before walking it
+		_lexer.prefetch(_fileStack[_fileStackIndex].file);
+
+		_rootFile = _fileStack[_fileStackIndex].file;
+
+		processFile();
+		pass0();
+	}
+
+	// a shared architecture was finished by the assembler that read it
+	if (!_sharedArch)
+	{
+		buildMatcher();
+		buildDecoderRom();
+
+		for (int id = 0; id < _includes.count(); id++)
+		{
+			if (_includes.isIncluded(id))
+				_building->files.push_back(_includes.canonicalName(id));
+		}
+	}
+
+	if (_decoderReport)
+		microcodeRedundancy(arch()).summary();
+
+	if (_controlPacking)
+		packControls();
+
+	pass1();
+	writeRoms(!_sharedArch);
 
-	registerArchTag<archBitWidth>(INSTRUCTION_WIDTH_STR);
-	registerArchTag<archBitWidth>(ADDRESS_WIDTH_STR);
-	registerArchTag<archRom>(DECODER_ROM_STR);
-	registerArchTag<archRom>(PROGRAM_ROM_STR);
-	registerArchTag<archRegister>(REGISTER_STR);
-	registerArchTag<archFlagDevice>(FLAG_STR);
-	registerArchTag<archFlagDevice>(DEVICE_STR);
-	registerArchTag<archControlLine>(CONTROL_STR);
-	registerArchTag<archOpcode>(OPCODE_STR);
-	registerArchTag<archOpcode>(OPCODE_ALIAS_STR);
-	registerArchTag<archOpcodeSeq>(OPCODE_SEQ_STR);
-	registerArchTag<archOpcodeSeq>(OPCODE_SEQ_IF_STR);
-	registerArchTag<archOpcodeSeq>(OPCODE_SEQ_ELSE_STR);
+	// remember what each file contributed to the architecture (see reassemble)
+	_archFingerprints.assign(_includes.count(), 0);
+	for (int id = 0; id < _includes.count(); id++)
+		_archFingerprints[id] = archFingerprint(_lexer.get(id));
 
-	registerInstruction<opcodeInstruction>(OPCODE_STR);
+	_needsFullRebuild = false;
 }
 
-void assembler::assemble()
+bool assembler::reassemble(const std::vector<int>& changedFiles)
 {
-	pushFile(_startFile);
-	processFile();
-	pass0();
+	// drop the old token streams before their mappings are replaced
+	for (int id : changedFiles)
+	{
+		_lexer.invalidate(id);
+		_includes.reload(id);
+	}
+
+	_lexer.relex(changedFiles);
+
+	bool rebuild = _needsFullRebuild;
+	for (int id : changedFiles)
+	{
+		if (id >= static_cast<int>(_archFingerprints.size()) || archFingerprint(_lexer.get(id)) != _archFingerprints[id])
+			rebuild = true;
+	}
+
+	// The architecture or include tree changed, so walk it again. Only the files that changed
+	// were lexed again, all the others keep their token streams.
+	if (rebuild)
+	{
+		_includes.refresh();
+		assemble();
+	}
+	else if (!changedFiles.empty())
+	{
+		resetProgram();
+		pass1();
+		writeRoms(false);
+	}
+
+	return rebuild;
 }
 
-void assembler::pushFile(std::string filename)
+void assembler::reset()
 {
+	// file stuff
+	_fileStack.clear();
+	_fileStackIndex = -1;
+	_location = sourceLocation();
+	_rootFile = -1;
+	_walked.clear();
+	_includes.resetIncluded();
+	_archRecording.reset();
+	_archRecordingIndex = -1;
+
+	// a shared architecture stays as it is, otherwise a new one is read (anyone still holding
+	// the previous one keeps it alive)
+	if (!_sharedArch)
+	{
+		auto fresh = std::make_shared<architecture>();
+		_building = fresh.get();
+		_arch = std::move(fresh);
+	}
+
+	resetProgram();
+}
+
+void assembler::resetProgram()
+{
+	// symbol stuff
+	_symbols.clear();
+
+	// addressing stuff
+	_address = 0;
+	_last_address = -1;
+	_max_address = 0;
+
+	// rom stuff
+	_programRom.clear();
+	_segments.clear();
+	_activeSegmentIndex = 0;
+	resetVector(_fixups, &_arena);
+	resetVector(_code, &_arena);
+	resetVector(_budgets, &_arena);
+
+	// nothing above holds on to arena memory any more, so give it all back at once
+	_arena.release();
+
+	// a finished architecture (shared, or kept by reassemble) already has its program rom layout
+	if (arch().programInputs > 0)
+		setupProgramRom();
+}
+
+architecture& assembler::building()
+{
+	if (_building == nullptr)
+	{
+		std::stringstream msg;
+		msg << "The architecture is shared, it can not be changed by [" << _startFile << "]!";
+		throw std::runtime_error(msg.str());
+	}
+
+	return *_building;
+}
+
+uint64_t assembler::archFingerprint(const lexedFile& file) const
+{
+	// hash the token and trimmed remainder of every pass0 line
+	uint64_t hash = FNV_OFFSET_BASIS;
+	for (const lexedLine& line : file.lines)
+	{
+		if (keywords::isPass0(line.keyword))
+		{
+			hash = fnv1a(line.token, hash);
+			hash = fnv1a(" ", hash);
+			hash = fnv1a(parser::instance().get_trimmed(line.remainder), hash);
+			hash = fnv1a("\n", hash);
+		}
+	}
+
+	return hash;
+}
+
+std::vector<int> assembler::includeClosure(int id)
+{
+	std::vector<int> files = { id };
+	std::unordered_set<int> seen = { id };
+
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		for (std::string_view name : _lexer.get(files[i]).includes)
+		{
+			int child = _includes.resolve(name, files[i]);
+			if (seen.insert(child).second)
+				files.push_back(child);
+		}
+	}
+
+	return files;
+}
+
+uint64_t assembler::contentHash(const std::vector<int>& files) const
+{
+	// the closure is in include order, so renaming or reordering includes changes the hash too
+	uint64_t hash = FNV_OFFSET_BASIS;
+	for (int id : files)
+	{
+		hash = fnv1a(_includes.canonicalName(id), hash);
+		hash = fnv1a("\n", hash);
+		hash = fnv1a(_includes.file(id).text(), hash);
+	}
+
+	return hash;
+}
+
+IncludeResult assembler::pushFile(std::string_view filename)
+{
+	int parentFile = _fileStackIndex != -1 ? _fileStack[_fileStackIndex].file : -1;
+	int id = _includes.resolve(filename, parentFile);
+
+	// every file is only ever included once
+	if (!_includes.markIncluded(id))
+		return IncludeResult::Skipped;
+
+	// the files of a shared architecture were already read, by the assembler that owns it
+	if (_sharedArch && arch().hasFile(_includes.canonicalName(id)))
+	{
+		LOG(LogLevel::MajorTasks) << "\nUsing shared architecture : " << _includes.name(id) << "\n";
+		return IncludeResult::Precompiled;
+	}
+
+	// Architecture files are loaded from their precompiled image when it is up to date. If it
+	// isn't, the file is parsed as usual and recorded so a new image can be saved afterwards.
+	if (_useArchImages && !_archRecording && std::filesystem::path(_includes.name(id)).extension() == ARCH_FILE_EXT)
+	{
+		std::vector<int> closure = includeClosure(id);
+		uint64_t hash = contentHash(closure);
+
+		if (archImage::tryLoad(*this, archImage::imageName(_includes.name(id)), hash))
+		{
+			for (int file : closure)
+				_includes.markIncluded(file);
+
+			LOG(LogLevel::MajorTasks) << "\nLoaded precompiled architecture : " << archImage::imageName(_includes.name(id)) << "\n";
+
+			return IncludeResult::Precompiled;
+		}
+
+		_archRecording = std::make_unique<archImageBuilder>();
+		_archRecordingIndex = static_cast<int>(_fileStack.size());
+		_archRecordingHash = hash;
+	}
+
+	if (static_cast<int>(_walked.size()) <= id)
+		_walked.resize(id + 1, 0);
+	_walked[id] = 1;
+
 	fileStackEntry entry;
-	entry.filename = filename;
 	entry.parentIndex = _fileStackIndex;
-	entry.startLine = 0;
-
-	if (_fileStackIndex != -1)
-		_fileStack[_fileStackIndex].startLine = _lineNumber + 1;
+	entry.file = id;
 
 	_fileStack.push_back(entry);
-	_fileStackIndex = _fileStack.size() - 1;
+	_fileStackIndex = static_cast<int>(_fileStack.size()) - 1;
+
+	return IncludeResult::Pushed;
 }
 
-void assembler::processFile()
+void assembler::finishArchRecording()
 {
-	if (_file.is_open())
-		_file.close();
+	const std::string image = archImage::imageName(_includes.name(_fileStack[_archRecordingIndex].file));
 
-	_file.open(_fileStack[_fileStackIndex].filename);
+	if (archImage::write(*this, *_archRecording, image, _archRecordingHash))
+	{
+		if (logEnabled(LogLevel::MajorTasks))
+			logLine() << "\nSaved precompiled architecture : " << image << "\n";
+	}
+	else if (logEnabled(LogLevel::Warnings))
+		logLine() << "\nWARNING: Unable to save precompiled architecture [" << image << "]\n";
 
-	if (_echo_major_tasks)
-		std::cout << "\nProcessing file : " << _fileStack[_fileStackIndex].filename << "\n\n";
+	_archRecording.reset();
+	_archRecordingIndex = -1;
 }
 
-void assembler::pass0()
+// A value operand is as wide as the register it goes with (mov a, #), or as an address when the
+// form has no register or the value is one ([#], jmp #). Fills in one width per value operand.
+static void operandWidths(opcode& oc, const symbolTable& symbols, int addressWidth, uint8_t* widths)
 {
-	std::string line;
-	_lineNumber = 0;
+	int registerBytes = 0;
+	for (int i = 0; i < oc.numArgs() && registerBytes == 0; i++)
+	{
+		const symbol* s = oc.getArg(i)._type == ArgType::Register ? symbols.find(oc.getArg(i)._string) : nullptr;
+		if (s != nullptr)
+			registerBytes = (s->getAddress() + 7) / 8;
+	}
 
-	try
+	int n = 0;
+	for (int i = 0; i < oc.numArgs() && n < instructionMatch::MAX_OPERANDS; i++)
 	{
-		while (std::getline(_file, line))
+		switch (oc.getArg(i)._type)
 		{
-			int startLine = _fileStack[_fileStackIndex].startLine;
+		case ArgType::Numeral:
+		case ArgType::Ascii:
+			widths[n++] = static_cast<uint8_t>(registerBytes > 0 ? registerBytes : addressWidth);
+			break;
+
+		case ArgType::DerefNum:
+		case ArgType::DerefAscii:
+			widths[n++] = static_cast<uint8_t>(addressWidth);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
 
-			if (startLine < _lineNumber && _lastFileStackIndex != _fileStackIndex) _lineNumber = startLine;
-			_lastFileStackIndex = _fileStackIndex;
+void assembler::buildMatcher()
+{
+	architecture& a = building();
+	a.matcher.clear();
 
-			if (startLine != 0 && _lineNumber < startLine)
-			{
-				_lineNumber++;
-				continue;
-			}
+	const size_t perOpcode = instructionMatch::MAX_OPERANDS;
+	a.operandBytes.assign(a.opcodes.size() * perOpcode, 0);
+	a.aliasOperandBytes.assign(a.opcodeAliases.size() * perOpcode, 0);
 
-			if (_echo_source)
-				std::cout << "     ==> source line #" << _lineNumber << " = " << line << "\n";
-
-			// remove any comments and extract token
-			parser::instance().strip_comment(line);
-			auto token = parser::instance().extract_token_ws(line);
-			std::string tokenString = "";
-
-			if (token.has_value())
-				tokenString = std::string(token.value());
-			
-			// for first pass, only process include directives or arch definitions
-			if (tokenString == ".include" || tokenString == REGISTER_STR || tokenString == FLAG_STR ||
-				tokenString == DEVICE_STR || tokenString == CONTROL_STR || tokenString == OPCODE_STR ||
-				tokenString == OPCODE_ALIAS_STR || tokenString == OPCODE_SEQ_STR ||
-				tokenString == OPCODE_SEQ_IF_STR || tokenString == OPCODE_SEQ_ELSE_STR ||
-				tokenString == END_ARCH_STR || tokenString == INSTRUCTION_WIDTH_STR ||
-				tokenString == ADDRESS_WIDTH_STR || tokenString == PROGRAM_ROM_STR ||
-				tokenString == DECODER_ROM_STR)
-				processLine(line, _lineNumber, token);
-
-			_lineNumber++;
+	for (int v = 0; v < opcodeLimit(); v++)
+	{
+		if (a.opcodes[v].defined())
+		{
+			a.matcher.addOpcode(a.opcodes[v], v, false);
+			operandWidths(a.opcodes[v], a.symbols, a.addressWidth, &a.operandBytes[v * perOpcode]);
 		}
 	}
-	catch (const std::ifstream::failure& e)
+
+	for (int v = 0; v < opcodeAliasLimit(); v++)
 	{
-		if (!_file.eof())
+		if (a.opcodeAliases[v].defined())
 		{
-			throw e;
+			a.matcher.addOpcode(a.opcodeAliases[v], v, true);
+			operandWidths(a.opcodeAliases[v], a.symbols, a.addressWidth, &a.aliasOperandBytes[v * perOpcode]);
 		}
-		else
+	}
+}
+
+void assembler::buildDecoderRom()
+{
+	architecture& a = building();
+	a.decoder.clear();
+
+	// no decoder_rom in the architecture
+	if (a.decoderInputs <= 0)
+		return;
+
+	decoderLayout layout;
+	layout.opcodeBits = a.instructionWidth * 8;
+	layout.flagBits = a.nFlags;
+	layout.cycleBits = a.decoderInputs - layout.opcodeBits - layout.flagBits;
+
+	auto start = std::chrono::steady_clock::now();
+	a.decoder.generate(a.microcode, layout);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	LOG(LogLevel::MajorTasks) << "\nGenerated decoder rom : " << a.decoder.size() << " words of " << a.decoder.wordBits() << " bits in "
+		<< elapsed.count() << " ms\n";
+}
+
+romImage assembler::decoderRomImage() const
+{
+	romImage image;
+	image.words = arch().decoder.size();
+	image.bits = std::max(arch().decoderOutputs, arch().decoder.wordBits());
+
+	const uint32_t* words = arch().decoder.data();
+	image.fetch = [words](size_t first, size_t n, uint32_t* out) { memcpy(out, words + first, n * sizeof(uint32_t)); };
+	return image;
+}
+
+romImage assembler::programRomImage() const
+{
+	// the image holds every word as (outputs + 7) / 8 little-endian bytes
+	const int wordBytes = (arch().programOutputs + 7) / 8;
+
+	romImage image;
+	image.words = _programRom.size() / wordBytes;
+	image.bits = arch().programOutputs;
+
+	const programImage* rom = &_programRom;
+	image.fetch = [rom, wordBytes](size_t first, size_t n, uint32_t* out)
+	{
+		std::vector<uint8_t> bytes(n * wordBytes);
+		rom->read(static_cast<uint32_t>(first * wordBytes), bytes.data(), bytes.size());
+
+		for (size_t i = 0; i < n; i++)
+		{
+			uint32_t word = 0;
+			for (int b = 0; b < wordBytes; b++)
+				word |= uint32_t(bytes[i * wordBytes + b]) << (8 * b);
+
+			out[i] = word;
+		}
+	};
+	return image;
+}
+
+void assembler::writeRoms(bool decoder)
+{
+	if (logEnabled(LogLevel::RomData))
+	{
+		if (decoder && !arch().decoder.empty())
+		{
+			logLine out;
+			out << "\nDecoder rom :\n";
+			dumpRomImage(out.stream(), decoderRomImage());
+		}
+
+		if (_programRom.size() > 0)
+		{
+			logLine out;
+			out << "\nProgram rom :\n";
+			dumpRomImage(out.stream(), programRomImage());
+		}
+	}
+
+	if (decoder && arch().writeDecoderRom)
+		writeDecoderRom();
+
+	if (arch().writeProgramRom)
+		writeProgramRom();
+}
+
+// echoes the files written for every chip, with the chip's checksum
+static void echoRomFiles(const char* what, const std::vector<romChip>& chips)
+{
+	logLine out;
+	out << "\nSaved " << what << " : " << chips.size() << " chip(s)\n";
+	for (size_t c = 0; c < chips.size(); c++)
+	{
+		out << dec << "  chip " << c << " crc32 $" << hex8 << chips[c].crc << " :";
+		for (const std::string& file : chips[c].files)
+			out << " " << file;
+
+		out << "\n";
+	}
+}
+
+void assembler::packControls() const
+{
+	controlPacker packer(arch());
+	packer.optimize(CONTROL_PACK_ITERATIONS);
+	packer.summary();
+
+	if (_controlPackFile.empty())
+		return;
+
+	std::ofstream out(_controlPackFile, std::ios::binary);
+	out << packer.controlSection();
+	if (!out)
+	{
+		std::stringstream msg;
+		msg << "Could not write the packed control section to [" << _controlPackFile << "]!";
+		throw std::runtime_error(msg.str());
+	}
+
+	LOG(LogLevel::MajorTasks) << "Saved packed control section : " << _controlPackFile << "\n";
+}
+
+void assembler::writeDecoderRom()
+{
+	if (arch().decoder.empty())
+		return;
+
+	std::filesystem::path base(_startFile);
+	base.replace_extension();
+
+	std::vector<romChip> chips = writeRomImage(decoderRomImage(), base.string() + DECODER_ROM_SUFFIX, _romFormats);
+
+	if (logEnabled(LogLevel::MajorTasks))
+		echoRomFiles("decoder rom", chips);
+}
+
+void assembler::writeProgramRom()
+{
+	// an empty image (nothing was emitted, e.g. for an architecture on its own) is not written
+	if (_programRom.pagesUsed() == 0)
+		return;
+
+	std::filesystem::path base(_startFile);
+	base.replace_extension();
+
+	std::vector<romChip> chips = writeRomImage(programRomImage(), base.string() + PROGRAM_ROM_SUFFIX, _romFormats);
+
+	if (logEnabled(LogLevel::MajorTasks))
+		echoRomFiles("program rom", chips);
+}
+
+void assembler::processFile()
+{
+	LOG(LogLevel::MajorTasks) << "\nProcessing file : " << _includes.name(_fileStack[_fileStackIndex].file) << "\n\n";
+}
+
+void assembler::pass0()
+{
+	while (_fileStackIndex != -1)
+	{
+		const int current = _fileStackIndex;
+		const int id = _fileStack[current].file;
+		const lexedFile& file = _lexer.get(id);
+
+		// an include directive pushes a new file, in which case we leave this loop and come back
+		// to the current one (at its saved line) once the included file is finished
+		while (_fileStackIndex == current && _fileStack[current].line < static_cast<int>(file.lines.size()))
 		{
-			_file.close();
-			_lastFileStackIndex = _fileStackIndex;
+			const int linenum = _fileStack[current].line++;
+			_location = sourceLocation(id, linenum);
+
+			const lexedLine& line = file.lines[linenum];
 
-			int parentIndex = _fileStack[_fileStackIndex].parentIndex;
-			if (_fileStackIndex >= 0 && parentIndex != -1)
+			LOG(LogLevel::Source) << "     ==> source line #" << linenum << " = " << line.text << "\n";
+
+			// for first pass, only process include directives or arch definitions (the closing
+			// brace of an opcode ends its echo)
+			if (keywords::isPass0(line.keyword))
+				keywords::dispatch(*this, line.keyword, line.remainder, linenum);
+			else if (line.token == "}")
 			{
-				_fileStackIndex = parentIndex;
-				
+				LOG(LogLevel::ParsedMajor) << "\n";
+			}
+		}
+
+		// end of this file, so return to the parent (if there is one)
+		if (_fileStackIndex == current)
+		{
+			if (_archRecording && current == _archRecordingIndex)
+				finishArchRecording();
+
+			_fileStackIndex = _fileStack[current].parentIndex;
+			_fileStack.pop_back();
+
+			if (_fileStackIndex != -1)
 				processFile();
-				pass0();
+		}
+	}
+}
+
+void assembler::pass1()
+{
+	if (_rootFile == -1)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+
+	_window.clear();
+	_peephole.reset();
+	if (_optimize)
+		_peephole = std::make_unique<peepholeOptimizer>(arch());
+
+	std::vector<char> visited(_includes.count(), 0);
+	pass1File(_rootFile, visited);
+	resolveFixups();
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	LOG(LogLevel::MajorTasks) << "\nAssembled program : " << _programRom.size() << " byte rom, " << _fixups.size() << " fixup(s) in "
+		<< elapsed.count() << " ms\n";
+
+	if (_peephole)
+	{
+		LOG(LogLevel::MajorTasks) << "Peephole optimizer : " << _peephole->removed() << " instruction(s) removed, "
+			<< _peephole->cyclesSaved() << " cycle(s) saved\n";
+
+		_peephole.reset();
+	}
+
+	if (_cycleAnalysis || !_budgets.empty())
+		analyzeCycles();
+}
+
+void assembler::pass1File(int id, std::vector<char>& visited)
+{
+	visited[id] = 1;
+
+	const lexedFile& file = _lexer.get(id);
+	size_t include = 0;
+
+	for (int linenum = 0; linenum < static_cast<int>(file.lines.size()); linenum++)
+	{
+		const lexedLine& line = file.lines[linenum];
+
+		// included files are assembled where they are included, like pass0 walked them
+		if (line.keyword == Keyword::Include)
+		{
+			flushWindow();
+
+			if (include < file.includes.size())
+			{
+				int child = _includes.resolve(file.includes[include++], id);
+				if (!visited[child] && child < static_cast<int>(_walked.size()) && _walked[child])
+					pass1File(child, visited);
 			}
+
+			continue;
 		}
+
+		// architecture lines were all handled by pass0, the rest of any file is program
+		if (line.token.empty() || keywords::isPass0(line.keyword))
+			continue;
+
+		_location = sourceLocation(id, linenum);
+		processLine(line, linenum);
 	}
+
+	flushWindow();
 }
 
-void assembler::processLine(std::string& line, int linenum, std::optional<std::string> token)
+void assembler::processLine(const lexedLine& line, int linenum)
 {
-	std::string tokenString = std::string(token.value());
+	std::string_view token = line.token;
+	std::string_view remainder = line.remainder;
+	Keyword keyword = line.keyword;
+
+	// a label takes the current address, and may be followed by an instruction on the same line
+	if (parser::instance().is_label(token))
+	{
+		// the label must get the address of the code after it, and nothing may move past it
+		flushWindow();
+
+		std::string_view name = token.substr(0, token.size() - 1);
+		if (findSymbol(name) != nullptr)
+		{
+			std::stringstream msg;
+			msg << "Label [" << name << "] at line <" << linenum << "> is already defined!";
+			throw std::runtime_error(msg.str());
+		}
+
+		addLabel(name, _address, linenum);
+
+		LOG(LogLevel::ParsedMajor) << "          *** Label " << name << " at $" << hex4 << _address << "\n";
+
+		auto next = parser::instance().extract_token_ws(remainder);
+		if (!next.has_value())
+			return;
+
+		token = next.value();
+		keyword = keywords::classify(token);
+	}
 
 	// skip tagged tokens (start with '#')
-	if (tokenString.front() == '#')
+	if (token.front() == '#')
+		return;
+
+	// ignore braces (pass0 echoes the end of an opcode)
+	if (token.front() == '{' || token.front() == '}')
 		return;
 
-	// ignore braces
-	if (tokenString.front() == '{' || tokenString.front() == '}')
+	if (keyword != Keyword::None)
+	{
+		flushWindow();
+		keywords::dispatch(*this, keyword, remainder, linenum);
+	}
+	else if (parser::instance().is_directive(token))
+	{
+		// only handle known directives
+		std::stringstream msg;
+		msg << "Unknown directive at line <" << linenum << ">! Found ["
+			<< token << "]";
+		throw std::runtime_error(msg.str());
+	}
+	else if (isAMnemonic(token))
+	{
+		instruction.process(*this, token, remainder, linenum);
+	}
+	else
+	{
+		std::stringstream msg;
+		msg << "Unknown instruction at line <" << linenum << ">! Found [" << token << "]";
+		throw std::runtime_error(msg.str());
+	}
+}
+
+void assembler::addInstruction(const instructionMatch& m, std::string_view mnemonic, std::string_view operands, int line)
+{
+	if (!_peephole)
 	{
-		if (tokenString.front() == '}' && _echo_parsed_major)
-			std::cout << "\n";
+		encodeInstruction(m, line);
+		return;
+	}
+
+	windowInstruction i;
+	i.match = m;
+	i.line = line;
+	i.where = _location;
+	_peephole->classify(i, mnemonic, operands);
 
+	_window.push_back(i);
+}
+
+void assembler::flushWindow()
+{
+	if (_window.empty())
 		return;
+
+	_peephole->optimize(_window);
+
+	// errors and fixups belong to the line each instruction came from
+	const sourceLocation location = _location;
+	for (const windowInstruction& i : _window)
+	{
+		_location = i.where;
+		encodeInstruction(i.match, i.line);
 	}
 
-	if (parser::instance().is_command(token.value()))
+	_location = location;
+	_window.clear();
+}
+
+void assembler::encodeInstruction(const instructionMatch& m, int line)
+{
+	const int address = _address;
+
+	programInstruction pi;
+	pi.address = static_cast<uint32_t>(address);
+	pi.value = m.value;
+	pi.alias = m.alias;
+	pi.where = _location;
+
+	// the opcode takes instruction_width bytes, then come the values in operand order
+	uint8_t oc[8] = {};
+	const int instructionWidth = std::min(std::max(arch().instructionWidth, 1), 8);
+	for (int i = 0; i < instructionWidth; i++)
+		oc[i] = static_cast<uint8_t>(static_cast<uint64_t>(m.value) >> (8 * i));
+
+	emitBytes(oc, instructionWidth);
+
+	for (int i = 0; i < m.numValues; i++)
+		emitOperand(m.values[i], getOperandBytes(m, i), line);
+
+	pi.size = static_cast<uint8_t>(_address - address);
+	pi.targetBytes = static_cast<uint8_t>(m.numValues > 0 ? getOperandBytes(m, 0) : 0);
+	_code.push_back(pi);
+
+	LOG(LogLevel::ParsedMinor) << "          *** $" << hex4 << address << " : opcode $" << hex2 << m.value << " (line " << dec << line << ")\n";
+}
+
+void assembler::emitOperand(std::string_view text, int bytes, int line)
+{
+	uint64_t value = 0;
+	bool known = true;
+
+	if (text.size() == 3 && (text.front() == '\'' || text.front() == '"') && text.back() == text.front())
+	{
+		value = static_cast<unsigned char>(text[1]);
+	}
+	else if (parser::instance().parse_literal(text, value) != LiteralStatus::Ok)
 	{
-	/*	if (_symbols.count(token.value()) > 0)
+		std::string_view name = text;
+		parser::instance().try_strip_address(name);
+
+		if (!parser::instance().is_command(name))
 		{
 			std::stringstream msg;
-			msg << "Found a symbol at line <" << linenum << ">! Symbol [" << token.value() << "] already exists!";
-			throw std::exception(msg.str().c_str());
+			msg << "Assembling instruction at line <" << line << ">! Bad value [" << text << "]!";
+			throw std::runtime_error(msg.str());
 		}
-		else*/
+
+		const int id = _symbols.nameId(name);
+		const symbol* s = _symbols.find(id);
+		if (s != nullptr)
 		{
-			if (_archtags.count(token.value()) > 0)
-			{
-				_archtags[token.value()]->process(*this, token.value(), line, linenum);
-			}
+			value = static_cast<uint32_t>(s->getAddress());
+		}
+		else
+		{
+			// not defined yet -- leave zeros, and patch them in resolveFixups
+			fixup f;
+			f.address = static_cast<uint32_t>(_address);
+			f.symbol = id;
+			f.where = _location;
+			f.bytes = static_cast<uint8_t>(bytes);
+			_fixups.push_back(f);
+
+			known = false;
+		}
+	}
+
+	if (known && bytes < 8 && value >> (8 * bytes) != 0)
+	{
+		std::stringstream msg;
+		msg << "Assembling instruction at line <" << line << ">! Value [" << text << "] does not fit in " << bytes << " byte(s)!";
+		throw std::runtime_error(msg.str());
+	}
+
+	uint8_t field[8] = {};
+	for (int b = 0; b < bytes && b < 8; b++)
+		field[b] = static_cast<uint8_t>(value >> (8 * b));
+
+	emitBytes(field, bytes);
+}
+
+void assembler::resolveFixups()
+{
+	for (const fixup& f : _fixups)
+	{
+		const symbol* s = _symbols.find(f.symbol);
+		const uint64_t value = s != nullptr ? static_cast<uint32_t>(s->getAddress()) : 0;
+
+		if (s == nullptr || (f.bytes < 8 && value >> (8 * f.bytes) != 0))
+		{
+			std::stringstream msg;
+			msg << (s == nullptr ? "Unknown symbol [" : "Value of [") << _symbols.name(f.symbol) << "] at line <" << f.where.line()
+				<< "> of " << getFileName(f.where) << (s == nullptr ? "!" : " does not fit its field!");
+			throw std::runtime_error(msg.str());
 		}
+
+		uint8_t field[8] = {};
+		for (int b = 0; b < f.bytes; b++)
+			field[b] = static_cast<uint8_t>(value >> (8 * b));
+
+		_programRom.patch(f.address, field, f.bytes);
 	}
-	else if (parser::instance().is_directive(token.value()))
+}
+
+void assembler::addCycleBudget(std::string_view label, int64_t max)
+{
+	cycleBudget b;
+	b.symbol = _symbols.nameId(label);
+	b.max = max;
+	b.where = _location;
+	_budgets.push_back(b);
+}
+
+void assembler::analyzeCycles()
+{
+	auto start = std::chrono::steady_clock::now();
+
+	cycleAnalyzer analyzer(arch());
+	analyzer.analyze(_code, _programRom, _symbols);
+
+	if (_cycleAnalysis)
 	{
-		// strip off the directive symbol
-		token.value().erase(token.value().begin(), token.value().begin() + 1);
+		analyzer.listing([this](const sourceLocation& l)
+		{
+			std::stringstream where;
+			where << "line " << l.line() << " of " << getFileName(l);
+			return where.str();
+		});
+	}
+
+	for (const cycleBudget& b : _budgets)
+	{
+		const symbol* s = _symbols.find(b.symbol);
+		if (s == nullptr || s->getType() != SymbolType::Label)
+		{
+			std::stringstream msg;
+			msg << "Assembling directive ." << ASSERT_CYCLES_STR << " at line <" << b.where.line() << "> of " << getFileName(b.where)
+				<< "! [" << _symbols.name(b.symbol) << "] is not a label!";
+			throw std::runtime_error(msg.str());
+		}
+
+		int64_t worst = 0;
+		uint32_t loopAt = 0;
+		if (!analyzer.worstCase(static_cast<uint32_t>(s->getAddress()), worst, loopAt))
+		{
+			std::stringstream msg;
+			msg << "Routine [" << _symbols.name(b.symbol) << "] has no worst case (it loops or jumps away at $" << hex4 << loopAt << dec
+				<< "), so its budget of " << b.max << " cycles at line <" << b.where.line() << "> of " << getFileName(b.where) << " cannot be checked!";
+			throw std::runtime_error(msg.str());
+		}
 
-		// only handle registered directives
-		if (_directives.count(token.value()) == 0)
+		if (worst > b.max)
 		{
 			std::stringstream msg;
-			msg << "Unknown directive at line <" << _lineNumber << ">! Found [."
-				<< token.value() << "]";
-			throw std::exception(msg.str().c_str());
+			msg << "Routine [" << _symbols.name(b.symbol) << "] takes up to " << worst << " cycles, over its budget of " << b.max
+				<< " at line <" << b.where.line() << "> of " << getFileName(b.where) << "!";
+			throw std::runtime_error(msg.str());
 		}
-		_directives[token.value()]->process(*this, token.value(), std::move(line), _lineNumber);
+
+		LOG(LogLevel::MinorTasks) << "          *** Routine " << _symbols.name(b.symbol) << " : up to " << worst << " of " << b.max << " cycles\n";
 	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	LOG(LogLevel::MajorTasks) << "Cycle analysis : " << analyzer.blockCount() << " block(s), " << _budgets.size() << " budget(s) met in "
+		<< elapsed.count() << " ms\n";
 }
 
 void assembler::setEcho(unsigned char e)
 {
-	_echo_architecture = (e & 0x80) == 0x80; // $1000 0000
-	_echo_major_tasks = (e & 0x40) == 0x40;  // $0100 0000
-	_echo_minor_tasks = (e & 0x20) == 0x20;  // $0010 0000
-	_echo_warnings = (e & 0x10) == 0x10;     // $0001 0000
-	_echo_parsed_major = (e & 0x08) == 0x08; // $0000 1000
-	_echo_parsed_minor = (e & 0x04) == 0x04; // $0000 0100
-	_echo_source = (e & 0x02) == 0x02;       // $0000 0010
-	_echo_rom_data = (e & 0x01) == 0x01;     // $0000 0001
+	//  -> bit 7 : architecture file definitions  -> bit 3 : major parsing information
+	//  -> bit 6 : major tasks                    -> bit 2 : minor parsing information
+	//  -> bit 5 : minor tasks                    -> bit 1 : source code
+	//  -> bit 4 : warnings                       -> bit 0 : rom contents
+	logger::setLevels(e);
 }
 
-SymbolType assembler::getSymbolType(const std::string& n)
+// registers, flags and control lines belong to the architecture, everything else to the program
+static bool isArchSymbol(SymbolType t)
 {
-	std::map<std::string, symbol>::iterator i = _symbols.find(n);
+	return t == SymbolType::Register || t == SymbolType::Flag || t == SymbolType::ControlLine;
+}
 
-	if (i != _symbols.end())
-		return (i->second).getType();
+SymbolType assembler::getSymbolType(std::string_view n) const
+{
+	const symbol* s = findSymbol(n);
+	return s != nullptr ? s->getType() : SymbolType::None;
+}
 
-	return SymbolType::None;
+const symbol* assembler::findSymbol(std::string_view n) const
+{
+	const symbol* s = arch().symbols.find(n);
+	return s != nullptr ? s : _symbols.find(n);
 }
 
-int assembler::getSymbolAddress(const std::string& n) const
+const std::pmr::vector<int>& assembler::getSymbolAddresses(SymbolType t) const
 {
-	auto i = _symbols.find(n);
-	return (i->second).getAddress();
+	return isArchSymbol(t) ? arch().symbols.addresses(t) : _symbols.addresses(t);
 }
 
-const std::vector<int>& assembler::getSymbolAddresses(SymbolType t)
+int assembler::getSymbolAddress(std::string_view n) const
 {
-	switch (t)
+	const symbol* s = findSymbol(n);
+	if (s == nullptr)
 	{
-	case SymbolType::Constant:
-		return _constantAddresses;
-
-	case SymbolType::Variable:
-		return _variableAddresses;
-
-	case SymbolType::Label:
-		return _labelAddresses;
+		std::stringstream msg;
+		msg << "Unknown symbol [" << n << "]!";
+		throw std::runtime_error(msg.str());
+	}
 
-	case SymbolType::Register:
-		return _registerAddresses;
+	return s->getAddress();
+}
 
-	case SymbolType::Flag:
-		return _flagAddresses;
+int assembler::evaluateControl(std::string_view expression, std::string_view d, int line)
+{
+	int value = 0;
+	std::string_view culprit;
 
-	case SymbolType::ControlLine:
-		return _controlLineAddresses;
+	ExprStatus status = building().expressions.evaluate(expression, value, culprit);
+	if (status != ExprStatus::Ok)
+	{
+		std::stringstream msg;
+		msg << "Assembling command " << d << " at line <" << line << ">! " << controlExpressions::status_str(status) << " [" << culprit << "]!";
+		throw std::runtime_error(msg.str());
 	}
+
+	return value;
 }
 
-void assembler::addConstant(const std::string& n, int a, int l)
+void assembler::addConstant(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeConstant(n, a, l));
-	_constantAddresses.push_back(a);
+	_symbols.add(n, SymbolType::Constant, a, l);
 }
 
-void assembler::addVariable(const std::string& n, int a, int l)
+void assembler::addVariable(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeVariable(n, a, l));
-	_variableAddresses.push_back(a);
+	_symbols.add(n, SymbolType::Variable, a, l);
 }
 
-void assembler::addLabel(const std::string& n, int a, int l)
+void assembler::addLabel(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeLabel(n, a, l));
-	_labelAddresses.push_back(a);
+	_symbols.add(n, SymbolType::Label, a, l);
 }
 
-void assembler::addRegister(const std::string& n, int a, int l)
+void assembler::addRegister(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeRegister(n, a, l));
-	_registerAddresses.push_back(a);
+	building().symbols.add(n, SymbolType::Register, a, l);
+
+	if (_archRecording) _archRecording->registers.push_back(std::string(n));
 }
 
-void assembler::addFlag(const std::string& n, int a, int l)
+void assembler::addFlag(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeFlag(n, a, l));
-	_nFlags++;
+	architecture& arch = building();
+	arch.symbols.add(n, SymbolType::Flag, a, l);
+	arch.nFlags++;
 
-	_flagAddresses.push_back(a);
+	if (_archRecording) _archRecording->flags.push_back(std::string(n));
 }
 
-void assembler::addControlLine(const std::string& n, int a, int l)
+void assembler::addControlLine(std::string_view n, int a, int l)
 {
-	_symbols.emplace(n, symbol::makeControlLine(n, a, l));
+	architecture& arch = building();
+	arch.symbols.add(n, SymbolType::ControlLine, a, l);
 
-	_controlLineAddresses.push_back(a);
+	if (a > arch.maxControlLineValue) arch.maxControlLineValue = a;
 
-	if (a > _maxControlLineValue) _maxControlLineValue = a;
+	if (_archRecording) _archRecording->controlLines.push_back(std::string(n));
 }
 
 void assembler::addOpcode(int v, const opcode& oc)
 {
-	_lastOpcodeIndex = v;
-	_opcodes.emplace(v, oc);
+	architecture& arch = building();
+	if (v >= opcodeLimit())
+		arch.opcodes.resize(v + 1);
+
+	arch.opcodes[v] = oc;
+	arch.microcode.beginOpcode(v);
 
-	if (v > _maxOpcodeValue) _maxOpcodeValue = v;
+	if (v > arch.maxOpcodeValue) arch.maxOpcodeValue = v;
 
-	_mnemonics.push_back(_opcodes[v].mnemonic());
-	//registerInstruction<archOpcode>(_opcodes[v].getUniqueString());
+	if (_archRecording) _archRecording->opcodes.push_back(v);
 }
 
 void assembler::addOpcodeAlias(int v, const opcode& oca)
 {
-	_opcode_aliases.emplace(v, oca);
+	architecture& arch = building();
+	if (v >= opcodeAliasLimit())
+		arch.opcodeAliases.resize(v + 1);
 
-	_mnemonics.push_back(_opcode_aliases[v].mnemonic());
-	//registerInstruction<archOpcode>(_opcode_aliases[v].getUniqueString());
+	arch.opcodeAliases[v] = oca;
+
+	if (_archRecording) _archRecording->opcodeAliases.push_back(v);
 }
 
-void assembler::addNewControlPatternToCurrentOpcode(controlPattern cp)
+void assembler::addCycle(const microBranch& b)
 {
-	_opcodes[_lastOpcodeIndex].addNewControlPattern(cp);
-	if (_opcodes[_lastOpcodeIndex].numCycles() > _maxNumCycles) _maxNumCycles = _opcodes[_lastOpcodeIndex].numCycles();
+	building().microcode.addCycle(b);
 }
 
-void assembler::addToLastControlPatternInCurrentOpcode(controlPattern cp)
+void assembler::addBranch(const microBranch& b)
 {
-	_opcodes[_lastOpcodeIndex].addToLastControlPattern(cp);
+	building().microcode.addBranch(b);
 }
 
-bool assembler::isAMnemonic(const std::string& s)
+opcode& assembler::getOpcode(int v)
 {
-	return std::find(_mnemonics.begin(), _mnemonics.end(), s) != _mnemonics.end();
+	architecture& arch = building();
+	if (v >= opcodeLimit())
+		arch.opcodes.resize(v + 1);
+
+	return arch.opcodes[v];
 }
 
-opcode& assembler::getOpcode(int v)
+opcode& assembler::getOpcodeAlias(int v)
+{
+	architecture& arch = building();
+	if (v >= opcodeAliasLimit())
+		arch.opcodeAliases.resize(v + 1);
+
+	return arch.opcodeAliases[v];
+}
+
+void assembler::addDecoderRom(bool write, int inputs, int outputs)
 {
-	return _opcodes[v];
+	architecture& arch = building();
+	arch.writeDecoderRom = write;
+	arch.decoderInputs = inputs;
+	arch.decoderOutputs = outputs;
+
+	if (_archRecording) _archRecording->decoderRom = true;
 }
 
-int assembler::getValueByUniqueOpcodeString(const std::string& m)
+void assembler::addProgramRom(bool write, int inputs, int outputs)
 {
-	for (auto it = _opcodes.begin(); it != _opcodes.end(); ++it)
-		if (it->second.getUniqueString() == m)
-			return it->first;
+	architecture& arch = building();
+	arch.writeProgramRom = write;
+	arch.programInputs = inputs;
+	arch.programOutputs = outputs;
+
+	setupProgramRom();
+
+	if (_archRecording) _archRecording->programRom = true;
 }
 
-int assembler::getValueByUniqueOpcodeAliasString(const std::string& m)
+void assembler::setupProgramRom()
 {
-	for (auto it = _opcode_aliases.begin(); it != _opcode_aliases.end(); ++it)
-		if (it->second.getUniqueString() == m)
-			return it->first;
+	const int inputs = arch().programInputs;
+	const int outputs = arch().programOutputs;
+
+	// 2^inputs words of outputs bits, kept as bytes
+	const uint64_t size = inputs >= 0 && inputs <= 31 ? (uint64_t(1) << inputs) * ((outputs + 7) / 8) : 0;
+	if (inputs < 0 || inputs > 31 || outputs <= 0 || size > UINT32_MAX)
+	{
+		std::stringstream msg;
+		msg << "Program rom with " << inputs << " inputs and " << outputs << " outputs is not supported!";
+		throw std::runtime_error(msg.str());
+	}
+
+	_programRom.reset(static_cast<uint32_t>(size));
+
+	programSegment whole;
+	whole.name = DEFAULT_SEGMENT_STR;
+	whole.limit = static_cast<uint32_t>(size);
+
+	_segments.clear();
+	_segments.push_back(whole);
+	_activeSegmentIndex = 0;
 }
 
-int assembler::numOpcodeCycles()
+int assembler::addSegment(std::string_view name, uint32_t origin, uint32_t size)
 {
-	return _opcodes[_lastOpcodeIndex].numArgs();
+	programSegment s;
+	s.name = std::string(name);
+	s.origin = origin;
+	s.cursor = origin;
+
+	// without a size, the segment runs up to the next one (or the end of the rom)
+	s.limit = _programRom.size();
+	for (size_t i = 1; i < _segments.size(); i++)
+	{
+		if (_segments[i].origin > origin && _segments[i].origin < s.limit)
+			s.limit = _segments[i].origin;
+	}
+
+	if (size > 0)
+		s.limit = origin + size;
+
+	if (_segments.empty() || origin >= _programRom.size() || s.limit > _programRom.size() || s.limit < origin)
+	{
+		std::stringstream msg;
+		msg << "Segment [" << name << "] does not fit the program rom!";
+		throw std::runtime_error(msg.str());
+	}
+
+	// the first segment is the whole rom, every other one has its own range
+	for (size_t i = 1; i < _segments.size(); i++)
+	{
+		if (_segments[i].overlaps(s))
+		{
+			std::stringstream msg;
+			msg << "Segment [" << name << "] overlaps segment [" << _segments[i].name << "]!";
+			throw std::runtime_error(msg.str());
+		}
+	}
+
+	_segments.push_back(s);
+	return static_cast<int>(_segments.size()) - 1;
 }
 
-int assembler::lastOpcodeIndex()
+int assembler::findSegment(std::string_view name) const
 {
-	return _lastOpcodeIndex;
+	for (size_t i = 0; i < _segments.size(); i++)
+	{
+		if (_segments[i].name == name)
+			return static_cast<int>(i);
+	}
+
+	return -1;
 }
 
-void assembler::addDecoderRom(bool write, int inputs, int outputs)
+void assembler::setActiveSegment(int i)
 {
-	_write_decode_rom = write;
-	_in_bits_decode = inputs;
-	_out_bits_decode = outputs;
+	_segments[_activeSegmentIndex].cursor = static_cast<uint32_t>(_address);
+	_activeSegmentIndex = i;
+	_address = static_cast<int>(_segments[i].cursor);
 }
 
-void assembler::addProgramRom(bool write, int inputs, int outputs)
+void assembler::emitBytes(const uint8_t* data, size_t n)
 {
-	int size = outputs * pow(2, inputs);
+	if (_segments.empty())
+		throw std::runtime_error("No program rom to emit code into!");
 
-	_write_program_rom = write;
-	_in_bits_program = inputs;
-	_out_bits_program = outputs;
+	const programSegment& segment = _segments[_activeSegmentIndex];
+	const uint32_t address = static_cast<uint32_t>(_address);
+
+	uint32_t at = address;
+	programImage::WriteStatus status = programImage::WriteStatus::OutOfRange;
+	if (_address >= 0 && segment.contains(address, n))
+		status = _programRom.write(address, data, n, at);
+
+	if (status != programImage::WriteStatus::Ok)
+	{
+		std::stringstream msg;
+		if (status == programImage::WriteStatus::Overlap)
+			msg << "Code at $" << hex4 << at << " overlaps code already emitted there!";
+		else
+			msg << "Code at $" << hex4 << address << " does not fit segment [" << segment.name << "]!";
+
+		throw std::runtime_error(msg.str());
+	}
+
+	_last_address = _address + static_cast<int>(n) - 1;
+	setAddress(_address + static_cast<int>(n));
 }
 
 void assembler::addByteToProgramRom(int8_t byte, int address)
 {
-	// fill in later!
+	const uint8_t b = static_cast<uint8_t>(byte);
+
+	if (address == -1)
+	{
+		emitBytes(&b, 1);
+		return;
+	}
+
+	uint32_t at = 0;
+	if (address < 0 || _programRom.write(static_cast<uint32_t>(address), &b, 1, at) != programImage::WriteStatus::Ok)
+	{
+		std::stringstream msg;
+		msg << "Unable to write program rom byte at $" << hex4 << address << "!";
+		throw std::runtime_error(msg.str());
+	}
 }
\ No newline at end of file
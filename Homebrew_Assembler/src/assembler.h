@@ -1,49 +1,107 @@
 #pragma once
 
+#include "architecture.h"
 #include "command.h"
 #include "opcode.h"
-#include "symbol.h"
+#include "symboltable.h"
+#include "include.h"
+#include "lexer.h"
+#include "archimage.h"
+#include "matcher.h"
+#include "expression.h"
+#include "decoder.h"
+#include "microcode.h"
+#include "programrom.h"
+#include "romwriter.h"
+#include "fixup.h"
+#include "peephole.h"
+#include "timing.h"
+#include "logger.h"
 
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
-#include <assert.h>
+#include <memory_resource>
+#include <memory>
 #include <optional>
 
+// One open file in the include chain. Each file is mapped and lexed once, so returning to a
+// parent only restores its file id and the index of its next line in the parent's token stream.
 class fileStackEntry
 {
 public:
-	std::string filename;
 	int parentIndex = -1;
-	int startLine = 0;
+	int file = -1;
+	int line = 0;
 };
 
+enum class IncludeResult { Pushed, Skipped, Precompiled };
+
 class assembler
 {
 public:
-	// Constructors
-	assembler(std::string filename);
+	// Constructors -- given a finished architecture, the assembler uses it as it is (and skips its
+	// files when they are included) instead of reading one of its own
+	assembler(std::string filename, std::shared_ptr<const architecture> shared = nullptr);
 
-	// Echo stuff
+	// Echo stuff -- the mask sets the levels shown by the logger (see logger.h)
 	void setEcho(unsigned char e);
-	bool echoArchitecture() { return _echo_architecture; }
-	bool echoMajorTasks() { return _echo_major_tasks; }
-	bool echoMinorTasks() { return _echo_minor_tasks; }
-	bool echoWarnings() { return _echo_warnings; }
-	bool echoSource() { return _echo_source; }
-	bool echoParsedMajor() { return _echo_parsed_major; }
-	bool echoParsedMinor() { return _echo_parsed_minor; }
-	bool echoRomData() { return _echo_rom_data; }
 
 	// start assembly
 	void assemble();
 
+	// Incremental reassembly after the given files changed on disk (watch mode). Only those
+	// files are lexed again, and the architecture is only rebuilt when one of them changed
+	// its architecture or include lines -- otherwise only the program is assembled again.
+	// Returns true if the architecture was rebuilt.
+	bool reassemble(const std::vector<int>& changedFiles);
+	const includeCache& getIncludes() const { return _includes; }
+
+	// allocator for objects that live as long as the current assembly
+	sessionAllocator allocator() { return sessionAllocator(&_arena); }
+
+	// allocator for objects that belong to the architecture (opcodes)
+	sessionAllocator archAllocator() { return sessionAllocator(&building().arena); }
+
+	// The architecture read (or shared) by the last assembly
+	std::shared_ptr<const architecture> getArchitecture() const { return _arch; }
+	bool sharesArchitecture() const { return _sharedArch; }
+
+	// precompiled architecture images (on by default)
+	void setArchImages(bool enable) { _useArchImages = enable; }
+
+	// peephole optimization of the program code (off by default, see peephole.h)
+	void setOptimize(bool enable) { _optimize = enable; }
+	bool getOptimize() const { return _optimize; }
+
+	// static cycle analysis of the program code (off by default, see timing.h) -- a program with
+	// .assert_cycles budgets is always analyzed
+	void setCycleAnalysis(bool enable) { _cycleAnalysis = enable; }
+	bool getCycleAnalysis() const { return _cycleAnalysis; }
+
+	// report of the repeated entries of the decoder rom (off by default, see redundancy.h)
+	void setDecoderReport(bool enable) { _decoderReport = enable; }
+	bool getDecoderReport() const { return _decoderReport; }
+
+	// repacking of the control lines into fewer decoder rom bits (off by default, see controlpack.h)
+	// -- with a file name, the packed control section is written there too
+	void setControlPacking(bool enable, const std::string& outputFile = std::string()) { _controlPacking = enable; _controlPackFile = outputFile; }
+	bool getControlPacking() const { return _controlPacking; }
+
+	// formats the roms are written in (RomFormat bits, raw binary by default)
+	void setRomFormats(unsigned formats) { _romFormats = formats; }
+	unsigned getRomFormats() const { return _romFormats; }
+
 	// source file handling
-	void pushFile(std::string filename);
+	void addIncludePath(const std::string& path) { _includes.addSearchPath(path); }
+	IncludeResult pushFile(std::string_view filename);
 	void processFile();
-	void processLine(std::string& line, int linenum, std::optional<std::string> token);
+	sourceLocation getLocation() const { return _location; }
+	const std::string& getFileName(const sourceLocation& l) const { return _includes.name(l.file()); }
+
+	// One program line: labels, directives and instructions
+	void processLine(const lexedLine& line, int linenum);
 
 	// addressing stuff
 	void setAddress(int a) { _address = a; 	if (_address > _max_address) _max_address = _address;
@@ -51,142 +109,204 @@ public:
 	int getAddress() const { return _address; }
 
 	// general stuff
-	void setInstructionWidth(int i) { _instructionWidth = i; }
-	void setAddressWidth(int a) { _addressWidth = a; }
-	int getInstructionWidth() { return _instructionWidth; }
-	int getAddressWidth() { return _addressWidth; }
+	void setInstructionWidth(int i) { building().instructionWidth = i; if (_archRecording) _archRecording->instructionWidth = true; }
+	void setAddressWidth(int a) { building().addressWidth = a; if (_archRecording) _archRecording->addressWidth = true; }
+	int getInstructionWidth() const { return arch().instructionWidth; }
+	int getAddressWidth() const { return arch().addressWidth; }
 
 	// Symbol stuff
-	SymbolType getSymbolType(const std::string& n);
-	int getSymbolAddress(const std::string& n) const;
-	void addLabel(const std::string& n, int a, int l);
-	void addConstant(const std::string& n, int a, int l);
-	void addVariable(const std::string& n, int a, int l);
-	void addFlag(const std::string& n, int a, int l);
-	void addRegister(const std::string& n, int a, int l);
-	void addControlLine(const std::string& n, int a, int l);
+	const symbol* findSymbol(std::string_view n) const;
+	SymbolType getSymbolType(std::string_view n) const;
+	int getSymbolAddress(std::string_view n) const;
+	void addLabel(std::string_view n, int a, int l);
+	void addConstant(std::string_view n, int a, int l);
+	void addVariable(std::string_view n, int a, int l);
+	void addFlag(std::string_view n, int a, int l);
+	void addRegister(std::string_view n, int a, int l);
+	void addControlLine(std::string_view n, int a, int l);
 	void addOpcode(int v, const opcode& oc);
 	void addOpcodeAlias(int v, const opcode& oca);
-	void addNewControlPatternToCurrentOpcode(controlPattern cp);
-	void addToLastControlPatternInCurrentOpcode(controlPattern cp);
+
+	// Microcode of the last opcode added -- a new cycle, or another branch of its last cycle
+	void addCycle(const microBranch& b);
+	void addBranch(const microBranch& b);
+	const microcodeStore& getMicrocode() const { return arch().microcode; }
+
+	// Control expressions (control lines, opcodes and seq lines) -- d and line are for errors
+	int evaluateControl(std::string_view expression, std::string_view d, int line);
 
 	// Flag stuff
-	int getFlagCount() { return _nFlags; }
-	const std::vector<int>& getSymbolAddresses(SymbolType t);
-	std::vector<int> lastAddedFlags;
+	int getFlagCount() const { return arch().nFlags; }
+	const std::pmr::vector<int>& getSymbolAddresses(SymbolType t) const;
 
 	// Opcode stuff
-	bool isAMnemonic(const std::string& s);
-	int getValueByUniqueOpcodeString(const std::string& s);
-	int getValueByUniqueOpcodeAliasString(const std::string& s);
-	int numOpcodeCycles();
-	int lastOpcodeIndex();
+	bool isAMnemonic(std::string_view s) const { return arch().matcher.isMnemonic(s); }
+	bool matchInstruction(std::string_view mnemonic, std::string_view operands, instructionMatch& m) const { return arch().matcher.match(mnemonic, operands, m); }
+	int lastOpcodeIndex() const { return arch().microcode.currentOpcode(); }
+	int opcodeLimit() const { return static_cast<int>(arch().opcodes.size()); }
+	int opcodeAliasLimit() const { return static_cast<int>(arch().opcodeAliases.size()); }
 	opcode& getOpcode(int v);
+	opcode& getOpcodeAlias(int v);
 
 	// Decoder Rom stuff
 	void addDecoderRom(bool write, int inputs, int outputs);
+	bool getWriteDecoderRom() const { return arch().writeDecoderRom; }
+	int getDecoderRomInputs() const { return arch().decoderInputs; }
+	int getDecoderRomOutputs() const { return arch().decoderOutputs; }
+	const decoderRom& getDecoderRom() const { return arch().decoder; }
 	void writeDecoderRom();
 
 	// ProgramRom stuff
-	void setActiveSegment(int i) { _activeSegmentIndex = i; }
 	void addProgramRom(bool write, int inputs, int outputs);
-	void addByteToProgramRom(int8_t byte, int address = -1);
+	bool getWriteProgramRom() const { return arch().writeProgramRom; }
+	int getProgramRomInputs() const { return arch().programInputs; }
+	int getProgramRomOutputs() const { return arch().programOutputs; }
+	const programImage& getProgramRom() const { return _programRom; }
 	void writeProgramRom();
 
-private:
-	// used to link parse tokens with specific functions defined in:
-	//  directiveDefine.h, archDefine.h, and instructionDefine.h
-	void registerOperations();
+	// Segments -- the first one is the whole rom. Switching segments saves the address in the
+	// segment being left and continues at the address saved in the new one.
+	int addSegment(std::string_view name, uint32_t origin, uint32_t size);
+	int findSegment(std::string_view name) const;
+	void setActiveSegment(int i);
+	const programSegment& getSegment(int i) const { return _segments[i]; }
+	int getActiveSegment() const { return _activeSegmentIndex; }
 
+	// Emits bytes at the current address of the active segment and moves past them, or (for
+	// addByteToProgramRom with an address) writes one byte there without moving
+	void emitBytes(const uint8_t* data, size_t n);
+	void addByteToProgramRom(int8_t byte, int address = -1);
+
+	// A matched instruction -- encoded right away, or queued in the peephole window
+	void addInstruction(const instructionMatch& m, std::string_view mnemonic, std::string_view operands, int line);
+
+	// Emits a value operand as a little-endian field of the given size. Numbers, characters and
+	// labels defined so far are encoded right away; a label that is not defined yet leaves zeros
+	// and a fixup, patched once the whole program has been read.
+	void emitOperand(std::string_view text, int bytes, int line);
+	int getOperandBytes(const instructionMatch& m, int i) const { return arch().operandBytesOf(m, i); }
+	const std::pmr::vector<fixup>& getFixups() const { return _fixups; }
+
+	// The instructions encoded so far, and the cycle budgets of routines (checked once the whole
+	// program has been read)
+	const std::pmr::vector<programInstruction>& getCode() const { return _code; }
+	void addCycleBudget(std::string_view label, int64_t max);
+
+private:
 	// Used for linking include files
 	void popFile();
 
+	// Clears everything parsed so far (but keeps loaded and lexed files, and a shared architecture)
+	void reset();
+
+	// Clears only the program (symbols, rom image, segments and fixups), keeping the architecture
+	void resetProgram();
+
+	// The architecture in use, and the one being read (throws if the architecture is shared)
+	const architecture& arch() const { return *_arch; }
+	architecture& building();
+
+	// Sizes the program rom image (and its default segment) from the architecture's layout
+	void setupProgramRom();
+
+	// Hash of the pass0 lines in a file -- if it does not change, neither does the
+	// architecture or include tree that the file contributes to
+	uint64_t archFingerprint(const lexedFile& file) const;
+
+	// Precompiled architecture support -- a file and everything it includes, and a hash of their text
+	std::vector<int> includeClosure(int id);
+	uint64_t contentHash(const std::vector<int>& files) const;
+	void finishArchRecording();
+
+	// Builds the instruction matcher and the decoder rom image once the architecture is complete
+	void buildMatcher();
+	void buildDecoderRom();
+
+	// The roms as the writer sees them
+	romImage decoderRomImage() const;
+	romImage programRomImage() const;
+
+	// Searches for a smaller control line layout, logs it and writes it out if asked to
+	void packControls() const;
+
+	// Dumps (RomData) and writes the program rom, and the decoder rom too if asked to
+	void writeRoms(bool decoder);
+
+	// pass0 reads the architecture and walks the include tree. pass1 then assembles the program
+	// in a single pass over the program lines of the files pass0 walked (in the same order, from
+	// their token streams), emitting code as it goes, and patches the fixups at the end.
 	void pass0();
 	void pass1();
+	void pass1File(int id, std::vector<char>& visited);
+	void resolveFixups();
 
-	template <class d>
-	void registerDirective(std::string name)
-	{
-		assert(_directives.count(name) == 0);
-		_directives.emplace(name, std::make_unique<d>());
-	}
+	// Times the program code, logs it, and checks the cycle budgets
+	void analyzeCycles();
 
-	template <class a>
-	void registerArchTag(std::string name)
-	{
-		assert(_archtags.count(name) == 0);
-		_archtags.emplace(name, std::make_unique<a>());
-	}
+	// Emits the opcode and the values of an instruction
+	void encodeInstruction(const instructionMatch& m, int line);
 
-	template <class i>
-	void registerInstruction(std::string name)
-	{
-		assert(_instructions.count(name) == 0);
-		_instructions.emplace(name, std::make_unique<i>());
-	}
+	// Optimizes and encodes the instructions queued so far -- called wherever a straight-line run
+	// of code ends (labels, directives, includes and the end of a file)
+	void flushWindow();
 
 private:
+	// Everything parsed for the program during one assembly (its symbols and rom image) is
+	// allocated from this arena and freed all at once by reset(). The architecture has its own.
+	std::pmr::monotonic_buffer_resource _arena{ ARENA_BLOCK_SIZE };
+
+	// architecture stuff -- _building is the same object while this assembler reads it
+	std::shared_ptr<const architecture> _arch;
+	architecture* _building = nullptr;
+	bool _sharedArch = false;
+
 	// file stuff
-	std::ifstream _file;
+	includeCache _includes;
+	lexer _lexer{ _includes };
 	std::string _startFile;
 	std::vector<fileStackEntry> _fileStack;
 	int _fileStackIndex = -1;
-	int _lastFileStackIndex = -1;
-	int _lineNumber = 0;
+	sourceLocation _location;
+	int _rootFile = -1;
+	std::vector<char> _walked;	// by file id -- files pass0 walked (not precompiled or shared)
 
-	// general stuff
-	int _instructionWidth = 0;
-	int _addressWidth = 0;
-
-	// echo stuff
-	bool _echo_architecture = false;
-	bool _echo_major_tasks = false;
-	bool _echo_minor_tasks = false;
-	bool _echo_warnings = false;
-	bool _echo_source = false;
-	bool _echo_parsed_major = false;
-	bool _echo_parsed_minor = false;
-	bool _echo_rom_data = false;
+	// precompiled architecture stuff
+	bool _useArchImages = true;
+	std::unique_ptr<archImageBuilder> _archRecording;
+	int _archRecordingIndex = -1;
+	uint64_t _archRecordingHash = 0;
 
-	// Flag stuff
-	int _nFlags = 0;
+	// incremental reassembly stuff
+	std::vector<uint64_t> _archFingerprints;
+	bool _needsFullRebuild = true;
 
-	// Symbol stuff
-	std::map<std::string, symbol> _symbols;
-	std::vector<int> _constantAddresses;
-	std::vector<int> _variableAddresses;
-	std::vector<int> _labelAddresses;
-	std::vector<int> _registerAddresses;
-	std::vector<int> _flagAddresses;
-	std::vector<int> _controlLineAddresses;
-
-	// Opcode stuff
-	std::map<int, opcode> _opcodes;
-	std::map<int, opcode> _opcode_aliases;
-	std::vector<std::string> _mnemonics;
-	int _lastOpcodeIndex = -1;
+	// Symbol stuff -- labels, constants and variables (the architecture keeps its own symbols)
+	symbolTable _symbols{ &_arena };
 
-	// Token identifier stuff
-	std::map<std::string, std::unique_ptr<command>>  _directives;
-	std::map<std::string, std::unique_ptr<command>>	 _archtags;
-	std::map<std::string, std::unique_ptr<command>> _instructions;
 
 	// addressing stuff
 	int _address = 0;
 	int _last_address = -1;
 	int _max_address = 0;
 
-	// decode rom stuff
-	bool _write_decode_rom = false;
-	int _maxControlLineValue = -1;
-	int _maxOpcodeValue = -1;
-	int _maxNumCycles = -1;
-	int _in_bits_decode;
-	int _out_bits_decode;
+	unsigned _romFormats = RawFormat;
+	bool _decoderReport = false;
+	bool _controlPacking = false;
+	std::string _controlPackFile;
+
+	// peephole stuff
+	bool _optimize = false;
+	std::unique_ptr<peepholeOptimizer> _peephole;
+	std::vector<windowInstruction> _window;
 
 	// program rom stuff
-	int _activeSegmentIndex;
-	bool _write_program_rom = false;
-	int _in_bits_program;
-	int _out_bits_program;
+	programImage _programRom{ &_arena };
+	std::vector<programSegment> _segments;
+	int _activeSegmentIndex = 0;
+	std::pmr::vector<fixup> _fixups{ &_arena };
+
+	// cycle analysis stuff
+	bool _cycleAnalysis = false;
+	std::pmr::vector<programInstruction> _code{ &_arena };
+	std::pmr::vector<cycleBudget> _budgets{ &_arena };
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "batch.h"
+#include "assembler.h"
+#include "threadpool.h"
+
+#include <chrono>
+#include <future>
+#include <iomanip>
+
+std::vector<batchResult> batchAssembler::run(const std::vector<std::string>& programs)
+{
+	using clock = std::chrono::steady_clock;
+	const clock::time_point start = clock::now();
+
+	// the architecture, read once
+	{
+		assembler reader(_archFile);
+		for (const std::string& path : _includePaths)
+			reader.addIncludePath(path);
+
+		reader.setArchImages(_archImages);
+		reader.setRomFormats(_romFormats);
+		reader.assemble();
+
+		_arch = reader.getArchitecture();
+	}
+
+	_archMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+	// then every program on its own assembler, sharing it
+	std::vector<batchResult> results(programs.size());
+	std::vector<std::future<void>> pending;
+
+	for (size_t i = 0; i < programs.size(); i++)
+	{
+		pending.push_back(threadPool::instance().submit([this, &programs, &results, i]()
+		{
+			batchResult& r = results[i];
+			r.file = programs[i];
+
+			const clock::time_point begin = clock::now();
+			try
+			{
+				assembler program(programs[i], _arch);
+				for (const std::string& path : _includePaths)
+					program.addIncludePath(path);
+
+				program.setRomFormats(_romFormats);
+				program.setOptimize(_optimize);
+				program.assemble();
+
+				program.getProgramRom().forEachRun([&r](uint32_t, const uint8_t*, size_t n) { r.bytes += n; });
+				r.ok = true;
+			}
+			catch (const std::exception& e)
+			{
+				r.error = e.what();
+			}
+
+			r.ms = std::chrono::duration<double, std::milli>(clock::now() - begin).count();
+		}));
+	}
+
+	for (std::future<void>& f : pending)
+	{
+		threadPool::instance().wait(f);
+		f.get();
+	}
+
+	_totalMs = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+	return results;
+}
+
+void batchAssembler::summary(const std::vector<batchResult>& results) const
+{
+	int failed = 0;
+	double busyMs = 0;
+
+	logLine out;
+	out << "\nBatch : " << _archFile << "\n";
+
+	for (const batchResult& r : results)
+	{
+		out << (r.ok ? "  ok     " : "  FAILED ") << std::fixed << std::setprecision(2) << std::setw(9) << r.ms << " ms  ";
+
+		if (r.ok)
+			out << std::setw(7) << r.bytes << " bytes  " << r.file << "\n";
+		else
+			out << r.file << " : " << r.error << "\n";
+
+		failed += r.ok ? 0 : 1;
+		busyMs += r.ms;
+	}
+
+	// how many programs were in flight on average while the programs ran
+	const double programMs = _totalMs - _archMs;
+
+	out << "\n" << results.size() << " program(s), " << failed << " failed, on " << threadPool::instance().size() << " threads\n";
+	out << "architecture " << _archMs << " ms, total " << _totalMs << " ms";
+
+	if (programMs > 0)
+		out << " (" << std::setprecision(1) << results.size() * 1000.0 / _totalMs << " programs/s, " << busyMs / programMs << "x parallel)";
+
+	out << "\n";
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "architecture.h"
+#include "romwriter.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// What happened to one program of a batch
+class batchResult
+{
+public:
+	std::string file;
+	bool ok = false;
+	std::string error;
+	double ms = 0;
+	size_t bytes = 0;   // program rom bytes emitted
+};
+
+// Assembles many programs against one architecture. The architecture file is read once, by an
+// assembler of its own, and the finished architecture is then shared read-only by one assembler
+// per program, all of them running on the thread pool at the same time. Every program still has
+// its own symbols, program rom and output files.
+class batchAssembler
+{
+public:
+	explicit batchAssembler(std::string archFile) : _archFile(std::move(archFile)) {}
+
+	void addIncludePath(const std::string& path) { _includePaths.push_back(path); }
+	void setArchImages(bool enable) { _archImages = enable; }
+	void setRomFormats(unsigned formats) { _romFormats = formats; }
+	void setOptimize(bool enable) { _optimize = enable; }
+
+	// Reads the architecture (errors there are fatal, and thrown), then assembles every program.
+	// Returns one result per program, in the order given.
+	std::vector<batchResult> run(const std::vector<std::string>& programs);
+
+	std::shared_ptr<const architecture> getArchitecture() const { return _arch; }
+	double getArchMs() const { return _archMs; }
+	double getTotalMs() const { return _totalMs; }
+
+	// Logs one line per program, the totals and the throughput
+	void summary(const std::vector<batchResult>& results) const;
+
+private:
+	std::string _archFile;
+	std::vector<std::string> _includePaths;
+	bool _archImages = true;
+	unsigned _romFormats = RawFormat;
+	bool _optimize = false;
+
+	std::shared_ptr<const architecture> _arch;
+	double _archMs = 0;
+	double _totalMs = 0;
+};
@@ -2,33 +2,39 @@
 
 #include "config.h"
 #include "util.h"
+#include "parser.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
 
 class command
 {
 public:
 	virtual ~command() {};
-	virtual void process(class assembler& a, const std::string& d, std::string remainder, int line) const {}
-	virtual void process(class assembler& a, std::string& line, int value0, int value1, int startAddress) const {}
-};
-
-class commandAlias : public command
-{
-public:
-	commandAlias(const command* c)
-		:
-		_command(c)
-	{}
+	virtual void process(class assembler& a, std::string_view d, std::string_view remainder, int line) const = 0;
 
-	virtual void process(class assembler& a, const std::string& d, std::string r, int l) const override
+protected:
+	// Parses a literal number argument of command d, reporting anything that is not one, or that
+	// does not fit in maxBits bits (so it can be narrowed to where it is stored)
+	static uint64_t literal(std::string_view token, std::string_view d, int line, int maxBits = 64)
 	{
-		_command->process(a, d, r, l);
-	}
+		uint64_t value = 0;
+		LiteralStatus status = parser::instance().parse_literal(token, value);
+		if (status != LiteralStatus::Ok)
+		{
+			std::stringstream msg;
+			msg << "Assembling command " << d << " at line <" << line << ">! " << parser::literal_status_str(status) << " [" << token << "]!";
+			throw std::runtime_error(msg.str());
+		}
 
-	virtual void process(class assembler& a, std::string& il, int iv0, int iv1, int sa) const override
-	{
-		_command->process(a, il, iv0, iv1, sa);
-	}
+		if (maxBits < 64 && (value >> maxBits) != 0)
+		{
+			std::stringstream msg;
+			msg << "Assembling command " << d << " at line <" << line << ">! Number does not fit in " << maxBits << " bits [" << token << "]!";
+			throw std::runtime_error(msg.str());
+		}
 
-private:
-	const command* const _command;
+		return value;
+	}
 };
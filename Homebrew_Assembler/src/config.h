@@ -7,6 +7,32 @@ constexpr const char HEX_KEY = '$';
 
 constexpr const char COMMENT_KEY = ';';
 
+// searched (after the including file's own directory) when resolving include directives
+constexpr const char* DEFAULT_INCLUDE_PATH = "code";
+
+// architecture files are saved as precompiled images (<name>.archc) next to the source
+constexpr const char* ARCH_FILE_EXT = ".arch";
+constexpr const char* ARCH_IMAGE_EXT = ".archc";
+
+// the roms are written next to the start file as <name><suffix>[_<chip>]<format ext>, one image
+// for every ROM_CHIP_BITS wide slice of their words
+constexpr const char* DECODER_ROM_SUFFIX = "_decoder";
+constexpr const char* PROGRAM_ROM_SUFFIX = "_program";
+constexpr const char* ROM_FILE_EXT = ".bin";
+constexpr const char* INTEL_HEX_FILE_EXT = ".hex";
+constexpr const char* LOGISIM_FILE_EXT = ".logisim";
+constexpr const char* VERILOG_FILE_EXT = ".mem";
+constexpr const int ROM_CHIP_BITS = 8;
+
+// moves tried by the control line packer (see controlpack.h)
+constexpr const int CONTROL_PACK_ITERATIONS = 200000;
+
+// size of the first block of the per-assembly arena (later blocks grow from there)
+constexpr const int ARENA_BLOCK_SIZE = 256 * 1024;
+
+// how often watch mode checks the source files for changes
+constexpr const int WATCH_INTERVAL_MS = 100;
+
 constexpr const char DIRECTIVE_KEY = '.';
 constexpr const char* LABEL_DECORATORS = "[]_";
 constexpr const char LABEL_END_KEY = ':';
@@ -18,8 +44,10 @@ constexpr const char* CONST_STR = "constant";
 constexpr const char* VAR_STR = "variable";
 
 constexpr const char* SEGMENT_STR = "segment";
+constexpr const char* DEFAULT_SEGMENT_STR = "code";
 constexpr const char* INCLUDE_STR = "include";
 constexpr const char* ORIGIN_STR = "org";
+constexpr const char* ASSERT_CYCLES_STR = "assert_cycles";
 constexpr const char* REGISTER_STR = "register";
 constexpr const char* FLAG_STR = "flag";
 constexpr const char* DEVICE_STR = "device";
@@ -28,10 +56,22 @@ constexpr const char* OPCODE_STR = "opcode";
 constexpr const char* OPCODE_ALIAS_STR = "opcode_alias";
 constexpr const char* OPCODE_SEQ_STR = "seq";
 constexpr const char* OPCODE_SEQ_IF_STR = "seq_if";
+constexpr const char* OPCODE_SEQ_ELIF_STR = "seq_elif";
 constexpr const char* OPCODE_SEQ_ELSE_STR = "seq_else";
 constexpr const char* END_ARCH_STR = "**endarch**";
 
-// also add multiple passes for symbol resolution (like look-ahead label addressing)
+// the register transfer / load mnemonic, the only one the peephole optimizer rewrites
+constexpr const char* MOVE_MNEMONIC = "mov";
+
+// the control flow the cycle analysis follows -- every other mnemonic starting with JUMP_PREFIX
+// is a conditional jump
+constexpr const char* CALL_MNEMONIC = "call";
+constexpr const char* RETURN_MNEMONIC = "ret";
+constexpr const char* JUMP_MNEMONIC = "jmp";
+constexpr const char JUMP_PREFIX = 'j';
+
+// the control line that ends the sequence of an instruction (named without its active-low _)
+constexpr const char* END_SEQ_LINE = "tcuEndSeq";
 
 constexpr const char* INSTRUCTION_WIDTH_STR = "instruction_width";
 constexpr const char* ADDRESS_WIDTH_STR = "address_width";
@@ -0,0 +1,562 @@
+#include "controlpack.h"
+#include "logger.h"
+#include "util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <random>
+#include <sstream>
+#include <unordered_set>
+
+static int popCount(uint32_t v)
+{
+	int n = 0;
+	for (; v != 0; v &= v - 1)
+		n++;
+
+	return n;
+}
+
+controlPacker::controlPacker(const architecture& arch)
+	:
+	_arch(arch)
+{
+	buildFields();
+	buildSignals();
+
+	// the fields as written are a packing already
+	_best.resize(_signals.size());
+	for (size_t s = 0; s < _signals.size(); s++)
+		_best[s] = _signals[s].field;
+
+	std::vector<int> counts(_fields.size(), 0);
+	for (int f : _best)
+		counts[f]++;
+
+	_bestWidth = widthOf(counts);
+}
+
+int controlPacker::bitsFor(int signals)
+{
+	// k codes and "none"
+	int bits = 0;
+	while ((1 << bits) - 1 < signals)
+		bits++;
+
+	return bits;
+}
+
+int controlPacker::widthOf(const std::vector<int>& counts) const
+{
+	int width = 0;
+	for (int k : counts)
+		width += bitsFor(k);
+
+	return width;
+}
+
+int controlPacker::fieldOf(uint32_t bits) const
+{
+	for (size_t f = 0; f < _fields.size(); f++)
+	{
+		if ((_fields[f].mask & bits) != 0)
+			return static_cast<int>(f);
+	}
+
+	return -1;
+}
+
+bool controlPacker::conflicts(int s, const uint64_t* members) const
+{
+	const uint64_t* row = &_conflicts[s * _stride];
+	for (size_t w = 0; w < _stride; w++)
+	{
+		if ((row[w] & members[w]) != 0)
+			return true;
+	}
+
+	return false;
+}
+
+void controlPacker::buildFields()
+{
+	const symbolTable& symbols = _arch.symbols;
+	_lineField.assign(symbols.count(), -1);
+
+	for (int i = 0; i < symbols.count(); i++)
+	{
+		const symbol& s = symbols.at(i);
+		const uint32_t value = static_cast<uint32_t>(s.getAddress());
+		if (s.getType() != SymbolType::ControlLine || value == 0)
+			continue;
+
+		std::vector<int> touched;
+		int wide = 0;
+		for (size_t f = 0; f < _fields.size(); f++)
+		{
+			if ((_fields[f].mask & value) != 0)
+			{
+				touched.push_back(static_cast<int>(f));
+				wide += _fields[f].lines >= 2 ? 1 : 0;
+			}
+		}
+
+		// joins fields that stand on their own -- a shorthand for several lines
+		if (wide >= 2)
+		{
+			_shorthands.push_back(i);
+			continue;
+		}
+
+		field merged;
+		merged.mask = value;
+		merged.lines = 1;
+		for (auto it = touched.rbegin(); it != touched.rend(); ++it)
+		{
+			merged.mask |= _fields[*it].mask;
+			merged.lines += _fields[*it].lines;
+			_fields.erase(_fields.begin() + *it);
+		}
+
+		_fields.push_back(merged);
+	}
+
+	// in bit order, like the lines are usually written
+	std::sort(_fields.begin(), _fields.end(), [](const field& x, const field& y) { return x.mask < y.mask; });
+
+	uint32_t used = 0;
+	for (const field& f : _fields)
+		used |= f.mask;
+
+	_originalWidth = popCount(used);
+
+	for (int i = 0; i < symbols.count(); i++)
+	{
+		const symbol& s = symbols.at(i);
+		if (s.getType() == SymbolType::ControlLine && s.getAddress() != 0 && std::find(_shorthands.begin(), _shorthands.end(), i) == _shorthands.end())
+			_lineField[i] = fieldOf(static_cast<uint32_t>(s.getAddress()));
+	}
+}
+
+void controlPacker::buildSignals()
+{
+	const microcodeStore& mc = _arch.microcode;
+	const uint32_t flagStates = uint32_t(1) << _arch.nFlags;
+
+	std::unordered_set<uint32_t> distinct;
+	for (int v = 0; v < mc.limit(); v++)
+	{
+		for (int c = 0; c < mc.numCycles(v); c++)
+		{
+			for (uint32_t f = 0; f < flagStates; f++)
+				distinct.insert(mc.word(mc.firstCycle(v) + c, f));
+		}
+	}
+
+	_words.assign(distinct.begin(), distinct.end());
+	std::sort(_words.begin(), _words.end());
+
+	// bits no line names are fields of their own
+	uint32_t named = 0;
+	for (const field& f : _fields)
+		named |= f.mask;
+
+	for (uint32_t word : _words)
+	{
+		for (uint32_t stray = word & ~named; stray != 0; stray &= stray - 1)
+		{
+			field f;
+			f.mask = stray & ~(stray - 1);
+			_fields.push_back(f);
+			named |= f.mask;
+			_originalWidth++;
+		}
+	}
+
+	std::map<std::pair<int, uint32_t>, int> index;
+	_wordSignals.resize(_words.size());
+
+	for (size_t w = 0; w < _words.size(); w++)
+	{
+		for (size_t f = 0; f < _fields.size(); f++)
+		{
+			const uint32_t value = _words[w] & _fields[f].mask;
+			if (value == 0)
+				continue;
+
+			auto it = index.find({ static_cast<int>(f), value });
+			if (it == index.end())
+			{
+				signal s;
+				s.field = static_cast<int>(f);
+				s.value = value;
+				it = index.emplace(std::make_pair(static_cast<int>(f), value), static_cast<int>(_signals.size())).first;
+				_signals.push_back(s);
+			}
+
+			_signals[it->second].uses++;
+			_wordSignals[w].push_back(it->second);
+		}
+
+		_maxActive = std::max(_maxActive, static_cast<int>(_wordSignals[w].size()));
+	}
+
+	// named by the first line with exactly that value
+	for (int i = _arch.symbols.count() - 1; i >= 0; i--)
+	{
+		if (_lineField[i] == -1)
+			continue;
+
+		auto it = index.find({ _lineField[i], static_cast<uint32_t>(_arch.symbols.at(i).getAddress()) });
+		if (it != index.end())
+			_signals[it->second].line = i;
+	}
+
+	_stride = (_signals.size() + 63) / 64;
+	_conflicts.assign(_signals.size() * _stride, 0);
+	for (const std::vector<int>& active : _wordSignals)
+	{
+		for (int a : active)
+		{
+			for (int b : active)
+			{
+				if (a != b)
+					_conflicts[a * _stride + b / 64] |= uint64_t(1) << (b % 64);
+			}
+		}
+	}
+}
+
+std::vector<int> controlPacker::greedy() const
+{
+	const int n = static_cast<int>(_signals.size());
+
+	// the most constrained signals first
+	std::vector<int> degree(n, 0);
+	for (int s = 0; s < n; s++)
+	{
+		for (size_t w = 0; w < _stride; w++)
+		{
+			for (uint64_t bits = _conflicts[s * _stride + w]; bits != 0; bits &= bits - 1)
+				degree[s]++;
+		}
+	}
+
+	std::vector<int> order(n);
+	for (int s = 0; s < n; s++)
+		order[s] = s;
+
+	std::stable_sort(order.begin(), order.end(), [&degree](int x, int y) { return degree[x] > degree[y]; });
+
+	std::vector<int> assigned(n, -1);
+	std::vector<int> counts;
+	std::vector<uint64_t> members;
+
+	for (int s : order)
+	{
+		// the field it widens least, then the fullest (it has the most room left after widening)
+		int best = -1;
+		int bestDelta = 1;
+		for (size_t g = 0; g < counts.size(); g++)
+		{
+			if (conflicts(s, &members[g * _stride]))
+				continue;
+
+			const int delta = bitsFor(counts[g] + 1) - bitsFor(counts[g]);
+			if (best == -1 || delta < bestDelta || (delta == bestDelta && counts[g] > counts[best]))
+			{
+				best = static_cast<int>(g);
+				bestDelta = delta;
+			}
+		}
+
+		if (best == -1)
+		{
+			best = static_cast<int>(counts.size());
+			counts.push_back(0);
+			members.resize(members.size() + _stride, 0);
+		}
+
+		assigned[s] = best;
+		counts[best]++;
+		members[best * _stride + s / 64] |= uint64_t(1) << (s % 64);
+	}
+
+	return assigned;
+}
+
+void controlPacker::optimize(int iterations, uint32_t seed)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	const int n = static_cast<int>(_signals.size());
+	if (n == 0)
+		return;
+
+	// every signal can end up in a field of its own
+	const int groups = n + static_cast<int>(_fields.size());
+	std::vector<int> counts(groups, 0);
+
+	std::vector<int> current = greedy();
+	for (int g : current)
+		counts[g]++;
+
+	if (widthOf(counts) >= _bestWidth)
+	{
+		current = _best;
+		std::fill(counts.begin(), counts.end(), 0);
+		for (int g : current)
+			counts[g]++;
+	}
+
+	std::vector<uint64_t> members(groups * _stride, 0);
+	for (int s = 0; s < n; s++)
+		members[current[s] * _stride + s / 64] |= uint64_t(1) << (s % 64);
+
+	int width = widthOf(counts);
+	if (width < _bestWidth)
+	{
+		_best = current;
+		_bestWidth = width;
+	}
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	const double hot = 2.0;
+	const double cold = 0.02;
+
+	for (int i = 0; i < iterations; i++)
+	{
+		const double temperature = hot * std::pow(cold / hot, static_cast<double>(i) / iterations);
+
+		const int s = static_cast<int>(rng() % n);
+		const int from = current[s];
+		const int leave = bitsFor(counts[from] - 1) - bitsFor(counts[from]);
+
+		// the cheapest field it fits in (an empty one costs a bit), ties picked at random
+		int to = -1;
+		int join = 0;
+		int ties = 0;
+		bool empty = counts[from] == 1;		// moving a lone signal to an empty field changes nothing
+		for (int g = 0; g < groups; g++)
+		{
+			if (g == from || (counts[g] == 0 && empty))
+				continue;
+
+			empty = empty || counts[g] == 0;
+
+			if (counts[g] > 0 && conflicts(s, &members[g * _stride]))
+				continue;
+
+			const int delta = bitsFor(counts[g] + 1) - bitsFor(counts[g]);
+			if (to == -1 || delta < join)
+			{
+				to = g;
+				join = delta;
+				ties = 1;
+			}
+			else if (delta == join && rng() % ++ties == 0)
+			{
+				to = g;
+			}
+		}
+
+		if (to == -1)
+			continue;
+
+		const int delta = leave + join;
+		if (delta > 0 && chance(rng) >= std::exp(-delta / temperature))
+			continue;
+
+		members[from * _stride + s / 64] &= ~(uint64_t(1) << (s % 64));
+		members[to * _stride + s / 64] |= uint64_t(1) << (s % 64);
+		counts[from]--;
+		counts[to]++;
+		current[s] = to;
+		width += delta;
+
+		if (width < _bestWidth)
+		{
+			_best = current;
+			_bestWidth = width;
+		}
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	_ms = elapsed.count();
+}
+
+void controlPacker::layout(std::vector<std::vector<int>>& fields, std::vector<int>& shifts) const
+{
+	std::map<int, std::vector<int>> byGroup;
+	for (size_t s = 0; s < _signals.size(); s++)
+		byGroup[_best[s]].push_back(static_cast<int>(s));
+
+	auto before = [this](int x, int y)
+	{
+		return _signals[x].field != _signals[y].field ? _signals[x].field < _signals[y].field : _signals[x].value < _signals[y].value;
+	};
+
+	fields.clear();
+	for (auto& g : byGroup)
+	{
+		std::sort(g.second.begin(), g.second.end(), before);
+		fields.push_back(g.second);
+	}
+
+	// in the order of the lines they start with
+	std::sort(fields.begin(), fields.end(), [&before](const std::vector<int>& x, const std::vector<int>& y) { return before(x.front(), y.front()); });
+
+	shifts.clear();
+	int shift = 0;
+	for (const std::vector<int>& f : fields)
+	{
+		shifts.push_back(shift);
+		shift += bitsFor(static_cast<int>(f.size()));
+	}
+}
+
+std::string controlPacker::nameOf(int s) const
+{
+	if (_signals[s].line != -1)
+		return std::string(_arch.symbols.name(_arch.symbols.at(_signals[s].line)));
+
+	std::stringstream name;
+	name << "$" << hex8 << _signals[s].value;
+	return name.str();
+}
+
+void controlPacker::summary() const
+{
+	if (!logEnabled(LogLevel::MajorTasks))
+		return;
+
+	std::vector<std::vector<int>> fields;
+	std::vector<int> shifts;
+	layout(fields, shifts);
+
+	logLine out;
+	out << "\nControl line packing : " << _signals.size() << " signal(s) in " << _words.size() << " distinct control word(s), "
+		<< _originalWidth << " bits as written, " << _bestWidth << " bits packed (" << std::fixed << std::setprecision(2) << _ms << " ms)\n";
+	out << "  no packing takes fewer than " << _maxActive << " bits (a word sets " << _maxActive << " signals at once), and a rom of one code per "
+		<< "word (decoded by a second rom) would take " << bitsFor(static_cast<int>(_words.size()) - 1) << "\n";
+
+	for (size_t f = 0; f < fields.size(); f++)
+	{
+		const int bits = bitsFor(static_cast<int>(fields[f].size()));
+		out << "  bits " << dec << shifts[f] << "-" << shifts[f] + bits - 1 << " :";
+		for (size_t c = 0; c < fields[f].size(); c++)
+			out << " " << c + 1 << "=" << nameOf(fields[f][c]);
+
+		out << "\n";
+	}
+
+	for (size_t s = 0; s < _signals.size(); s++)
+	{
+		if (_signals[s].line == -1)
+		{
+			out << "  WARNING: field value $" << hex8 << _signals[s].value << dec << " is set by " << _signals[s].uses
+				<< " word(s) but has no control line of its own (a seq line combines two lines of one field)\n";
+		}
+	}
+}
+
+std::string controlPacker::controlSection() const
+{
+	std::vector<std::vector<int>> fields;
+	std::vector<int> shifts;
+	layout(fields, shifts);
+
+	// the code and shift of every signal
+	std::vector<uint32_t> packed(_signals.size(), 0);
+	for (size_t f = 0; f < fields.size(); f++)
+	{
+		for (size_t c = 0; c < fields[f].size(); c++)
+			packed[fields[f][c]] = static_cast<uint32_t>(c + 1) << shifts[f];
+	}
+
+	auto signalOf = [this](int field, uint32_t value)
+	{
+		for (size_t s = 0; s < _signals.size(); s++)
+		{
+			if (_signals[s].field == field && _signals[s].value == value)
+				return static_cast<int>(s);
+		}
+
+		return -1;
+	};
+
+	const symbolTable& symbols = _arch.symbols;
+	std::stringstream out;
+	out << "; *** control lines, packed into " << _bestWidth << " bits (" << _originalWidth << " as written) ***\n";
+
+	for (size_t f = 0; f < fields.size(); f++)
+	{
+		const int bits = bitsFor(static_cast<int>(fields[f].size()));
+		out << "\n; bits " << shifts[f] << " - " << shifts[f] + bits - 1 << "\n";
+
+		for (size_t c = 0; c < fields[f].size(); c++)
+		{
+			const int s = fields[f][c];
+			bool written = false;
+			for (int i = 0; i < symbols.count(); i++)
+			{
+				if (_lineField[i] == _signals[s].field && static_cast<uint32_t>(symbols.at(i).getAddress()) == _signals[s].value)
+				{
+					out << "control " << symbols.name(symbols.at(i)) << "\t\t" << c + 1 << " << " << shifts[f] << "\n";
+					written = true;
+				}
+			}
+
+			if (!written)
+				out << "; " << c + 1 << " << " << shifts[f] << " is field value $" << hex8 << _signals[s].value << dec << ", which has no line of its own\n";
+		}
+	}
+
+	out << "\n; lines that set nothing\n";
+	for (int i = 0; i < symbols.count(); i++)
+	{
+		if (symbols.at(i).getType() == SymbolType::ControlLine && symbols.at(i).getAddress() == 0)
+			out << "control " << symbols.name(symbols.at(i)) << "\t\t0\n";
+	}
+
+	out << "\n; lines no opcode uses\n";
+	for (int i = 0; i < symbols.count(); i++)
+	{
+		if (_lineField[i] != -1 && signalOf(_lineField[i], static_cast<uint32_t>(symbols.at(i).getAddress())) == -1)
+			out << "; control " << symbols.name(symbols.at(i)) << "\n";
+	}
+
+	out << "\n; shorthands\n";
+	for (int i : _shorthands)
+	{
+		const uint32_t value = static_cast<uint32_t>(symbols.at(i).getAddress());
+		std::stringstream expression;
+		bool complete = true;
+
+		for (size_t f = 0; f < _fields.size(); f++)
+		{
+			const uint32_t part = value & _fields[f].mask;
+			if (part == 0)
+				continue;
+
+			const int s = signalOf(static_cast<int>(f), part);
+			if (s == -1 || _signals[s].line == -1)
+			{
+				complete = false;
+				break;
+			}
+
+			expression << (expression.tellp() > 0 ? " | " : "") << nameOf(s);
+		}
+
+		if (complete)
+			out << "control " << symbols.name(symbols.at(i)) << " = " << expression.str() << "\n";
+		else
+			out << "; control " << symbols.name(symbols.at(i)) << " sets lines no opcode uses\n";
+	}
+
+	return out.str();
+}
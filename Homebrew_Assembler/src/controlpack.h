@@ -0,0 +1,98 @@
+#pragma once
+
+#include "architecture.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Repacks the control lines of an architecture into as few decoder rom bits as the microcode allows.
+//
+// The fields are found from the line values, in the order the lines are defined: lines whose bits
+// overlap share a field, except for a line that joins two fields of several lines each, which is
+// a shorthand (like fetch) and not a field value of its own. Every control word the opcodes use
+// is then split into signals -- the non-zero value it has in each field -- and two signals
+// conflict when some word has both. Signals that never conflict can share a field, and a field
+// of k signals takes enough bits for k codes and "none".
+//
+// The search starts from the fields as written (and from a greedy packing, whichever is smaller)
+// and moves single signals between fields, accepting a wider packing now and then while the
+// temperature is high (simulated annealing), so it can leave a local minimum. Fields are bitsets
+// of signals, so testing a move against a field is a few ANDs.
+//
+// The rewritten control section keeps every line name, gives the lines no opcode uses no value
+// (they are commented out), and writes the shorthands as an OR of the lines they set. It is a
+// drop-in replacement as long as no seq line combines two lines of one field (with |, or ^ for
+// active-low lines), which selects a third value of that field. When that value has no line of its
+// own it is reported; when it has one, nothing in the microcode tells the two apart.
+class controlPacker
+{
+public:
+	explicit controlPacker(const architecture& arch);
+
+	// Searches for a smaller packing -- the same seed always gives the same result
+	void optimize(int iterations, uint32_t seed = 1);
+
+	int signalCount() const { return static_cast<int>(_signals.size()); }
+	int originalWidth() const { return _originalWidth; }
+	int packedWidth() const { return _bestWidth; }
+
+	// Logs the widths, the bounds and the packed fields with their decode tables
+	void summary() const;
+
+	// The control section of the packed layout, to replace the one in the architecture file
+	std::string controlSection() const;
+
+private:
+	// One non-zero value of a field, used by at least one control word
+	class signal
+	{
+	public:
+		int field = 0;
+		uint32_t value = 0;
+		int line = -1;		// architecture symbol with exactly that value, or -1
+		size_t uses = 0;	// control words (by distinct word) that set it
+	};
+
+	class field
+	{
+	public:
+		uint32_t mask = 0;
+		int lines = 0;
+	};
+
+	using bitset = std::vector<uint64_t>;
+
+	static int bitsFor(int signals);
+	int widthOf(const std::vector<int>& counts) const;
+	int fieldOf(uint32_t bits) const;
+	std::string nameOf(int s) const;
+	bool conflicts(int s, const uint64_t* members) const;
+
+	void buildFields();
+	void buildSignals();
+	std::vector<int> greedy() const;
+
+	// codes and shifts of the best packing, in field order
+	void layout(std::vector<std::vector<int>>& fields, std::vector<int>& shifts) const;
+
+private:
+	const architecture& _arch;
+
+	std::vector<field> _fields;
+	std::vector<int> _lineField;			// by symbol index, -1 for shorthands and other symbols
+	std::vector<int> _shorthands;			// symbol indices
+
+	std::vector<signal> _signals;
+	std::vector<uint32_t> _words;			// the distinct control words the opcodes use
+	std::vector<std::vector<int>> _wordSignals;
+	int _maxActive = 0;						// most signals one word sets
+
+	size_t _stride = 0;						// uint64_t per signal bitset
+	std::vector<uint64_t> _conflicts;		// one bitset per signal
+
+	int _originalWidth = 0;
+	std::vector<int> _best;					// packed field of each signal
+	int _bestWidth = 0;
+	double _ms = 0;
+};
@@ -0,0 +1,134 @@
+#include "decoder.h"
+#include "threadpool.h"
+#include "util.h"
+
+#include <algorithm>
+#include <future>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DECODER_SSE2
+#endif
+
+// the largest image generate() will build (2^26 words = 256 MB)
+static constexpr int MAX_ADDRESS_BITS = 26;
+
+static void fillWords(uint32_t* dst, size_t n, uint32_t value)
+{
+	size_t i = 0;
+
+#ifdef DECODER_SSE2
+	const __m128i wide = _mm_set1_epi32(static_cast<int>(value));
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), wide);
+#endif
+
+	for (; i < n; i++)
+		dst[i] = value;
+}
+
+static int bitWidth(uint32_t v)
+{
+	int bits = 0;
+	while (v != 0)
+	{
+		bits++;
+		v >>= 1;
+	}
+
+	return bits;
+}
+
+void decoderRom::generate(const microcodeStore& microcode, const decoderLayout& layout)
+{
+	if (layout.cycleBits < 0 || layout.addressBits() > MAX_ADDRESS_BITS)
+	{
+		std::stringstream msg;
+		msg << "Decoder rom layout does not fit! (" << layout.opcodeBits << " opcode bits, " << layout.cycleBits << " cycle bits, " << layout.flagBits << " flag bits)";
+		throw std::runtime_error(msg.str());
+	}
+
+	const int values = 1 << layout.opcodeBits;
+	const int cycles = 1 << layout.cycleBits;
+	for (int v = 0; v < microcode.limit(); v++)
+	{
+		if (microcode.numCycles(v) > 0 && (v >= values || microcode.numCycles(v) > cycles))
+		{
+			std::stringstream msg;
+			msg << "Opcode $" << hex2 << v << " (" << dec << microcode.numCycles(v) << " cycles) does not fit the decoder rom!";
+			throw std::runtime_error(msg.str());
+		}
+	}
+
+	_layout = layout;
+	_size = size_t(1) << layout.addressBits();
+	_words.reset(new uint32_t[_size]);
+
+	const size_t flagStates = size_t(1) << layout.flagBits;
+	const int tasks = std::max(1, std::min(static_cast<int>(threadPool::instance().size()), values));
+
+	// every task fills (and clears) the image slice of its own opcode values, and returns the
+	// bits used by the control words it stored
+	auto fillRange = [&](int first, int last) -> uint32_t
+	{
+		uint32_t used = 0;
+		uint32_t* image = _words.get();
+
+		fillWords(image + layout.address(first, 0), layout.address(last, 0) - layout.address(first, 0), 0);
+
+		for (int v = first; v < last && v < microcode.limit(); v++)
+		{
+			for (int c = 0; c < microcode.numCycles(v); c++)
+			{
+				const int cycle = microcode.firstCycle(v) + c;
+				uint32_t* words = image + layout.address(v, c);
+
+				if (microcode.unconditional(cycle))
+				{
+					const uint32_t word = microcode.pattern(microcode.firstBranch(cycle));
+					fillWords(words, flagStates, word);
+					used |= word;
+				}
+				else
+				{
+					for (uint32_t f = 0; f < flagStates; f++)
+					{
+						words[f] = microcode.word(cycle, f);
+						used |= words[f];
+					}
+				}
+			}
+		}
+
+		return used;
+	};
+
+	std::vector<std::future<uint32_t>> pending;
+	for (int t = 1; t < tasks; t++)
+	{
+		const int first = values * t / tasks;
+		const int last = values * (t + 1) / tasks;
+		pending.push_back(threadPool::instance().submit([&fillRange, first, last]() { return fillRange(first, last); }));
+	}
+
+	// the calling thread takes the first range itself
+	uint32_t used = fillRange(0, values / tasks);
+	for (auto& f : pending)
+	{
+		threadPool::instance().wait(f);
+		used |= f.get();
+	}
+
+	_wordBits = bitWidth(used);
+}
+
+void decoderRom::clear()
+{
+	_words.reset();
+	_size = 0;
+	_wordBits = 0;
+	_layout = decoderLayout();
+}
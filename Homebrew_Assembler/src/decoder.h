@@ -0,0 +1,50 @@
+#pragma once
+
+#include "microcode.h"
+
+#include <cstdint>
+#include <memory>
+
+// How a decoder rom address is put together, from the most to the least significant bits:
+//     opcode value | cycle index | flag state
+class decoderLayout
+{
+public:
+	int opcodeBits = 0;
+	int cycleBits = 0;
+	int flagBits = 0;
+
+	int addressBits() const { return opcodeBits + cycleBits + flagBits; }
+	size_t address(int value, int cycle, int flags = 0) const
+	{
+		return (static_cast<size_t>(value) << (cycleBits + flagBits)) | (static_cast<size_t>(cycle) << flagBits) | static_cast<size_t>(flags);
+	}
+};
+
+// The decoder rom image -- one control word for every opcode, cycle and flag state. Entries that
+// no opcode defines are left 0.
+class decoderRom
+{
+public:
+	// Fills the whole image (2^addressBits words). The opcode values are split into ranges across
+	// the thread pool, so each task owns one contiguous slice of the image and reads the cycles of
+	// its opcodes in order. Cycles that hold for every flag state (a plain seq) are stored as one
+	// wide fill, the others take the first branch that holds for each flag state.
+	void generate(const microcodeStore& microcode, const decoderLayout& layout);
+	void clear();
+
+	bool empty() const { return _size == 0; }
+	size_t size() const { return _size; }
+	uint32_t operator[](size_t address) const { return _words[address]; }
+	const uint32_t* data() const { return _words.get(); }
+	const decoderLayout& layout() const { return _layout; }
+
+	// number of bits used by the widest control word
+	int wordBits() const { return _wordBits; }
+
+private:
+	std::unique_ptr<uint32_t[]> _words;
+	size_t _size = 0;
+	int _wordBits = 0;
+	decoderLayout _layout;
+};
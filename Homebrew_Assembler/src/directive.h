@@ -2,14 +2,17 @@
 
 #include "assembler.h"
 #include "command.h"
+#include "parser.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
 
 class includeDirective : public command
 {
 public:
-	void process(assembler& a, const std::string& d, std::string remainder, int line) const override
+	void process(assembler& a, std::string_view d, std::string_view remainder, int line) const override
 	{
 		auto token = parser::instance().extract_token_str(remainder);
 		if (!token.has_value())
@@ -17,7 +20,7 @@ public:
 			// no data
 			std::stringstream msg;
 			msg << "Processing include directive ." << d << " at line <" << line << ">! No data!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
 		// check for garbage after directive
@@ -26,19 +29,20 @@ public:
 			std::stringstream msg;
 			msg << "Processing include directive ." << d << " at line <" << line << ">! Does not include : [";
 			msg << remainder << "]!!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		std::string tokenString = token.has_value() ? std::string(token.value()) : "";
-		parser::instance().trim_ws(tokenString);
+		std::string_view tokenString = parser::instance().get_trimmed(token.value());
 
 		if (!tokenString.empty())
 		{
-			if (a.echoMajorTasks())
-				std::cout << "          *** Processing include directive for file: " << tokenString << "\n";
+			LOG(LogLevel::MajorTasks) << "          *** Processing include directive for file: " << tokenString << "\n";
 
-			a.pushFile("code\\" + tokenString);
-			a.processFile();
+			IncludeResult result = a.pushFile(tokenString);
+			if (result == IncludeResult::Pushed)
+				a.processFile();
+			else if (result == IncludeResult::Skipped && logEnabled(LogLevel::MajorTasks))
+				logLine() << "          *** Skipping file already included: " << tokenString << "\n";
 		}
 		else
 		{
@@ -46,7 +50,7 @@ public:
 			std::stringstream msg;
 			msg << "Processing include directive " << d << " at line <" << line << ">! Does not include : [";
 			msg << tokenString << "]!!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 	}
 };
@@ -54,43 +58,121 @@ public:
 class originDirective : public command
 {
 public:
-	void process(assembler& a, const std::string& d, std::string remainder, int line) const override
+	void process(assembler& a, std::string_view d, std::string_view remainder, int line) const override
 	{
 		auto valueToken = parser::instance().extract_token_ws_comma(remainder);
 		if (!valueToken.has_value())
 		{
 			std::stringstream msg;
 			msg << "Assembling directive at line <" << line << ">! Org is not assigned a valid value!";
-			throw std::exception(msg.str().c_str());
+			throw std::runtime_error(msg.str());
 		}
 
-		std::string valueString = std::string(valueToken.value());
-		int parsedValue = parser::instance().parse_literal_num(valueString);
+		// the address has to fit the address width (and an int, whatever the width)
+		const int width = a.getAddressWidth();
+		const uint64_t parsedValue = literal(valueToken.value(), d, line, width > 0 ? std::min(width * 8, 31) : 31);
 
-		if (parsedValue != -1)
+		try
 		{
-			try
+			a.setAddress(static_cast<int>(parsedValue));
+
+			LOG(LogLevel::ParsedMajor) << "          *** Setting Address to $" << hex8 << parsedValue << "\n\n";
+		}
+		catch (const std::exception& e)
+		{
+			std::stringstream msg;
+			msg << "Processing directive ." << d << " at line <" << line << ">! Encountered exception!" << std::endl;
+			msg << "\t" << e.what();
+			throw std::runtime_error(msg.str());
+		}
+	}
+};
+
+class segmentDirective : public command
+{
+public:
+	// .segment name [origin [size]] -- defines a segment (when given an origin) and makes it active
+	void process(assembler& a, std::string_view d, std::string_view remainder, int line) const override
+	{
+		auto nameToken = parser::instance().extract_token_ws_comma(remainder);
+		if (!nameToken.has_value())
+		{
+			std::stringstream msg;
+			msg << "Processing directive ." << d << " at line <" << line << ">! Segment is not given a name!";
+			throw std::runtime_error(msg.str());
+		}
+
+		auto originToken = parser::instance().extract_token_ws_comma(remainder);
+		auto sizeToken = parser::instance().extract_token_ws_comma(remainder);
+
+		int index = a.findSegment(nameToken.value());
+		if (originToken.has_value())
+		{
+			if (index != -1)
 			{
-				a.setAddress(parsedValue);
+				std::stringstream msg;
+				msg << "Processing directive ." << d << " at line <" << line << ">! Segment [" << nameToken.value() << "] is already defined!";
+				throw std::runtime_error(msg.str());
+			}
+
+			const uint64_t origin = literal(originToken.value(), d, line, 32);
+			const uint64_t size = sizeToken.has_value() ? literal(sizeToken.value(), d, line, 32) : 0;
 
-				if (a.echoParsedMajor())
-					std::cout << "          *** Setting Address to $" << hex8 << parsedValue << "\n\n";
+			try
+			{
+				index = a.addSegment(nameToken.value(), static_cast<uint32_t>(origin), static_cast<uint32_t>(size));
 			}
 			catch (const std::exception& e)
 			{
 				std::stringstream msg;
-				msg << "Processing directive ." << d << " at line <" << line << ">! Encountered exception!" << std::endl;
-				msg << "\t" << e.what();
-				throw std::exception(msg.str().c_str());
+				msg << "Processing directive ." << d << " at line <" << line << ">! " << e.what();
+				throw std::runtime_error(msg.str());
 			}
 		}
-		else
+		else if (index == -1)
 		{
-			// bad value
 			std::stringstream msg;
-			msg << "Processing ORG directive " << d << " at line <" << line << ">! What is meant by : [";
-			msg << parsedValue << "]!!";
-			throw std::exception(msg.str().c_str());
+			msg << "Processing directive ." << d << " at line <" << line << ">! Unknown segment [" << nameToken.value() << "]!";
+			throw std::runtime_error(msg.str());
+		}
+
+		a.setActiveSegment(index);
+
+		if (logEnabled(LogLevel::ParsedMajor))
+		{
+			const programSegment& s = a.getSegment(index);
+			logLine() << "          *** Segment " << s.name << " ($" << hex4 << s.origin << " - $" << hex4 << s.limit << ") at $" << hex4 << a.getAddress() << "\n\n";
 		}
 	}
-};
\ No newline at end of file
+};
+
+class assertCyclesDirective : public command
+{
+public:
+	// .assert_cycles label, max -- fails the assembly if the routine at label can take more than max
+	// cycles (checked once the whole program has been read, see timing.h)
+	void process(assembler& a, std::string_view d, std::string_view remainder, int line) const override
+	{
+		auto labelToken = parser::instance().extract_token_ws_comma(remainder);
+		auto maxToken = parser::instance().extract_token_ws_comma(remainder);
+		if (!labelToken.has_value() || !maxToken.has_value())
+		{
+			std::stringstream msg;
+			msg << "Processing directive ." << d << " at line <" << line << ">! Expected a label and a number of cycles!";
+			throw std::runtime_error(msg.str());
+		}
+
+		parser::instance().trim_ws(remainder);
+		if (!remainder.empty())
+		{
+			std::stringstream msg;
+			msg << "Processing directive ." << d << " at line <" << line << ">! Does not include : [" << remainder << "]!!";
+			throw std::runtime_error(msg.str());
+		}
+
+		const uint64_t max = literal(maxToken.value(), d, line, 63);
+		a.addCycleBudget(labelToken.value(), static_cast<int64_t>(max));
+
+		LOG(LogLevel::ParsedMajor) << "          *** Cycle budget of " << max << " for " << labelToken.value() << "\n\n";
+	}
+};
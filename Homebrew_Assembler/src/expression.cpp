@@ -0,0 +1,257 @@
+#include "expression.h"
+#include "util.h"
+#include "parser.h"
+
+enum class TokenKind { End, Value, Or, Shl, Shr, Assign, Open, Close, Bad };
+
+static bool isOperatorChar(char c)
+{
+	return c == '|' || c == '<' || c == '>' || c == '=' || c == '(' || c == ')';
+}
+
+// Splits off the next token (whitespace and commas only separate tokens)
+static TokenKind nextToken(std::string_view& s, std::string_view& token)
+{
+	while (!s.empty() && (isspace(s.front()) || s.front() == ','))
+		s.remove_prefix(1);
+
+	if (s.empty())
+		return TokenKind::End;
+
+	size_t length = 1;
+	TokenKind kind = TokenKind::Bad;
+
+	switch (s.front())
+	{
+	case '|': kind = TokenKind::Or; break;
+	case '=': kind = TokenKind::Assign; break;
+	case '(': kind = TokenKind::Open; break;
+	case ')': kind = TokenKind::Close; break;
+
+	case '<':
+	case '>':
+		if (s.size() > 1 && s[1] == s[0])
+		{
+			kind = s[0] == '<' ? TokenKind::Shl : TokenKind::Shr;
+			length = 2;
+		}
+		break;
+
+	default:
+		kind = TokenKind::Value;
+		while (length < s.size() && !isspace(s[length]) && s[length] != ',' && !isOperatorChar(s[length]))
+			length++;
+	}
+
+	token = s.substr(0, length);
+	s.remove_prefix(length);
+	return kind;
+}
+
+controlExpressions::controlExpressions(const symbolTable& symbols, std::pmr::memory_resource* resource)
+	:
+	_symbols(symbols),
+	_resource(resource),
+	_texts(resource),
+	_values(resource)
+{}
+
+ExprStatus controlExpressions::evaluate(std::string_view text, int& value, std::string_view& culprit)
+{
+	text = parser::instance().get_trimmed(text);
+
+	const int known = _texts.find(text);
+	if (known != stringPool::NONE)
+	{
+		value = _values[known];
+		return ExprStatus::Ok;
+	}
+
+	ExprStatus status = compile(text, culprit);
+	if (status != ExprStatus::Ok)
+		return status;
+
+	// control words are 32 bits, anything above them would be lost by the narrowing
+	const uint64_t result = _operands.back();
+	if (result > UINT32_MAX)
+	{
+		culprit = text;
+		return ExprStatus::Overflow;
+	}
+
+	value = static_cast<int>(static_cast<uint32_t>(result));
+
+	_texts.intern(text);
+	_values.push_back(value);
+
+	return ExprStatus::Ok;
+}
+
+void controlExpressions::clear()
+{
+	_texts.clear();
+	resetVector(_values, _resource);
+}
+
+ExprStatus controlExpressions::compile(std::string_view text, std::string_view& culprit)
+{
+	_operands.clear();
+	_operators.clear();
+
+	bool expectOperand = true;
+	bool first = true;
+
+	// shunting-yard into postfix
+	std::string_view token;
+	for (TokenKind kind = nextToken(text, token); kind != TokenKind::End; kind = nextToken(text, token), first = false)
+	{
+		culprit = token;
+
+		switch (kind)
+		{
+		case TokenKind::Assign:
+			// control fetch = ...
+			if (!first)
+				return ExprStatus::BadToken;
+			break;
+
+		case TokenKind::Value:
+		{
+			if (!expectOperand)
+				return ExprStatus::MissingOperator;
+
+			uint64_t value = 0;
+			if (parser::instance().parse_literal(token, value) != LiteralStatus::Ok)
+			{
+				const symbol* s = _symbols.find(token);
+				if (s == nullptr)
+					return ExprStatus::UnknownSymbol;
+
+				value = static_cast<uint32_t>(s->getAddress());
+
+				// active-low lines toggle rather than set their bits
+				if (token.front() == '_' && !_operators.empty() && _operators.back() == OpKind::Or)
+					_operators.back() = OpKind::Xor;
+			}
+
+			_operands.push_back(value);
+			expectOperand = false;
+			break;
+		}
+
+		case TokenKind::Or:
+		case TokenKind::Shl:
+		case TokenKind::Shr:
+		{
+			if (expectOperand)
+				return ExprStatus::MissingOperand;
+
+			const OpKind op = kind == TokenKind::Or ? OpKind::Or : kind == TokenKind::Shl ? OpKind::Shl : OpKind::Shr;
+			while (!_operators.empty() && precedence(_operators.back()) >= precedence(op))
+			{
+				emit(_operators.back());
+				_operators.pop_back();
+			}
+
+			_operators.push_back(op);
+			expectOperand = true;
+			break;
+		}
+
+		case TokenKind::Open:
+			if (!expectOperand)
+				return ExprStatus::MissingOperator;
+
+			_operators.push_back(OpKind::Open);
+			break;
+
+		case TokenKind::Close:
+			if (expectOperand)
+				return ExprStatus::MissingOperand;
+
+			while (!_operators.empty() && _operators.back() != OpKind::Open)
+			{
+				emit(_operators.back());
+				_operators.pop_back();
+			}
+
+			if (_operators.empty())
+				return ExprStatus::UnbalancedParens;
+
+			_operators.pop_back();
+			break;
+
+		default:
+			return ExprStatus::BadToken;
+		}
+	}
+
+	if (expectOperand)
+		return _operands.empty() && _operators.empty() ? ExprStatus::Empty : ExprStatus::MissingOperand;
+
+	while (!_operators.empty())
+	{
+		if (_operators.back() == OpKind::Open)
+			return ExprStatus::UnbalancedParens;
+
+		emit(_operators.back());
+		_operators.pop_back();
+	}
+
+	return ExprStatus::Ok;
+}
+
+uint64_t controlExpressions::apply(uint64_t lhs, uint64_t rhs, OpKind kind)
+{
+	switch (kind)
+	{
+	case OpKind::Or: return lhs | rhs;
+	case OpKind::Xor: return lhs ^ rhs;
+	case OpKind::Shl: return lhs << (rhs & 63);
+	case OpKind::Shr: return lhs >> (rhs & 63);
+	default: break;
+	}
+
+	return 0;
+}
+
+void controlExpressions::emit(OpKind kind)
+{
+	// every operand is a constant, so an operation is done as soon as it is emitted -- compile
+	// only emits one after its two operands
+	const uint64_t rhs = _operands.back();
+	_operands.pop_back();
+	_operands.back() = apply(_operands.back(), rhs, kind);
+}
+
+const char* controlExpressions::status_str(ExprStatus s)
+{
+	switch (s)
+	{
+	case ExprStatus::Ok:
+		return "Ok";
+
+	case ExprStatus::Empty:
+		return "No control expression";
+
+	case ExprStatus::UnknownSymbol:
+		return "Unknown symbol in control expression";
+
+	case ExprStatus::BadToken:
+		return "Unexpected token in control expression";
+
+	case ExprStatus::MissingOperand:
+		return "Missing operand in control expression";
+
+	case ExprStatus::MissingOperator:
+		return "Missing operator in control expression";
+
+	case ExprStatus::UnbalancedParens:
+		return "Unbalanced parentheses in control expression";
+
+	case ExprStatus::Overflow:
+		return "Control expression does not fit 32 bits";
+	}
+
+	return "";
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "intern.h"
+#include "symboltable.h"
+
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+enum class ExprStatus { Ok, Empty, UnknownSymbol, BadToken, MissingOperand, MissingOperator, UnbalancedParens, Overflow };
+
+// Compiles the control expressions used by control lines, opcodes and seq lines, for example
+//     fetch = _mem_write_data | _pc_write_addr | ir_read_data | pc_inc
+//     alu_add_lhs_rhs 18 << 27
+// Operands are literal numbers or symbols, '<<' and '>>' bind tighter than '|', parentheses
+// group, and a leading '=' is ignored. Following the active-low naming convention, a symbol
+// starting with '_' is combined with '^' instead of '|' so its bits toggle the lines it shares.
+//
+// An expression is parsed once with a shunting-yard, and as every operand is a constant, each
+// operation is done as soon as it is emitted, leaving the value as the only operand. The result
+// is memoized by the interned expression text, so identical right hand sides (such as
+// 'seq fetch' in nearly every opcode) are only ever compiled once.
+class controlExpressions
+{
+public:
+	controlExpressions(const symbolTable& symbols, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	// On failure, culprit is the token that could not be handled (the whole text when the value
+	// does not fit 32 bits)
+	ExprStatus evaluate(std::string_view text, int& value, std::string_view& culprit);
+
+	// Forgets every result (symbols may change between assemblies)
+	void clear();
+
+	int distinct() const { return _texts.count(); }
+
+	static const char* status_str(ExprStatus s);
+
+private:
+	enum class OpKind : uint8_t { Or, Xor, Shl, Shr, Open };
+
+	ExprStatus compile(std::string_view text, std::string_view& culprit);
+	void emit(OpKind kind);
+
+	static uint64_t apply(uint64_t lhs, uint64_t rhs, OpKind kind);
+
+	static int precedence(OpKind kind) { return kind == OpKind::Shl || kind == OpKind::Shr ? 2 : kind == OpKind::Open ? 0 : 1; }
+
+private:
+	const symbolTable& _symbols;
+	std::pmr::memory_resource* _resource;
+
+	// memoized results, indexed by the interned text's id
+	stringPool _texts;
+	std::pmr::vector<int> _values;
+
+	// scratch space reused by every compile
+	std::vector<uint64_t> _operands;
+	std::vector<OpKind> _operators;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "include.h"
+
+#include <cstdint>
+
+// How a fixup turns the symbol's value into the bytes of its field
+enum class FixupKind : uint8_t
+{
+	Absolute,	// the value itself, little-endian (the only kind the instruction forms need so far)
+};
+
+// A value field that could not be filled in when its instruction was emitted, because it names a
+// symbol that was not defined yet. The field is emitted as zeros, and once the whole program has
+// been read every fixup is patched in one loop (see assembler::resolveFixups).
+class fixup
+{
+public:
+	uint32_t address = 0;		// first byte of the field in the program rom
+	int symbol = -1;			// interned name (see symbolTable::nameId)
+	sourceLocation where;		// of the instruction, for errors
+	uint8_t bytes = 0;
+	FixupKind kind = FixupKind::Absolute;
+};
@@ -0,0 +1,131 @@
+#include "include.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+// directory listings are compared case-insensitively where the file system is
+static std::string indexKey(std::string s)
+{
+#ifdef _WIN32
+	std::transform(s.begin(), s.end(), s.begin(), [](char c) { return static_cast<char>(tolower(c)); });
+#endif
+	return s;
+}
+
+void includeCache::addSearchPath(const std::string& path)
+{
+	if (std::find(_searchPaths.begin(), _searchPaths.end(), path) == _searchPaths.end())
+		_searchPaths.push_back(path);
+}
+
+int includeCache::resolve(std::string_view n, int fromFile)
+{
+	// the same name included from the same file always resolves to the same file
+	std::string memo = std::to_string(fromFile) + '|' + std::string(n);
+	auto known = _resolved.find(memo);
+	if (known != _resolved.end())
+		return known->second;
+
+	// accept either separator in include names
+	std::string filename(n);
+	std::replace(filename.begin(), filename.end(), '\\', '/');
+
+	const fs::path requested = fs::path(filename).make_preferred();
+	const bool plainName = !requested.has_parent_path();
+
+	if (requested.is_absolute())
+		return _resolved[memo] = load(requested.string());
+
+	// the including file's own directory is always searched first
+	std::vector<std::string> directories;
+	if (fromFile != -1)
+		directories.push_back(fs::path(_files[fromFile].name).parent_path().string());
+	else
+		directories.push_back("");
+
+	directories.insert(directories.end(), _searchPaths.begin(), _searchPaths.end());
+
+	for (const std::string& directory : directories)
+	{
+		const bool found = plainName ? directoryContains(directory, filename) : fs::exists(fs::path(directory) / requested);
+
+		if (found)
+			return _resolved[memo] = load((fs::path(directory) / requested).string());
+	}
+
+	std::stringstream msg;
+	msg << "Unable to find include file [" << n << "]! Searched :";
+	for (const std::string& directory : directories)
+		msg << " [" << (directory.empty() ? "." : directory) << "]";
+
+	throw std::runtime_error(msg.str());
+}
+
+void includeCache::reload(int id)
+{
+	_files[id].file->open(_files[id].name);
+}
+
+void includeCache::refresh()
+{
+	_resolved.clear();
+	_directoryIndex.clear();
+}
+
+bool includeCache::directoryContains(const std::string& directory, const std::string& filename)
+{
+	const std::string key = directory.empty() ? "." : directory;
+
+	auto listing = _directoryIndex.find(key);
+	if (listing == _directoryIndex.end())
+	{
+		// read the directory once and remember every regular file in it
+		std::unordered_set<std::string> entries;
+
+		std::error_code ec;
+		for (fs::directory_iterator it(key, ec), end; !ec && it != end; it.increment(ec))
+		{
+			if (it->is_regular_file(ec))
+				entries.insert(indexKey(it->path().filename().string()));
+		}
+
+		listing = _directoryIndex.emplace(key, std::move(entries)).first;
+	}
+
+	return listing->second.count(indexKey(filename)) > 0;
+}
+
+int includeCache::load(const std::string& path)
+{
+	std::error_code ec;
+	std::string canonical = fs::canonical(path, ec).string();
+	if (ec)
+		canonical = fs::absolute(path).lexically_normal().string();
+
+	canonical = indexKey(canonical);
+
+	auto i = _ids.find(canonical);
+	if (i != _ids.end())
+		return i->second;
+
+	if (_files.size() >= sourceLocation::MAX_FILES)
+	{
+		std::stringstream msg;
+		msg << "Too many source files! Cannot load [" << path << "] (limit is " << sourceLocation::MAX_FILES << ")";
+		throw std::runtime_error(msg.str());
+	}
+
+	entry e;
+	e.name = path;
+	e.canonical = canonical;
+	e.file = std::make_unique<sourceFile>(path);
+
+	_files.push_back(std::move(e));
+	_ids.emplace(canonical, static_cast<int>(_files.size()) - 1);
+
+	return static_cast<int>(_files.size()) - 1;
+}
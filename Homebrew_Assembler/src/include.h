@@ -0,0 +1,90 @@
+#pragma once
+
+#include "sourcefile.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A source position packed into 32 bits: the upper FILE_BITS hold the include cache's
+// file id and the lower LINE_BITS hold the (zero-based) line number within that file. The include
+// cache refuses more than MAX_FILES files, and the lexer refuses files of more than MAX_LINES lines.
+class sourceLocation
+{
+public:
+	static constexpr int FILE_BITS = 10;
+	static constexpr int LINE_BITS = 32 - FILE_BITS;
+	static constexpr uint32_t MAX_FILES = 1u << FILE_BITS;
+	static constexpr uint32_t MAX_LINES = 1u << LINE_BITS;
+
+	sourceLocation() = default;
+	sourceLocation(int file, int line)
+		:
+		_packed((static_cast<uint32_t>(file) << LINE_BITS) | (static_cast<uint32_t>(line) & (MAX_LINES - 1)))
+	{}
+
+	int file() const { return static_cast<int>(_packed >> LINE_BITS); }
+	int line() const { return static_cast<int>(_packed & (MAX_LINES - 1)); }
+	uint32_t packed() const { return _packed; }
+
+private:
+	uint32_t _packed = 0;
+};
+
+// Loads every source file exactly once, keyed by its canonical path. Files stay mapped for the
+// lifetime of the cache so the assembler can leave an including file and come back to it by
+// byte offset. Include names are resolved against the including file's directory first and
+// then the search path, using a directory listing that is read once per directory.
+class includeCache
+{
+public:
+	// search path handling
+	void addSearchPath(const std::string& path);
+	void clearSearchPaths() { _searchPaths.clear(); }
+	const std::vector<std::string>& searchPaths() const { return _searchPaths; }
+
+	// Returns the id of the file named n (as written in an include directive), loading
+	// it on first use. fromFile is the id of the including file, or -1 for the start file.
+	int resolve(std::string_view n, int fromFile);
+
+	// Re-map a file whose contents changed on disk (anything still viewing the old mapping
+	// must be dropped first), and forget cached directory listings and resolved names
+	void reload(int id);
+	void refresh();
+
+	// include-once bookkeeping -- returns false if the file was already included
+	bool markIncluded(int id) { return _included.insert(id).second; }
+	bool isIncluded(int id) const { return _included.count(id) != 0; }
+	void resetIncluded() { _included.clear(); }
+
+	// file access
+	int count() const { return static_cast<int>(_files.size()); }
+	const sourceFile& file(int id) const { return *_files[id].file; }
+	const std::string& name(int id) const { return _files[id].name; }
+	const std::string& canonicalName(int id) const { return _files[id].canonical; }
+
+private:
+	bool directoryContains(const std::string& directory, const std::string& filename);
+	int load(const std::string& path);
+
+private:
+	class entry
+	{
+	public:
+		std::string name;
+		std::string canonical;
+		std::unique_ptr<sourceFile> file;
+	};
+
+	std::vector<entry> _files;
+	std::unordered_map<std::string, int> _ids;
+	std::unordered_map<std::string, int> _resolved;
+	std::unordered_set<int> _included;
+
+	std::vector<std::string> _searchPaths;
+	std::unordered_map<std::string, std::unordered_set<std::string>> _directoryIndex;
+};
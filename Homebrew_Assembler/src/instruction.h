@@ -1,48 +1,27 @@
 #pragma once
 
+#include "assembler.h"
 #include "command.h"
+#include "parser.h"
+
+#include <sstream>
+#include <stdexcept>
 
 class opcodeInstruction : public command
 {
 public:
-	virtual void process(assembler& assembler, std::string& line, int value0, int value1, int startAddress) const override
+	// mnemonic is the first token of the line, operands the rest of it
+	virtual void process(assembler& assembler, std::string_view mnemonic, std::string_view operands, int line) const override
 	{
-		int oc_value = assembler.getValueByUniqueOpcodeString(line);
-		int instruction_width = assembler.getInstructionWidth();
-
-		//for (int i = 0; i < instruction_width; i++)
+		instructionMatch match;
+		if (!assembler.matchInstruction(mnemonic, operands, match))
 		{
-			assembler.addByteToProgramRom(oc_value);
-			/*
-			if (i < instruction_width - 1)
-				assembler.AddByteToProgramROM(0);
-			else
-				assembler.AddByteToProgramROM(oc_value);
-				*/
+			std::stringstream msg;
+			msg << "Assembling instruction at line <" << line << ">! No opcode matches [" << mnemonic << " "
+				<< parser::instance().get_trimmed(operands) << "]!";
+			throw std::runtime_error(msg.str());
 		}
 
-		if (value0 != -1)
-		{
-			assembler.addByteToProgramRom(value0);
-			/*for (int i = 0; i < instruction_width; i++)
-			{
-				if (i < instruction_width - 1)
-					assembler.AddByteToProgramROM(0);
-				else
-					assembler.AddByteToProgramROM(value0);
-			}*/
-		}
-
-		if (value1 != -1)
-		{
-			assembler.addByteToProgramRom(value1);
-			/*for (int i = 0; i < instruction_width; i++)
-			{
-				if (i < instruction_width - 1)
-					assembler.AddByteToProgramROM(0);
-				else
-					assembler.AddByteToProgramROM(value1);
-			}*/
-		}
+		assembler.addInstruction(match, mnemonic, operands, line);
 	}
 };
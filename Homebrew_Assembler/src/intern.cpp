@@ -0,0 +1,113 @@
+#include "intern.h"
+#include "util.h"
+
+#include <cstring>
+
+static uint32_t nameHash(std::string_view name)
+{
+	const uint64_t h = fnv1a(name);
+	return static_cast<uint32_t>(h ^ (h >> 32));
+}
+
+stringPool::stringPool(std::pmr::memory_resource* resource)
+	:
+	_resource(resource),
+	_blocks(resource),
+	_names(resource),
+	_hashes(resource),
+	_slots(resource)
+{}
+
+stringPool::~stringPool()
+{
+	clear();
+}
+
+int stringPool::findSlot(std::string_view name, uint32_t hash) const
+{
+	// linear probing -- the table is never more than half full
+	const size_t mask = _slots.size() - 1;
+	for (size_t i = hash & mask; ; i = (i + 1) & mask)
+	{
+		const int id = _slots[i];
+		if (id == NONE || (_hashes[id] == hash && _names[id] == name))
+			return static_cast<int>(i);
+	}
+}
+
+int stringPool::find(std::string_view name) const
+{
+	if (_slots.empty())
+		return NONE;
+
+	return _slots[findSlot(name, nameHash(name))];
+}
+
+int stringPool::intern(std::string_view name)
+{
+	if ((_names.size() + 1) * 2 > _slots.size())
+		grow();
+
+	const uint32_t hash = nameHash(name);
+	const int slot = findSlot(name, hash);
+	if (_slots[slot] != NONE)
+		return _slots[slot];
+
+	_names.push_back(store(name));
+	_hashes.push_back(hash);
+	_slots[slot] = static_cast<int>(_names.size()) - 1;
+
+	return _slots[slot];
+}
+
+void stringPool::clear()
+{
+	for (const block& b : _blocks)
+		_resource->deallocate(b.data, b.size, 1);
+
+	resetVector(_blocks, _resource);
+	_blockUsed = BLOCK_SIZE;
+	resetVector(_names, _resource);
+	resetVector(_hashes, _resource);
+	resetVector(_slots, _resource);
+}
+
+void stringPool::grow()
+{
+	_slots.assign(_slots.empty() ? 64 : _slots.size() * 2, NONE);
+
+	const size_t mask = _slots.size() - 1;
+	for (int id = 0; id < static_cast<int>(_names.size()); id++)
+	{
+		size_t i = _hashes[id] & mask;
+		while (_slots[i] != NONE)
+			i = (i + 1) & mask;
+
+		_slots[i] = id;
+	}
+}
+
+std::string_view stringPool::store(std::string_view name)
+{
+	if (name.size() > BLOCK_SIZE - _blockUsed)
+	{
+		if (name.size() > BLOCK_SIZE / 4)
+		{
+			// long names get a block of their own, so the current block keeps filling
+			block own = { static_cast<char*>(_resource->allocate(name.size(), 1)), name.size() };
+			memcpy(own.data, name.data(), name.size());
+
+			_blocks.insert(_blocks.empty() ? _blocks.end() : _blocks.end() - 1, own);
+			return std::string_view(own.data, own.size);
+		}
+
+		_blocks.push_back({ static_cast<char*>(_resource->allocate(BLOCK_SIZE, 1)), BLOCK_SIZE });
+		_blockUsed = 0;
+	}
+
+	char* text = _blocks.back().data + _blockUsed;
+	memcpy(text, name.data(), name.size());
+	_blockUsed += name.size();
+
+	return std::string_view(text, name.size());
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// Interns names: every distinct string is copied once into large blocks of character storage
+// and gets a small dense id. Ids are found through an open-addressing table of FNV-1a hashes,
+// and the views handed out stay valid until the pool is cleared. All storage comes from the
+// given memory resource (normally the assembler's session arena).
+class stringPool
+{
+public:
+	static constexpr int NONE = -1;
+
+	explicit stringPool(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+	~stringPool();
+
+	stringPool(const stringPool&) = delete;
+	stringPool& operator=(const stringPool&) = delete;
+
+	// Returns the id of the name, adding it to the pool if it is new
+	int intern(std::string_view name);
+
+	// Returns the id of the name, or NONE if it was never interned
+	int find(std::string_view name) const;
+
+	std::string_view name(int id) const { return _names[id]; }
+	int count() const { return static_cast<int>(_names.size()); }
+
+	// Forgets every name and returns all storage to the memory resource
+	void clear();
+
+private:
+	int findSlot(std::string_view name, uint32_t hash) const;
+	void grow();
+	std::string_view store(std::string_view name);
+
+private:
+	static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+	class block
+	{
+	public:
+		char* data;
+		size_t size;
+	};
+
+	std::pmr::memory_resource* _resource;
+	std::pmr::vector<block> _blocks;
+	size_t _blockUsed = BLOCK_SIZE;
+
+	std::pmr::vector<std::string_view> _names;
+	std::pmr::vector<uint32_t> _hashes;
+	std::pmr::vector<int> _slots;		// ids, or NONE for an empty slot
+};
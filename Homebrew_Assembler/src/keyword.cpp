@@ -0,0 +1,49 @@
+#include "keyword.h"
+#include "directive.h"
+#include "archtag.h"
+
+// one stateless handler per command class, shared by every keyword it handles
+static const includeDirective include;
+static const originDirective origin;
+static const segmentDirective segment;
+static const assertCyclesDirective assertCycles;
+static const archBitWidth bitWidth;
+static const archRom rom;
+static const archRegister reg;
+static const archFlagDevice flagDevice;
+static const archControlLine controlLine;
+static const archOpcode opcodeTag;
+static const archOpcodeSeq opcodeSeq;
+
+// indexed by Keyword
+static const command* const handlers[] =
+{
+	&include,		// Include
+	&origin,		// Origin
+	&segment,		// Segment
+	&assertCycles,	// AssertCycles
+	&bitWidth,		// InstructionWidth
+	&bitWidth,		// AddressWidth
+	&rom,			// DecoderRom
+	&rom,			// ProgramRom
+	&reg,			// Register
+	&flagDevice,	// Flag
+	&flagDevice,	// Device
+	&controlLine,	// Control
+	&opcodeTag,		// Opcode
+	&opcodeTag,		// OpcodeAlias
+	&opcodeSeq,		// OpcodeSeq
+	&opcodeSeq,		// OpcodeSeqIf
+	&opcodeSeq,		// OpcodeSeqElif
+	&opcodeSeq,		// OpcodeSeqElse
+	nullptr,		// EndArch
+};
+
+static_assert(sizeof(handlers) / sizeof(handlers[0]) == static_cast<size_t>(Keyword::Count), "handler table out of sync");
+
+void keywords::dispatch(assembler& a, Keyword k, std::string_view remainder, int line)
+{
+	const command* handler = handlers[static_cast<size_t>(k)];
+	if (handler)
+		handler->process(a, spec(k).name, remainder, line);
+}
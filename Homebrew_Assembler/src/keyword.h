@@ -0,0 +1,161 @@
+#pragma once
+
+#include "config.h"
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Every keyword that can start a line of architecture or directive source. The order matches
+// KEYWORD_SPECS below and the dispatch table in keyword.cpp.
+enum class Keyword : uint8_t
+{
+	Include,
+	Origin,
+	Segment,
+	AssertCycles,
+	InstructionWidth,
+	AddressWidth,
+	DecoderRom,
+	ProgramRom,
+	Register,
+	Flag,
+	Device,
+	Control,
+	Opcode,
+	OpcodeAlias,
+	OpcodeSeq,
+	OpcodeSeqIf,
+	OpcodeSeqElif,
+	OpcodeSeqElse,
+	EndArch,
+
+	Count,
+	None = Count
+};
+
+class keywordSpec
+{
+public:
+	std::string_view name;	// without the DIRECTIVE_KEY
+	bool directive;			// written as .name
+	bool pass0;				// handled while the architecture and include tree are read
+};
+
+// The order matches the Keyword enum
+constexpr keywordSpec KEYWORD_SPECS[] =
+{
+	{ INCLUDE_STR, true, true },
+	{ ORIGIN_STR, true, false },
+	{ SEGMENT_STR, true, false },
+	{ ASSERT_CYCLES_STR, true, false },
+	{ INSTRUCTION_WIDTH_STR, false, true },
+	{ ADDRESS_WIDTH_STR, false, true },
+	{ DECODER_ROM_STR, false, true },
+	{ PROGRAM_ROM_STR, false, true },
+	{ REGISTER_STR, false, true },
+	{ FLAG_STR, false, true },
+	{ DEVICE_STR, false, true },
+	{ CONTROL_STR, false, true },
+	{ OPCODE_STR, false, true },
+	{ OPCODE_ALIAS_STR, false, true },
+	{ OPCODE_SEQ_STR, false, true },
+	{ OPCODE_SEQ_IF_STR, false, true },
+	{ OPCODE_SEQ_ELIF_STR, false, true },
+	{ OPCODE_SEQ_ELSE_STR, false, true },
+	{ END_ARCH_STR, false, true },
+};
+
+static_assert(sizeof(KEYWORD_SPECS) / sizeof(KEYWORD_SPECS[0]) == static_cast<size_t>(Keyword::Count), "keyword table out of sync");
+
+// Compile-time search for a perfect hash of the keywords -- the first seed that gives every
+// keyword its own slot in a table of TABLE_SIZE entries
+namespace keywordHash
+{
+	constexpr size_t TABLE_SIZE = 64;
+	constexpr uint8_t EMPTY = 0xFF;
+
+	static_assert((TABLE_SIZE & (TABLE_SIZE - 1)) == 0, "TABLE_SIZE must be a power of two");
+	static_assert(static_cast<size_t>(Keyword::Count) < TABLE_SIZE, "TABLE_SIZE too small");
+
+	constexpr uint32_t hash(std::string_view s, bool directive, uint32_t seed)
+	{
+		uint32_t h = seed;
+		for (char c : s)
+			h = (h ^ static_cast<uint8_t>(c)) * 16777619u;
+
+		h = (h ^ (directive ? 1u : 0u)) * 16777619u;
+		return h ^ (h >> 16);
+	}
+
+	constexpr bool collisionFree(uint32_t seed)
+	{
+		bool used[TABLE_SIZE] = {};
+		for (const keywordSpec& k : KEYWORD_SPECS)
+		{
+			const size_t slot = hash(k.name, k.directive, seed) & (TABLE_SIZE - 1);
+			if (used[slot])
+				return false;
+
+			used[slot] = true;
+		}
+
+		return true;
+	}
+
+	constexpr uint32_t findSeed()
+	{
+		uint32_t seed = 2166136261u;
+		while (!collisionFree(seed))
+			seed++;
+
+		return seed;
+	}
+
+	constexpr std::array<uint8_t, TABLE_SIZE> buildSlots(uint32_t seed)
+	{
+		std::array<uint8_t, TABLE_SIZE> slots = {};
+		for (size_t i = 0; i < TABLE_SIZE; i++)
+			slots[i] = EMPTY;
+
+		for (size_t i = 0; i < static_cast<size_t>(Keyword::Count); i++)
+			slots[hash(KEYWORD_SPECS[i].name, KEYWORD_SPECS[i].directive, seed) & (TABLE_SIZE - 1)] = static_cast<uint8_t>(i);
+
+		return slots;
+	}
+
+	constexpr uint32_t SEED = findSeed();
+	constexpr std::array<uint8_t, TABLE_SIZE> SLOTS = buildSlots(SEED);
+}
+
+// Classifies first tokens with the perfect hash above, so classifying a token is one hash and
+// one compare, and dispatching it is one indirect call through a static table of handlers
+class keywords
+{
+public:
+	static constexpr const keywordSpec& spec(Keyword k) { return KEYWORD_SPECS[static_cast<size_t>(k)]; }
+	static constexpr bool isPass0(Keyword k) { return k != Keyword::None && spec(k).pass0; }
+
+	static constexpr Keyword classify(std::string_view token)
+	{
+		const bool directive = !token.empty() && token.front() == DIRECTIVE_KEY;
+		if (directive)
+			token.remove_prefix(1);
+
+		const uint8_t entry = keywordHash::SLOTS[keywordHash::hash(token, directive, keywordHash::SEED) & (keywordHash::TABLE_SIZE - 1)];
+		if (entry == keywordHash::EMPTY)
+			return Keyword::None;
+
+		const keywordSpec& k = KEYWORD_SPECS[entry];
+		return (k.directive == directive && k.name == token) ? static_cast<Keyword>(entry) : Keyword::None;
+	}
+
+	// Runs the handler for the keyword (if it has one) on the rest of the line
+	static void dispatch(class assembler& a, Keyword k, std::string_view remainder, int line);
+};
+
+static_assert(keywords::classify(".include") == Keyword::Include, "keyword hash broken");
+static_assert(keywords::classify("include") == Keyword::None, "keyword hash broken");
+static_assert(keywords::classify(".segment") == Keyword::Segment, "keyword hash broken");
+static_assert(keywords::classify(OPCODE_SEQ_ELIF_STR) == Keyword::OpcodeSeqElif, "keyword hash broken");
+static_assert(keywords::classify(OPCODE_SEQ_ELSE_STR) == Keyword::OpcodeSeqElse, "keyword hash broken");
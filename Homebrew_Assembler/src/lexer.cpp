@@ -0,0 +1,189 @@
+#include "lexer.h"
+#include "parser.h"
+#include "config.h"
+#include "threadpool.h"
+
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+lexer::~lexer()
+{
+	// the workers read from mappings owned by the include cache, so never leave them running
+	for (std::future<lexedFile>& pending : _pending)
+	{
+		if (pending.valid())
+			threadPool::instance().wait(pending);
+	}
+}
+
+// The file name an include line names, given the rest of the line after the directive
+static std::optional<std::string_view> includeName(std::string_view remainder)
+{
+	auto name = parser::instance().extract_token_str(remainder);
+	if (!name.has_value())
+		return std::nullopt;
+
+	return parser::instance().get_trimmed(name.value());
+}
+
+std::vector<std::string_view> lexer::scanIncludes(const sourceFile& file)
+{
+	std::vector<std::string_view> names;
+
+	size_t offset = 0;
+	std::string_view line;
+	while (file.line_at(offset, line))
+	{
+		// only a line that starts with a directive can be an include, everything else is skipped
+		// without being tokenized
+		const size_t first = line.find_first_not_of(" \t");
+		if (first == std::string_view::npos || line[first] != DIRECTIVE_KEY)
+			continue;
+
+		std::string_view remainder = line;
+		parser::instance().strip_comment(remainder);
+		auto token = parser::instance().extract_token_ws(remainder);
+
+		if (token.has_value() && keywords::classify(token.value()) == Keyword::Include)
+		{
+			auto name = includeName(remainder);
+			if (name.has_value())
+				names.push_back(name.value());
+		}
+	}
+
+	return names;
+}
+
+lexedFile lexer::lex(const sourceFile& file)
+{
+	lexedFile lexed;
+
+	size_t offset = 0;
+	std::string_view line;
+	while (file.line_at(offset, line))
+	{
+		// a longer file could not be given source locations
+		if (lexed.lines.size() == sourceLocation::MAX_LINES)
+		{
+			std::stringstream msg;
+			msg << "Too many lines in source file [" << file.filename() << "]! (limit is " << sourceLocation::MAX_LINES << ")";
+			throw std::runtime_error(msg.str());
+		}
+
+		lexedLine l;
+		l.text = line;
+
+		// remove any comments and extract token
+		std::string_view remainder = line;
+		parser::instance().strip_comment(remainder);
+		auto token = parser::instance().extract_token_ws(remainder);
+
+		if (token.has_value())
+		{
+			l.token = token.value();
+			l.remainder = remainder;
+			l.keyword = keywords::classify(l.token);
+
+			// note include names so the caller can go find those files too
+			if (l.keyword == Keyword::Include)
+			{
+				auto name = includeName(remainder);
+				if (name.has_value())
+					lexed.includes.push_back(name.value());
+			}
+		}
+
+		lexed.lines.push_back(l);
+	}
+
+	return lexed;
+}
+
+void lexer::schedule(int id)
+{
+	if (static_cast<int>(_pending.size()) <= id)
+	{
+		_pending.resize(id + 1);
+		_lexed.resize(id + 1);
+	}
+
+	if (_lexed[id] || _pending[id].valid())
+		return;
+
+	const sourceFile* file = &_includes.file(id);
+	_pending[id] = threadPool::instance().submit([file]() { return lex(*file); });
+}
+
+void lexer::prefetch(int rootFile)
+{
+	std::unordered_set<int> seen = { rootFile };
+	std::vector<int> queue = { rootFile };
+
+	// every file is lexed on the pool as soon as it is found, while the scan goes on to its includes
+	for (size_t i = 0; i < queue.size(); i++)
+	{
+		const int id = queue[i];
+		schedule(id);
+
+		for (std::string_view name : scanIncludes(_includes.file(id)))
+		{
+			// a name that does not resolve is not an error yet -- pass0 resolves it again when it
+			// reaches the include directive, and throws the error there
+			try
+			{
+				const int child = _includes.resolve(name, id);
+				if (seen.insert(child).second)
+					queue.push_back(child);
+			}
+			catch (const std::runtime_error&)
+			{
+			}
+		}
+	}
+}
+
+void lexer::invalidate(int id)
+{
+	if (id < static_cast<int>(_lexed.size()))
+	{
+		if (_pending[id].valid())
+			threadPool::instance().wait(_pending[id]);
+
+		_pending[id] = std::future<lexedFile>();
+		_lexed[id].reset();
+	}
+}
+
+void lexer::relex(const std::vector<int>& ids)
+{
+	for (int id : ids)
+		schedule(id);
+
+	for (int id : ids)
+		get(id);
+}
+
+const lexedFile& lexer::get(int id)
+{
+	if (static_cast<int>(_lexed.size()) <= id)
+	{
+		_pending.resize(id + 1);
+		_lexed.resize(id + 1);
+	}
+
+	if (!_lexed[id])
+	{
+		if (_pending[id].valid())
+		{
+			threadPool::instance().wait(_pending[id]);
+			_lexed[id] = std::make_unique<lexedFile>(_pending[id].get());
+		}
+		else
+			_lexed[id] = std::make_unique<lexedFile>(lex(_includes.file(id)));
+	}
+
+	return *_lexed[id];
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "include.h"
+#include "keyword.h"
+
+#include <future>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// A source line with comments removed and split into its first token and the rest of the line,
+// with the token already classified. All views point into the include cache's mapping of the file.
+class lexedLine
+{
+public:
+	std::string_view text;
+	std::string_view token;
+	std::string_view remainder;
+	Keyword keyword = Keyword::None;
+};
+
+// The token stream for one file, one entry per source line, plus the names used by its
+// include directives (in source order)
+class lexedFile
+{
+public:
+	std::vector<lexedLine> lines;
+	std::vector<std::string_view> includes;
+};
+
+// Lexes a whole include tree up front. Starting from the root file, a quick scan of each file's
+// bytes for include directives finds the whole tree on the calling thread, and every file is
+// lexed on the shared thread pool as soon as it is found, so even a chain of includes is lexed
+// concurrently. pass0 then walks the finished token streams in include order.
+class lexer
+{
+public:
+	explicit lexer(includeCache& includes) : _includes(includes) {}
+	~lexer();
+
+	void prefetch(int rootFile);
+
+	// The lexed form of a file -- waits for it if it is still in flight, or lexes it right
+	// away if it was never scheduled
+	const lexedFile& get(int id);
+
+	// Drop the token stream of a file that changed on disk (before its mapping goes away),
+	// then lex a set of such files again in parallel
+	void invalidate(int id);
+	void relex(const std::vector<int>& ids);
+
+	static lexedFile lex(const sourceFile& file);
+
+	// The include names of a file (in source order), the same ones lex() finds
+	static std::vector<std::string_view> scanIncludes(const sourceFile& file);
+
+private:
+	void schedule(int id);
+
+private:
+	includeCache& _includes;
+	std::vector<std::future<lexedFile>> _pending;
+	std::vector<std::unique_ptr<lexedFile>> _lexed;
+};
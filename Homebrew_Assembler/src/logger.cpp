@@ -0,0 +1,208 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Single producer (the owning thread), single consumer (whoever holds the drain mutex). head and
+// tail only ever grow; a message is published by moving head past all of it.
+class logger::ring
+{
+public:
+	static constexpr size_t SIZE = 64 * 1024;
+
+	char data[SIZE];
+	std::atomic<size_t> head{ 0 };
+	std::atomic<size_t> tail{ 0 };
+
+	size_t space() const { return SIZE - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire)); }
+};
+
+// Registers a ring for the thread on first use, and hands it back when the thread exits
+class logger::ringOwner
+{
+public:
+	ring* r = nullptr;
+
+	~ringOwner()
+	{
+		if (r != nullptr)
+			logger::instance().release(r);
+	}
+};
+
+// the formatting buffer of a thread (see logLine)
+class lineBuffer : public std::streambuf
+{
+public:
+	std::string text;
+	std::ostream stream{ this };
+
+protected:
+	int_type overflow(int_type c) override
+	{
+		if (c != traits_type::eof())
+			text.push_back(static_cast<char>(c));
+
+		return c;
+	}
+
+	std::streamsize xsputn(const char* s, std::streamsize n) override
+	{
+		text.append(s, static_cast<size_t>(n));
+		return n;
+	}
+};
+
+static thread_local lineBuffer t_line;
+
+logLine::logLine()
+	:
+	_stream(t_line.stream)
+{
+	// every message starts from the default stream state
+	t_line.text.clear();
+	_stream.flags(std::ios_base::dec | std::ios_base::skipws);
+	_stream.fill(' ');
+	_stream.width(0);
+}
+
+logLine::~logLine()
+{
+	logger::instance().submit(t_line.text.data(), t_line.text.size());
+}
+
+logger& logger::instance()
+{
+	static logger* _instance = new logger();
+	return *_instance;
+}
+
+logger::logger()
+{
+	_thread = std::thread(&logger::run, this);
+	std::atexit([]() { logger::instance().shutdown(); });
+}
+
+logger::ring& logger::threadRing()
+{
+	static thread_local ringOwner owner;
+	if (owner.r == nullptr)
+	{
+		owner.r = new ring();
+
+		std::lock_guard<std::mutex> lock(_ringsMutex);
+		_rings.push_back(owner.r);
+	}
+
+	return *owner.r;
+}
+
+void logger::release(ring* r)
+{
+	flush();
+
+	{
+		std::lock_guard<std::mutex> lock(_ringsMutex);
+		_rings.erase(std::remove(_rings.begin(), _rings.end(), r), _rings.end());
+	}
+
+	delete r;
+}
+
+void logger::submit(const char* text, size_t n)
+{
+	if (n == 0)
+		return;
+
+	ring& r = threadRing();
+
+	// too big for any ring -- write it out directly, after everything queued before it
+	if (n > ring::SIZE / 2)
+	{
+		std::lock_guard<std::mutex> lock(_drainMutex);
+		drain();
+		std::cout.write(text, n);
+		std::cout.flush();
+		return;
+	}
+
+	// a full ring is emptied by the producer itself rather than waiting on the background thread
+	if (r.space() < n)
+		flush();
+
+	const size_t head = r.head.load(std::memory_order_relaxed);
+	const size_t at = head % ring::SIZE;
+	const size_t first = std::min(n, ring::SIZE - at);
+
+	memcpy(r.data + at, text, first);
+	memcpy(r.data, text + first, n - first);
+	r.head.store(head + n, std::memory_order_release);
+
+	// one wake-up per batch -- the flag stays set until the background thread gets to it
+	if (!_pending.exchange(true, std::memory_order_acq_rel))
+	{
+		std::lock_guard<std::mutex> lock(_wakeMutex);
+		_wake.notify_one();
+	}
+}
+
+void logger::drain()
+{
+	std::lock_guard<std::mutex> lock(_ringsMutex);
+
+	for (ring* r : _rings)
+	{
+		const size_t tail = r->tail.load(std::memory_order_relaxed);
+		const size_t head = r->head.load(std::memory_order_acquire);
+		if (head == tail)
+			continue;
+
+		const size_t at = tail % ring::SIZE;
+		const size_t n = head - tail;
+		const size_t first = std::min(n, ring::SIZE - at);
+
+		std::cout.write(r->data + at, first);
+		std::cout.write(r->data, n - first);
+		r->tail.store(head, std::memory_order_release);
+	}
+}
+
+void logger::flush()
+{
+	std::lock_guard<std::mutex> lock(_drainMutex);
+	drain();
+	std::cout.flush();
+}
+
+void logger::run()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_wakeMutex);
+			_wake.wait(lock, [this]() { return _stopping || _pending.load(std::memory_order_acquire); });
+
+			if (_stopping)
+				return;
+		}
+
+		_pending.store(false, std::memory_order_release);
+		flush();
+	}
+}
+
+void logger::shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(_wakeMutex);
+		_stopping = true;
+	}
+
+	_wake.notify_one();
+	if (_thread.joinable())
+		_thread.join();
+
+	flush();
+}
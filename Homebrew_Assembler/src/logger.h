@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Build option -- defining HBA_LOG_VERBOSE as 0 compiles the verbose levels (source lines, parse
+// details and rom dumps) out of the assembler completely
+#ifndef HBA_LOG_VERBOSE
+#define HBA_LOG_VERBOSE 1
+#endif
+
+// Message levels, numbered by their bit in the echo mask (see assembler::setEcho)
+enum class LogLevel : uint8_t
+{
+	RomData = 0,
+	Source = 1,
+	ParsedMinor = 2,
+	ParsedMajor = 3,
+	Warnings = 4,
+	MinorTasks = 5,
+	MajorTasks = 6,
+	Architecture = 7,
+	Status = 8      // always shown (watch mode, fatal errors)
+};
+
+constexpr bool logCompiled(LogLevel level)
+{
+	return HBA_LOG_VERBOSE || !(level == LogLevel::RomData || level == LogLevel::Source || level == LogLevel::ParsedMinor || level == LogLevel::ParsedMajor);
+}
+
+// The console output of the whole process. Every thread formats its messages into a ring buffer
+// of its own, and a background thread drains the rings to std::cout in large writes, so logging
+// never waits on the console. Messages from one thread keep their order.
+class logger
+{
+public:
+	// never destroyed -- the rings are flushed when the process exits
+	static logger& instance();
+
+	// the cheap check made before anything is formatted
+	static bool enabled(LogLevel level) { return (_levels.load(std::memory_order_relaxed) >> static_cast<int>(level)) & 1; }
+	static void setLevels(unsigned levels) { _levels.store(levels | (1u << static_cast<int>(LogLevel::Status)), std::memory_order_relaxed); }
+
+	// Appends one complete message to the calling thread's ring
+	void submit(const char* text, size_t n);
+
+	// Returns once everything submitted so far (by any thread) is on the console
+	void flush();
+
+	logger(const logger&) = delete;
+	logger& operator=(const logger&) = delete;
+
+private:
+	class ring;
+	class ringOwner;
+
+	logger();
+
+	ring& threadRing();
+	void release(ring* r);
+	void drain();
+	void run();
+	void shutdown();
+
+	inline static std::atomic<unsigned> _levels{ 1u << static_cast<int>(LogLevel::Status) };
+
+	std::mutex _ringsMutex;
+	std::vector<ring*> _rings;
+
+	// held by whoever empties the rings, the background thread or a flush
+	std::mutex _drainMutex;
+
+	std::mutex _wakeMutex;
+	std::condition_variable _wake;
+	std::atomic<bool> _pending{ false };
+	bool _stopping = false;
+	std::thread _thread;
+};
+
+inline bool logEnabled(LogLevel level) { return logCompiled(level) && logger::enabled(level); }
+
+// One message. It is formatted into a buffer kept by the thread and submitted as a whole when the
+// object goes out of scope; one message per thread can be under construction at a time.
+class logLine
+{
+public:
+	logLine();
+	~logLine();
+
+	logLine(const logLine&) = delete;
+	logLine& operator=(const logLine&) = delete;
+
+	template <class t>
+	logLine& operator<<(const t& value)
+	{
+		_stream << value;
+		return *this;
+	}
+
+	logLine& operator<<(std::ostream& (*manipulator)(std::ostream&))
+	{
+		_stream << manipulator;
+		return *this;
+	}
+
+	logLine& operator<<(std::ios_base& (*manipulator)(std::ios_base&))
+	{
+		_stream << manipulator;
+		return *this;
+	}
+
+	std::ostream& stream() { return _stream; }
+
+private:
+	std::ostream& _stream;
+};
+
+// LOG(level) << ...; -- nothing after LOG is evaluated unless the level is enabled, and levels
+// that are compiled out leave no code behind. It is one whole statement (a loop that runs at
+// most once), so it can not take the else of an if around it.
+#define LOG(level) for (bool logOn_ = logEnabled(level); logOn_; logOn_ = false) logLine()
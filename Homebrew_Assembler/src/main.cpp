@@ -1,7 +1,41 @@
 #include "assembler.h"
+#include "batch.h"
+#include "simulator.h"
+#include "watch.h"
 
-#include <iostream>
+#include <cerrno>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
 #include <conio.h>
+#endif
+
+// Parses the --log mask, in decimal or (with 0x) in hex
+static bool parseLogMask(const char* text, int& mask)
+{
+	char* end = nullptr;
+	const unsigned long value = std::strtoul(text, &end, 0);
+	if (end == text || *end != '\0' || value > 0xFF)
+		return false;
+
+	mask = static_cast<int>(value);
+	return true;
+}
+
+// Parses the --max-cycles count, a whole number that fits 64 bits
+static bool parseCycleCount(const char* text, uint64_t& cycles)
+{
+	char* end = nullptr;
+	errno = 0;
+	const unsigned long long value = std::strtoull(text, &end, 10);
+	if (end == text || *end != '\0' || errno == ERANGE || text[0] == '-')
+		return false;
+
+	cycles = value;
+	return true;
+}
 
 int main(int argc, char* argv[])
 {
@@ -10,18 +44,180 @@ int main(int argc, char* argv[])
 	// like assembled. It is implied that file.s either contains all the architecture
 	// definitions needed to define your homebrew cpu or includes the appropriate
 	// architecture file with those definitions.
-	if (argc < 2)
+	//
+	// Additional include search directories can be given with -I <dir> (or -I<dir>).
+	// With -w (or --watch) the assembler stays running and reassembles on every change.
+	// Architecture files are cached as precompiled images unless --no-arch-image is given.
+	// --rom-format <list> picks the rom output formats (bin, hex, logisim, verilog or all).
+	// -O (or --optimize) runs the peephole optimizer over the program code.
+	// --decoder-report shows how much of the decoder rom is repeated, and what smaller roms would fit.
+	// --pack-controls searches for a narrower layout of the control lines, and --pack-controls-to
+	// <file> also writes the repacked control section to that file.
+	// --cycles shows the static cycle counts of every instruction, block and label.
+	// --simulate runs the assembled program rom on the architecture afterwards, for at most
+	// --max-cycles <n> cycles (100 million by default), and shows the cycle counts.
+	// --log <mask> sets what is shown (the echo bits below, 0x10 by default: warnings and the
+	// status lines), -v (or --verbose) shows everything. The reports above also turn on the
+	// major tasks, unless --log is given.
+	//
+	// With --batch <file.arch> every other file on the command-line is a program, and they are
+	// all assembled at the same time against that one architecture (read only once). Only
+	// warnings and a summary are shown (unless --log is given), and the exit code is 1 if any
+	// program failed.
+	std::string inputFile;
+	std::vector<std::string> batchFiles;
+	std::string batchArch;
+	std::vector<std::string> includePaths;
+	bool watch = false;
+	bool archImages = true;
+	bool optimize = false;
+	bool cycles = false;
+	bool decoderReport = false;
+	bool packControls = false;
+	std::string packFile;
+	bool simulate = false;
+	uint64_t maxCycles = 100000000;
+	unsigned romFormats = RawFormat;
+	int echo = -1;
+	for (int i = 1; i < argc; i++)
 	{
-		std::cout << "Please specify an input file!" << std::endl;
+		std::string arg = argv[i];
+
+		if (arg == "-w" || arg == "--watch")
+		{
+			watch = true;
+		}
+		else if (arg == "--no-arch-image")
+		{
+			archImages = false;
+		}
+		else if (arg == "-O" || arg == "--optimize")
+		{
+			optimize = true;
+		}
+		else if (arg == "--cycles")
+		{
+			cycles = true;
+		}
+		else if (arg == "--decoder-report")
+		{
+			decoderReport = true;
+		}
+		else if (arg == "--pack-controls")
+		{
+			packControls = true;
+		}
+		else if (arg == "--pack-controls-to" && i + 1 < argc)
+		{
+			packControls = true;
+			packFile = argv[++i];
+		}
+		else if (arg == "--simulate")
+		{
+			simulate = true;
+		}
+		else if (arg == "--max-cycles" && i + 1 < argc)
+		{
+			if (!parseCycleCount(argv[++i], maxCycles))
+			{
+				LOG(LogLevel::Status) << "Invalid cycle count [" << argv[i] << "]!\n";
+				return 1;
+			}
+		}
+		else if (arg == "-v" || arg == "--verbose")
+		{
+			echo = 0xFF;
+		}
+		else if (arg == "--log" && i + 1 < argc)
+		{
+			if (!parseLogMask(argv[++i], echo))
+			{
+				LOG(LogLevel::Status) << "Invalid log mask [" << argv[i] << "]! (0 to 0xFF)\n";
+				return 1;
+			}
+		}
+		else if (arg == "--batch" && i + 1 < argc)
+		{
+			batchArch = argv[++i];
+		}
+		else if (arg == "--rom-format" && i + 1 < argc)
+		{
+			if (!parseRomFormats(argv[++i], romFormats))
+			{
+				LOG(LogLevel::Status) << "Unknown rom format list [" << argv[i] << "]!\n";
+				return 1;
+			}
+		}
+		else if (arg.rfind("-I", 0) == 0)
+		{
+			if (arg.size() > 2)
+				includePaths.push_back(arg.substr(2));
+			else if (i + 1 < argc)
+				includePaths.push_back(argv[++i]);
+		}
+		else
+		{
+			if (inputFile.empty())
+				inputFile = arg;
+
+			batchFiles.push_back(arg);
+		}
+	}
+
+	if (!batchArch.empty())
+	{
+		int failed = 0;
+
+		try
+		{
+			logger::setLevels(echo < 0 ? 0x10 : static_cast<unsigned char>(echo));
+
+			batchAssembler batch(batchArch);
+			for (const std::string& path : includePaths)
+				batch.addIncludePath(path);
+
+			batch.setArchImages(archImages);
+			batch.setRomFormats(romFormats);
+			batch.setOptimize(optimize);
+
+			std::vector<batchResult> results = batch.run(batchFiles);
+			batch.summary(results);
+
+			for (const batchResult& r : results)
+				failed += r.ok ? 0 : 1;
+		}
+		catch (const std::exception& e)
+		{
+			LOG(LogLevel::Status) << "Fatal error: " << e.what() << "\n";
+			failed = 1;
+		}
+
+		logger::instance().flush();
+		return failed > 0 ? 1 : 0;
+	}
+
+	if (inputFile.empty())
+	{
+		LOG(LogLevel::Status) << "Please specify an input file!\n";
 	}
 	else
 	{
 		// try-catch any fatal errors
 		try
 		{
-			assembler assembler(argv[1]);
+			assembler assembler(inputFile);
+
+			for (const std::string& path : includePaths)
+				assembler.addIncludePath(path);
+
+			assembler.setArchImages(archImages);
+			assembler.setRomFormats(romFormats);
+			assembler.setOptimize(optimize);
+			assembler.setCycleAnalysis(cycles);
+			assembler.setDecoderReport(decoderReport);
+			assembler.setControlPacking(packControls, packFile);
 		
-			// set the echo verbosity - 8 bit value
+			// set the echo verbosity - 8 bit value (--log, or -v for all of it)
 			//  -> bit 7 : echo architecture file definitions
 			//  -> bit 6 : echo major tasks
 			//  -> bit 5 : echo minor tasks
@@ -30,18 +226,49 @@ int main(int argc, char* argv[])
 			//  -> bit 2 : echo minor parsing information
 			//  -> bit 1 : echo source code
 			//  -> bit 0 : echo rom contents
-			assembler.setEcho(0xFF);
+			if (echo < 0)
+				echo = cycles || decoderReport || packControls ? 0x50 : 0x10;
+
+			assembler.setEcho(static_cast<unsigned char>(echo));
 
-			assembler.assemble();
+			if (watch)
+			{
+				// errors do not end watch mode, the next change gets another try
+				try
+				{
+					assembler.assemble();
+				}
+				catch (const std::exception& e)
+				{
+					LOG(LogLevel::Status) << "Fatal error: " << e.what() << "\n";
+				}
+
+				watcher(assembler).run();
+			}
+			else
+			{
+				assembler.assemble();
+
+				if (simulate)
+				{
+					simulator sim(*assembler.getArchitecture(), assembler.getProgramRom());
+					sim.summary(sim.run(maxCycles));
+				}
+			}
 		}
 		catch (const std::exception& e)
 		{
-			std::cout << "Fatal error: " << e.what() << std::endl;
+			LOG(LogLevel::Status) << "Fatal error: " << e.what() << "\n";
 		}
 	}
 
-	// wait for a keypress
+	// everything logged is on the console before waiting for a keypress
+	logger::instance().flush();
+
+	// wait for a keypress (the console window closes with the assembler on Windows)
+#ifdef _WIN32
 	while (!_kbhit());
+#endif
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "matcher.h"
+#include "util.h"
+#include "parser.h"
+
+instructionMatcher::instructionMatcher(std::pmr::memory_resource* resource)
+	:
+	_resource(resource),
+	_nodes(resource),
+	_mnemonics(resource),
+	_roots(resource),
+	_registers(resource)
+{}
+
+void instructionMatcher::clear()
+{
+	resetVector(_nodes, _resource);
+	resetVector(_roots, _resource);
+	_mnemonics.clear();
+	_registers.clear();
+}
+
+void instructionMatcher::addOpcode(opcode& oc, int value, bool alias)
+{
+	const int mnemonic = _mnemonics.intern(oc.mnemonic());
+	if (mnemonic == static_cast<int>(_roots.size()))
+	{
+		_roots.push_back(static_cast<int>(_nodes.size()));
+		_nodes.emplace_back();
+	}
+
+	int current = _roots[mnemonic];
+	for (int i = 0; i < oc.numArgs(); i++)
+	{
+		const opcode::arg arg = oc.getArg(i);
+
+		uint32_t key = 0;
+		switch (arg._type)
+		{
+		case ArgType::Register:
+			key = edgeKey(OperandClass::Register, _registers.intern(arg._string));
+			break;
+
+		case ArgType::DerefReg:
+			// saved as [name]
+			key = edgeKey(OperandClass::DerefReg, _registers.intern(std::string_view(arg._string).substr(1, arg._string.size() - 2)));
+			break;
+
+		case ArgType::Numeral:
+			key = edgeKey(OperandClass::Numeral);
+			break;
+
+		case ArgType::DerefNum:
+			key = edgeKey(OperandClass::DerefNum);
+			break;
+
+		case ArgType::Ascii:
+			key = edgeKey(OperandClass::Ascii);
+			break;
+
+		case ArgType::DerefAscii:
+			key = edgeKey(OperandClass::DerefAscii);
+			break;
+
+		default:
+			continue;
+		}
+
+		int next = step(current, key);
+		if (next == -1)
+		{
+			next = static_cast<int>(_nodes.size());
+			_nodes.emplace_back();
+			_nodes[current].edges.push_back({ key, next });
+		}
+
+		current = next;
+	}
+
+	// the first definition of a form wins, like the old unique string lookups
+	if (alias)
+	{
+		if (_nodes[current].alias == -1)
+			_nodes[current].alias = value;
+	}
+	else if (_nodes[current].opcode == -1)
+	{
+		_nodes[current].opcode = value;
+	}
+}
+
+int instructionMatcher::step(int node, uint32_t key) const
+{
+	// only the few operand forms of one mnemonic leave a node, so a scan is fastest
+	for (const edge& e : _nodes[node].edges)
+	{
+		if (e.key == key)
+			return e.next;
+	}
+
+	return -1;
+}
+
+bool instructionMatcher::match(std::string_view mnemonic, std::string_view operands, instructionMatch& m) const
+{
+	const int root = _mnemonics.find(mnemonic);
+	if (root == stringPool::NONE)
+		return false;
+
+	int current = _roots[root];
+	m.numValues = 0;
+
+	while (current != -1)
+	{
+		auto token = parser::instance().extract_token_ws_comma(operands);
+		if (!token.has_value())
+			break;
+
+		std::string_view operand = token.value();
+		if (operand.empty())
+			continue;
+
+		const bool deref = parser::instance().try_strip_indirect(operand);
+
+		const int reg = _registers.find(operand);
+		if (reg != stringPool::NONE)
+		{
+			current = step(current, edgeKey(deref ? OperandClass::DerefReg : OperandClass::Register, reg));
+			continue;
+		}
+
+		if (m.numValues == instructionMatch::MAX_OPERANDS)
+			return false;
+
+		if (!operand.empty() && operand.front() == '#')
+			operand.remove_prefix(1);
+
+		m.values[m.numValues++] = operand;
+
+		// a character is a value too, so use a # form if there is no ASCII one
+		const bool ascii = !operand.empty() && (operand.front() == '\'' || operand.front() == '"');
+		int next = -1;
+		if (ascii)
+			next = step(current, edgeKey(deref ? OperandClass::DerefAscii : OperandClass::Ascii));
+		if (next == -1)
+			next = step(current, edgeKey(deref ? OperandClass::DerefNum : OperandClass::Numeral));
+
+		current = next;
+	}
+
+	if (current == -1)
+		return false;
+
+	const node& n = _nodes[current];
+	if (n.opcode == -1 && n.alias == -1)
+		return false;
+
+	m.alias = n.opcode == -1;
+	m.value = m.alias ? n.alias : n.opcode;
+	return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "intern.h"
+#include "opcode.h"
+
+#include <cstdint>
+#include <string_view>
+#include <memory_resource>
+#include <vector>
+
+// Operand classes as they appear in instruction forms -- a register name, a value (#), an
+// ASCII character, or any of those between the indirect keys
+enum class OperandClass : uint8_t { Register, Numeral, Ascii, DerefReg, DerefNum, DerefAscii };
+
+// The result of matching an instruction line: the opcode it encodes to, and the text of each
+// operand that supplies a value (registers are part of the opcode itself)
+class instructionMatch
+{
+public:
+	static constexpr int MAX_OPERANDS = 4;
+
+	int value = -1;
+	bool alias = false;
+	int numValues = 0;
+	std::string_view values[MAX_OPERANDS];
+};
+
+// Maps tokenized instruction lines to opcodes. Built once after the architecture is loaded as a
+// trie: the mnemonic selects a root node, and each operand's class (plus the register, for
+// register operands) selects the edge to the next node. Matching a line walks one edge per
+// operand and never builds any strings, so its cost does not grow with the size of the ISA.
+class instructionMatcher
+{
+public:
+	explicit instructionMatcher(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	// Forgets every opcode and returns all storage to the memory resource
+	void clear();
+	void addOpcode(opcode& oc, int value, bool alias);
+
+	bool isMnemonic(std::string_view mnemonic) const { return _mnemonics.find(mnemonic) != stringPool::NONE; }
+
+	// operands is the rest of the line after the mnemonic (comma and/or whitespace separated)
+	bool match(std::string_view mnemonic, std::string_view operands, instructionMatch& m) const;
+
+private:
+	static uint32_t edgeKey(OperandClass c, int reg = 0) { return (static_cast<uint32_t>(c) << 24) | static_cast<uint32_t>(reg); }
+	int step(int node, uint32_t key) const;
+
+private:
+	class edge
+	{
+	public:
+		uint32_t key;
+		int next;
+	};
+
+	class node
+	{
+	public:
+		using allocator_type = sessionAllocator;
+
+		node(allocator_type alloc = {}) : edges(alloc) {}
+		node(const node& other, allocator_type alloc = {}) : edges(other.edges, alloc), opcode(other.opcode), alias(other.alias) {}
+		node(node&& other, allocator_type alloc) : edges(std::move(other.edges), alloc), opcode(other.opcode), alias(other.alias) {}
+		node(node&& other) = default;
+		node& operator=(const node& other) = default;
+		node& operator=(node&& other) = default;
+
+		std::pmr::vector<edge> edges;
+		int opcode = -1;
+		int alias = -1;
+	};
+
+	std::pmr::memory_resource* _resource;
+	std::pmr::vector<node> _nodes;
+	stringPool _mnemonics;	// id = index into _roots
+	std::pmr::vector<int> _roots;
+	stringPool _registers;
+};
@@ -0,0 +1,120 @@
+#include "microcode.h"
+#include "util.h"
+
+bool flagCondition::parse(std::string_view text, int nFlags, flagCondition& c)
+{
+	if (text.empty() || static_cast<int>(text.size()) > nFlags)
+		return false;
+
+	c = flagCondition();
+
+	// the last character is flag 0
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		const uint32_t bit = 1u << (text.size() - 1 - i);
+
+		switch (text[i])
+		{
+		case 'x':
+		case 'X':
+			break;
+
+		case '1':
+			c.value |= bit;
+			[[fallthrough]];
+
+		case '0':
+			c.mask |= bit;
+			break;
+
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::string flagCondition::str(int nFlags) const
+{
+	std::string s(nFlags, 'x');
+	for (int i = 0; i < nFlags; i++)
+	{
+		const uint32_t bit = 1u << (nFlags - 1 - i);
+		if (mask & bit)
+			s[i] = (value & bit) ? '1' : '0';
+	}
+
+	return s;
+}
+
+microcodeStore::microcodeStore(std::pmr::memory_resource* resource)
+	:
+	_resource(resource),
+	_opcodeFirst(resource),
+	_opcodeCycles(resource),
+	_cycleFirst(resource),
+	_cycleBranches(resource),
+	_patterns(resource),
+	_masks(resource),
+	_values(resource),
+	_types(resource)
+{}
+
+void microcodeStore::clear()
+{
+	resetVector(_opcodeFirst, _resource);
+	resetVector(_opcodeCycles, _resource);
+	resetVector(_cycleFirst, _resource);
+	resetVector(_cycleBranches, _resource);
+	resetVector(_patterns, _resource);
+	resetVector(_masks, _resource);
+	resetVector(_values, _resource);
+	resetVector(_types, _resource);
+
+	_current = -1;
+	_maxCycles = 0;
+}
+
+void microcodeStore::beginOpcode(int value)
+{
+	if (value >= limit())
+	{
+		_opcodeFirst.resize(value + 1, 0);
+		_opcodeCycles.resize(value + 1, 0);
+	}
+
+	// a redefined opcode starts over (its old cycles are left unused)
+	_current = value;
+	_opcodeFirst[value] = static_cast<int>(_cycleFirst.size());
+	_opcodeCycles[value] = 0;
+}
+
+void microcodeStore::addCycle(const microBranch& b)
+{
+	_cycleFirst.push_back(static_cast<int>(_patterns.size()));
+	_cycleBranches.push_back(0);
+
+	if (++_opcodeCycles[_current] > _maxCycles)
+		_maxCycles = _opcodeCycles[_current];
+
+	addBranch(b);
+}
+
+void microcodeStore::addBranch(const microBranch& b)
+{
+	_patterns.push_back(b.pattern);
+	_masks.push_back(b.when.mask);
+	_values.push_back(b.when.value);
+	_types.push_back(b.type);
+
+	_cycleBranches.back()++;
+}
+
+int microcodeStore::lastCycle() const
+{
+	if (_current < 0 || _opcodeCycles[_current] == 0)
+		return -1;
+
+	return _opcodeFirst[_current] + _opcodeCycles[_current] - 1;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class PatternType : uint8_t { None, Seq, Seq_If, Seq_Elif, Seq_Else };
+
+// A condition on the flag state -- holds for every state s with (s & mask) == value, so an
+// empty mask holds for every state
+class flagCondition
+{
+public:
+	uint32_t mask = 0;
+	uint32_t value = 0;
+
+	bool holds(uint32_t state) const { return (state & mask) == value; }
+
+	// One character per flag, the last flag first -- 'x' for any, '0' or '1' (e.g. xxxx1)
+	static bool parse(std::string_view text, int nFlags, flagCondition& c);
+	std::string str(int nFlags) const;
+};
+
+// One branch of a cycle, as written by seq, seq_if, seq_elif or seq_else
+class microBranch
+{
+public:
+	uint32_t pattern = 0;
+	flagCondition when;
+	PatternType type = PatternType::Seq;
+};
+
+// The control sequences of every opcode, kept in flat arrays:
+//  - per opcode value, the first cycle and the number of cycles
+//  - the cycles of an opcode back to back, each with its first branch and number of branches
+//  - the branches as a structure of arrays (pattern, mask, value, type) in the order written
+// A cycle takes the first of its branches that holds for the current flag state (so a seq_else,
+// which always holds, takes whatever the branches before it did not). The seq lines of an opcode
+// follow it, so appending keeps the cycles of every opcode contiguous.
+class microcodeStore
+{
+public:
+	explicit microcodeStore(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	// Forgets every opcode and returns all storage to the memory resource
+	void clear();
+
+	// The following cycles belong to this opcode
+	void beginOpcode(int value);
+	int currentOpcode() const { return _current; }
+
+	// Adds a cycle (with its first branch) to the current opcode, or another branch to its last cycle
+	void addCycle(const microBranch& b);
+	void addBranch(const microBranch& b);
+
+	// The last cycle of the current opcode, or -1 if it has none
+	int lastCycle() const;
+
+	// Opcode values are 0 .. limit()-1
+	int limit() const { return static_cast<int>(_opcodeCycles.size()); }
+	int numCycles(int value) const { return value >= 0 && value < limit() ? _opcodeCycles[value] : 0; }
+	int firstCycle(int value) const { return _opcodeFirst[value]; }
+	int maxCycles() const { return _maxCycles; }
+
+	int numBranches(int cycle) const { return _cycleBranches[cycle]; }
+	int firstBranch(int cycle) const { return _cycleFirst[cycle]; }
+
+	uint32_t pattern(int branch) const { return _patterns[branch]; }
+	flagCondition condition(int branch) const { return { _masks[branch], _values[branch] }; }
+	PatternType type(int branch) const { return _types[branch]; }
+
+	// The control word of a cycle for one flag state (0 if no branch takes it)
+	uint32_t word(int cycle, uint32_t flags) const
+	{
+		const int last = _cycleFirst[cycle] + _cycleBranches[cycle];
+		for (int b = _cycleFirst[cycle]; b < last; b++)
+		{
+			if ((flags & _masks[b]) == _values[b])
+				return _patterns[b];
+		}
+
+		return 0;
+	}
+
+	// true if the cycle is a single branch that holds for every flag state
+	bool unconditional(int cycle) const { return _cycleBranches[cycle] == 1 && _masks[_cycleFirst[cycle]] == 0; }
+
+private:
+	std::pmr::memory_resource* _resource;
+	int _current = -1;
+	int _maxCycles = 0;
+
+	// indexed by opcode value
+	std::pmr::vector<int> _opcodeFirst;
+	std::pmr::vector<int> _opcodeCycles;
+
+	// indexed by cycle
+	std::pmr::vector<int> _cycleFirst;
+	std::pmr::vector<int> _cycleBranches;
+
+	// indexed by branch
+	std::pmr::vector<uint32_t> _patterns;
+	std::pmr::vector<uint32_t> _masks;
+	std::pmr::vector<uint32_t> _values;
+	std::pmr::vector<PatternType> _types;
+};
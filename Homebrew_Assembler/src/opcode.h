@@ -1,26 +1,16 @@
 #pragma once
 
 #include <iostream>
+#include <memory_resource>
 #include <vector>
 #include <string>
 
 enum class ArgType { None, Register, Numeral, Ascii, DerefReg, DerefNum, DerefAscii };
-enum class PatternType { None, Seq, Seq_If, Seq_Else };
 
-class controlPattern
-{
-public:
-	int pattern;
-	std::vector<int> flags;
-	PatternType type;
-};
-
-class controlPatterns
-{
-public:
-	controlPattern cpattern[2];
-	int count;
-};
+// Opcodes are allocator-aware, so when they are stored in containers that use the assembler's
+// session arena, their own vectors are allocated from the arena too. Their control sequences
+// are kept apart, in the assembler's microcode store (see microcode.h).
+using sessionAllocator = std::pmr::polymorphic_allocator<std::byte>;
 
 class opcode
 {
@@ -33,65 +23,46 @@ public:
 		std::string _string;
 	};
 
-	opcode()
+	using allocator_type = sessionAllocator;
+
+	opcode(allocator_type alloc = {})
+		:
+		_arguments(alloc)
 	{
 		_mnemonic = "";
 		_value = -1;
-		_controlPatterns.clear();
-		_arguments.clear();
 	}
 
-	void setMnemonic(const std::string& s) { _mnemonic = s; }
-	void setValue(const int& v) { _value = v; }
+	opcode(const opcode& other, allocator_type alloc = {})
+		:
+		_mnemonic(other._mnemonic),
+		_value(other._value),
+		_arguments(other._arguments, alloc)
+	{}
 
-	void addNewControlPattern(const controlPattern& p)
-	{
-		std::vector<int> flags;
-		for (int i = 0; i < p.flags.size(); i++)
-		{
-			flags.push_back(p.flags[i]);
-		}
+	opcode(opcode&& other, allocator_type alloc)
+		:
+		_mnemonic(std::move(other._mnemonic)),
+		_value(other._value),
+		_arguments(std::move(other._arguments), alloc)
+	{}
 
-		controlPatterns cp;
-		cp.count = 1;
-		cp.cpattern[0].pattern = p.pattern;
-		cp.cpattern[0].type = p.type;
-		cp.cpattern[0].flags = flags;
+	opcode(opcode&& other) = default;
+	opcode& operator=(const opcode& other) = default;
+	opcode& operator=(opcode&& other) = default;
 
-		_controlPatterns.push_back(cp);
-	}
-
-	void addToLastControlPattern(const controlPattern& p)
-	{
-		if (_controlPatterns.size() <= 0) return;
-
-		std::vector<int> flags;
-		for (int i = 0; i < p.flags.size(); i++)
-		{
-			flags.push_back(p.flags[i]);
-		}
-
-		controlPatterns cp = _controlPatterns[_controlPatterns.size() - 1];
-		cp.count++;
-		cp.cpattern[cp.count - 1].pattern = p.pattern;
-		cp.cpattern[cp.count - 1].type = p.type;
-		cp.cpattern[cp.count - 1].flags = flags;
-
-		_controlPatterns[_controlPatterns.size() - 1] = cp;
-	}
+	void setMnemonic(const std::string& s) { _mnemonic = s; }
+	void setValue(const int& v) { _value = v; }
 
 	void addArgument(arg a) { _arguments.push_back(a); }
 
-	std::string mnemonic() { return _mnemonic; }
+	std::string mnemonic() const { return _mnemonic; }
 	int value() { return _value; }
-	int numArgs() { return _arguments.size(); }
-	arg getArg(int i) { return _arguments[i]; }
-	int numCycles() { return _controlPatterns.size(); }
-	controlPatterns& getPatterns(int i) { return _controlPatterns[i]; }
-
-	controlPattern getPattern(int i, int j) { return _controlPatterns[i].cpattern[j]; }
+	int numArgs() const { return _arguments.size(); }
+	arg getArg(int i) const { return _arguments[i]; }
+	bool defined() const { return _value != -1; }
 
-	std::string getUniqueString()
+	std::string getUniqueString() const
 	{
 		std::string unique_str = _mnemonic + "_";
 
@@ -131,6 +102,5 @@ public:
 private:
 	std::string _mnemonic;
 	int _value;
-	std::vector<controlPatterns> _controlPatterns;
-	std::vector<arg> _arguments;
+	std::pmr::vector<arg> _arguments;
 };
\ No newline at end of file
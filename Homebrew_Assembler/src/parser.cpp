@@ -2,10 +2,12 @@
 #include "config.h"
 
 #include <algorithm>
+#include <charconv>
+#include <cstring>
 
 // symbols are sorta like commands...they cannot start with a digit and can contain any non-register alphanumeric or underscore
 // characters
-bool parser::is_command(const std::string& s)
+bool parser::is_command(std::string_view s)
 {
 	return s.size() > 0 &&
 		!isdigit(s.front()) &&
@@ -20,13 +22,13 @@ bool parser::is_command(const std::string& s)
 }
 
 // directives start with the DIRECTIVE_KEY (see symbolConfig.h), and are otherwise alphanumeric
-bool parser::is_directive(const std::string& s)
+bool parser::is_directive(std::string_view s)
 {
 	return s.size() > 1 && s.front() == DIRECTIVE_KEY && std::all_of(s.begin() + 1, s.end(), [](char c) { return isalnum(c); });
 }
 
 // labels can optionally contain any LABEL_DECORATORS and must end in the LABEL_END_KEY
-bool parser::is_label(const std::string& s)
+bool parser::is_label(std::string_view s)
 {
 	return s.size() > 1 && s.back() == LABEL_END_KEY && !isdigit(s.front()) &&
 		std::all_of(s.begin(), std::prev(s.end()), [](char c)
@@ -44,50 +46,50 @@ bool parser::is_label(const std::string& s)
 }
 
 // Indirect values start with INDIRECT_BEGIN_KEY and end with INDIRECT_END_KEY
-bool parser::is_indirect(const std::string& s)
+bool parser::is_indirect(std::string_view s)
 {
 	return s.size() > 1 && s.front() == INDIRECT_BEGIN_KEY && s.back() == INDIRECT_END_KEY;
 }
 
 // Addresses must start with the ADDRESS_KEY and the remaining characters must follow the rules
 // for a name (see below)
-bool parser::is_address(const std::string& s)
+bool parser::is_address(std::string_view s)
 {
 	return s.size() > 1 &&
 		s.front() == ADDRESS_KEY &&
-		is_command(s.substr(1, std::string::npos));
+		is_command(s.substr(1));
 }
 
 // erase any strings starting with the character specified by the COMMENT_KEY (see symbolConfig.h)
-void parser::strip_comment(std::string& s)
+void parser::strip_comment(std::string_view& s)
 {
 	// Find the position in the string corresponding to the COMMENT_KEY
 	size_t pos = s.find_first_of(COMMENT_KEY);
 
-	// If that position is not undefined, erase from that position until end of string
-	if (pos != std::string::npos)
+	// If that position is not undefined, drop everything from that position until end of string
+	if (pos != std::string_view::npos)
 	{
-		s.erase(pos);
+		s = s.substr(0, pos);
 	}
 }
 
-// Strip indirectly addressed values by only returning the characters between the INDIRECT_BEGIN_KEY and INDIRECT_END_KEY
-bool parser::try_strip_indirect(std::string & s)
+// Strip indirectly addressed values by only keeping the characters between the INDIRECT_BEGIN_KEY and INDIRECT_END_KEY
+bool parser::try_strip_indirect(std::string_view& s)
 {
 	if (is_indirect(s))
 	{
-		s = std::string(std::next(s.begin()), std::prev(s.end()));
+		s = s.substr(1, s.size() - 2);
 		return true;
 	}
 
 	return false;
 }
 
-bool parser::try_strip_label(std::string& s)
+bool parser::try_strip_label(std::string_view& s)
 {
 	if (is_label(s))
 	{
-		s = std::string(s.begin(), std::prev(s.end()));
+		s.remove_suffix(1);
 		return true;
 	}
 
@@ -95,26 +97,26 @@ bool parser::try_strip_label(std::string& s)
 }
 
 // Strip off the address key
-bool parser::try_strip_address(std::string& s)
+bool parser::try_strip_address(std::string_view& s)
 {
 	if (is_address(s))
 	{
-		s = std::string(std::next(s.begin()), s.end());
+		s.remove_prefix(1);
 		return true;
 	}
 
 	return false;
 }
 
-// Find and erase commas, return whether or not one is found
-bool parser::try_consume_comma(std::string& s)
+// Find and consume commas, return whether or not one is found
+bool parser::try_consume_comma(std::string_view& s)
 {
 	const auto ws = std::find_if(s.begin(), s.end(), [](char c) { return !isspace(c); });
 	if (ws != s.end())
 	{
 		if (*ws == ',')
 		{
-			s.erase(s.begin(), std::next(ws));
+			s.remove_prefix(std::distance(s.begin(), ws) + 1);
 			return true;
 		}
 	}
@@ -123,7 +125,7 @@ bool parser::try_consume_comma(std::string& s)
 }
 
 // Same idea as above, but for the equals sign
-bool parser::try_consume_equals(std::string& s)
+bool parser::try_consume_equals(std::string_view& s)
 {
 	const auto ws = std::find_if(s.begin(), s.end(), [](char c) { return !isspace(c); });
 
@@ -131,7 +133,7 @@ bool parser::try_consume_equals(std::string& s)
 	{
 		if (*ws == '=')
 		{
-			s.erase(s.begin(), std::next(ws));
+			s.remove_prefix(std::distance(s.begin(), ws) + 1);
 			return true;
 		}
 	}
@@ -141,9 +143,9 @@ bool parser::try_consume_equals(std::string& s)
 
 // One of the primary functions used in the parser...it will extract a "token", defined as a collection
 // of consecutive characters without any whitespace in-between (e.g., a space).
-std::optional<std::string> parser::extract_token_ws(std::string& s)
+std::optional<std::string_view> parser::extract_token_ws(std::string_view& s)
 {
-	// First, delete any whitespace occurring before non-ws characters
+	// First, skip any whitespace occurring before non-ws characters
 	trim_leading_ws(s);
 
 	// If there are actually characters in the string...
@@ -155,31 +157,23 @@ std::optional<std::string> parser::extract_token_ws(std::string& s)
 				return (isspace(c));
 			});
 
-		// If we found a space character, we will not be at the end of the string
-		if (delimiter != s.end())
-		{
-			// Build a string that only includes the characters up until that first
-			// space character found
-			std::string t = std::string(s.begin(), delimiter);
+		// The token is everything up until that first space character (or the end of the string)
+		const size_t length = std::distance(s.begin(), delimiter);
+		std::string_view t = s.substr(0, length);
 
-			// Delete the corresponding characters in the passed-in string reference
-			// so that further chaining of tokenization can be performed
-			s.erase(s.begin(), delimiter);
+		// Advance the passed-in view past the token so that further chaining of
+		// tokenization can be performed
+		s.remove_prefix(length);
 
-			// Return the string token
-			return t;
-		}
-		else
-		{
-			return std::move(s);
-		}
+		// Return the string token
+		return t;
 	}
 
 	return { };
 }
 
 // Similar idea to the function above, except it also includes commas as characters to parse out
-std::optional<std::string> parser::extract_token_ws_comma(std::string& s)
+std::optional<std::string_view> parser::extract_token_ws_comma(std::string_view& s)
 {
 	trim_leading_ws(s);
 
@@ -190,225 +184,217 @@ std::optional<std::string> parser::extract_token_ws_comma(std::string& s)
 				return (isspace(c) || c == ',');
 			});
 
-		if (delimiter != s.end())
-		{
-			std::string t = std::string(s.begin(), delimiter);
-			s.erase(s.begin(), delimiter + 1);
-			return t;
-		}
-		else
-		{
-			return std::move(s);
-		}
+		const size_t length = std::distance(s.begin(), delimiter);
+		std::string_view t = s.substr(0, length);
+
+		// also consume the delimiter itself
+		s.remove_prefix(delimiter != s.end() ? length + 1 : length);
+		return t;
 	}
 
 	return { };
 }
 
-// Used for parsing strings between double quotes
-std::optional<std::string> parser::extract_token_str(std::string& s)
+// Used for parsing strings between double quotes -- returns the characters inside the quotes
+// and leaves the view positioned just after the closing quote
+std::optional<std::string_view> parser::extract_token_str(std::string_view& s)
 {
-	int count = 0;
-	bool parsingString = true;
-	std::string parsedString = "";
-	while (parsingString && count < 10)
-	{
-		// Extract the string token
-		auto token = extract_token_ws(s);
-		std::string tokenString = token.has_value() ? std::string(token.value()) : "";
-		if (count == 0)
-		{
-			// Early exit if the string doesn't start with double quote
-			if (tokenString.front() != '"')
-			{
-				parsingString = false;
-
-				// Probably need an error message here!
+	trim_leading_ws(s);
 
-				break;
-			}
-			else
-			{
-				// Chop off open quote
-				tokenString = tokenString.substr(1, std::string::npos);
+	// Early exit if the string doesn't start with double quote
+	if (s.empty() || s.front() != '"')
+		return { };
 
-				// Make sure the end of the string closes with a double quote
-				if (!tokenString.empty() && tokenString.back() == '"' && tokenString.length() > 1)
-				{
-					// Chop off end quote
-					tokenString = tokenString.substr(0, tokenString.length() - 1);
-					parsedString += " " + tokenString;
-					s.erase(s.begin(), s.end());
+	// Make sure the string closes with a double quote
+	const size_t close = s.find('"', 1);
+	if (close == std::string_view::npos)
+		return { };
 
-					return parsedString;
-				}
-				else
-				{
-					parsedString += " " + tokenString;
-					s.erase(s.begin(), s.end());
-				}
-			}
-		}
-		else
-		{
-			if (!tokenString.empty() && tokenString.back() == '"' && tokenString.length() > 1)
-			{
-				// Chop off end quote
-				tokenString = tokenString.substr(0, tokenString.length() - 1);
-				parsedString += " " + tokenString;
-				s.erase(s.begin(), s.end());
-				return parsedString;
-			}
-			else
-			{
-				parsedString += " " + tokenString;
-				s.erase(s.begin(), s.end());
-			}
-		}
-
-		count++;
-	}
+	std::string_view t = s.substr(1, close - 1);
+	s.remove_prefix(close + 1);
+	trim_leading_ws(s);
 
-	return { };
+	return t;
 }
 
 // Trim off leading spaces
-void parser::trim_leading_ws(std::string& s)
+void parser::trim_leading_ws(std::string_view& s)
 {
-	s.erase(s.begin(), std::find_if(s.begin(), s.end(), [](char c) { return !isspace(c); }));
+	const auto first = std::find_if(s.begin(), s.end(), [](char c) { return !isspace(c); });
+	s.remove_prefix(std::distance(s.begin(), first));
 }
 
 // Trim off trailing spaces
-void parser::trim_trailing_ws(std::string& s)
+void parser::trim_trailing_ws(std::string_view& s)
 {
-	s.erase(std::find_if(s.rbegin(), s.rend(), [](char c) { return !isspace(c); }).base(), s.end());
+	const auto last = std::find_if(s.rbegin(), s.rend(), [](char c) { return !isspace(c); });
+	s.remove_suffix(std::distance(s.rbegin(), last));
 }
 
 // Trim off both leading and trailing spaces
-void parser::trim_ws(std::string& s)
+void parser::trim_ws(std::string_view& s)
 {
 	trim_leading_ws(s);
 	trim_trailing_ws(s);
 }
 
-// Return the modified string with leading spaces parsed out
-std::string parser::get_lead_trimmed(std::string s)
+// Return the view with leading spaces parsed out
+std::string_view parser::get_lead_trimmed(std::string_view s)
 {
 	trim_leading_ws(s);
 	return s;
 }
 
-// Return the modified string with trailing spaces parsed out
-std::string parser::get_trail_trimmed(std::string s)
+// Return the view with trailing spaces parsed out
+std::string_view parser::get_trail_trimmed(std::string_view s)
 {
 	trim_trailing_ws(s);
 	return s;
 }
 
-// Return the modified string with spaces parsed out on both sides
-std::string parser::get_trimmed(std::string s)
+// Return the view with spaces parsed out on both sides
+std::string_view parser::get_trimmed(std::string_view s)
 {
 	trim_ws(s);
 	return s;
 }
 
+// Whether c is a digit of the given literal type
+static bool is_digit_of(char c, LiteralNumType t)
+{
+	switch (t)
+	{
+	case LiteralNumType::Binary:
+		return c == '0' || c == '1';
+
+	case LiteralNumType::Decimal:
+		return c >= '0' && c <= '9';
+
+	case LiteralNumType::Hexadecimal:
+		return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+
+	default:
+		return false;
+	}
+}
+
 // Check the token string for the different literal number types supported in this assembler
-LiteralNumType parser::get_num_type(std::string& s)
+LiteralNumType parser::get_num_type(std::string_view& s)
 {
 	if (s.size() == 0)
 		return LiteralNumType::None;
 
-	// If the first character is not a number...
-	if (!isdigit(s[0]))
+	LiteralNumType t = LiteralNumType::None;
+
+	// Note that a key of ' ' is not in use (see config.h)
+	if (BIN_KEY != ' ' && s.front() == BIN_KEY)
+		t = LiteralNumType::Binary;
+	else if (DEC_KEY != ' ' && s.front() == DEC_KEY)
+		t = LiteralNumType::Decimal;
+	else if (HEX_KEY != ' ' && s.front() == HEX_KEY)
+		t = LiteralNumType::Hexadecimal;
+
+	if (t != LiteralNumType::None)
 	{
-		if (BIN_KEY != ' ' && s.front() == BIN_KEY)
-		{
-			// Matches non-empty BIN_KEY so is binary.
-			// Strip off the symbol for further processing.
-			s = std::string(s.begin() + 1, s.end());
-			return LiteralNumType::Binary;
-		}
-		else if (DEC_KEY != ' ' && s.front() == DEC_KEY)
-		{
-			// Matches non-empty DEC_KEY so is decimal.
-			// Strip off the symbol for futher processing.
-			s = std::string(s.begin() + 1, s.end());
-			return LiteralNumType::Decimal;
-		}
-		else if (HEX_KEY != ' ' && s.front() == HEX_KEY)
-		{
-			// Matches non-empty HEX_KEY so is hexadecimal.
-			// Strip off the symbol for futher processing.
-			s = std::string(s.begin() + 1, s.end());
-
-			// Also, handle formats like 0xhhhh, for example.
-			return std::all_of(std::next(s.begin(), 1), s.end(), [](char c) {
-				return isdigit(c) ||
-					(tolower(c) >= 'a' && tolower(c) <= 'f');
-				}) ? LiteralNumType::Hexadecimal : LiteralNumType::None;
-		}
-		else
-		{
-			// Otherwise, the type is undefined
-			return LiteralNumType::None;
-		}
+		// Strip off the symbol for further processing
+		s.remove_prefix(1);
 	}
-
-	// Handle formats like 0xnnn, 0bnnnn
-	if (s.size() > 3)
+	else if (s.size() > 2 && s[0] == '0' && !isdigit(s[1]))
 	{
-		if (tolower(s[1]) == 'x' || tolower(s[1]) == 'h')
+		// Handle formats like 0xnnn, 0hnnn, 0bnnnn and 0dnnn
+		switch (tolower(s[1]))
 		{
-			s = s.substr(2, std::string::npos);
+		case 'x':
+		case 'h':
+			t = LiteralNumType::Hexadecimal;
+			break;
 
-			return std::all_of(std::next(s.begin()), s.end(), [](char c) {
-				return isdigit(c) ||
-					(tolower(c) >= 'a' && tolower(c) <= 'f');
-				}) ? LiteralNumType::Hexadecimal : LiteralNumType::None;
-		}
+		case 'b':
+			t = LiteralNumType::Binary;
+			break;
 
-		if (tolower(s[1]) == 'b')
-		{
-			s = s.substr(2, std::string::npos);
-			return std::all_of(std::next(s.begin()), s.end(), [](char c) { return c == '0' || c == '1'; }) ? LiteralNumType::Binary : LiteralNumType::None;
-		}
+		case 'd':
+			t = LiteralNumType::Decimal;
+			break;
 
-		if (tolower(s[1]) == 'd')
-		{
-			s = s.substr(2, std::string::npos);
-			return std::all_of(std::next(s.begin()), s.end(), [](char c) { return isdigit(c); }) ? LiteralNumType::Decimal : LiteralNumType::None;
+		default:
+			return LiteralNumType::None;
 		}
+
+		s.remove_prefix(2);
+	}
+	else if (isdigit(s[0]))
+	{
+		t = LiteralNumType::Decimal;
 	}
 
-	// WHY is std::next required here???
-	return std::all_of(std::next(s.begin()), s.end(), [](char c) { return isdigit(c); }) ? LiteralNumType::Decimal : LiteralNumType::None;
+	if (s.empty() || !std::all_of(s.begin(), s.end(), [t](char c) { return is_digit_of(c, t); }))
+		return LiteralNumType::None;
+
+	return t;
 }
 
-// Parse the number when the number type is known using the appropriate number base in the stoi function
-int parser::parse_literal_num(std::string& s, LiteralNumType t)
+// Parse the digits when the number type is known, using the matching base
+LiteralStatus parser::parse_literal(std::string_view digits, LiteralNumType t, uint64_t& value)
 {
+	int base = 10;
 	switch (t)
 	{
 	case LiteralNumType::Binary:
-		return std::stoi(s, 0, 2);
+		base = 2;
 		break;
 
 	case LiteralNumType::Decimal:
-		return std::stoi(s);
+		base = 10;
 		break;
 
 	case LiteralNumType::Hexadecimal:
-		return std::stoi(s, 0, 16);
+		base = 16;
 		break;
 
 	default:
-		//assert("bad int literal parse type!" && false);
-		return -1;
+		return LiteralStatus::NotANumber;
 	}
+
+	if (digits.empty())
+		return LiteralStatus::NotANumber;
+
+	const char* end = digits.data() + digits.size();
+	const std::from_chars_result result = std::from_chars(digits.data(), end, value, base);
+
+	if (result.ec == std::errc::result_out_of_range)
+		return LiteralStatus::Overflow;
+
+	if (result.ec != std::errc() || result.ptr != end)
+		return LiteralStatus::BadDigit;
+
+	return LiteralStatus::Ok;
 }
 
-// Wrapper function which also automatically calls the number type function
-int parser::parse_literal_num(std::string& s)
+// Wrapper function which also detects the number type first
+LiteralStatus parser::parse_literal(std::string_view s, uint64_t& value)
 {
-	return parse_literal_num(s, get_num_type(s));
-}
\ No newline at end of file
+	std::string_view digits = s;
+	LiteralNumType t = get_num_type(digits);
+	return parse_literal(digits, t, value);
+}
+
+const char* parser::literal_status_str(LiteralStatus s)
+{
+	switch (s)
+	{
+	case LiteralStatus::Ok:
+		return "Ok";
+
+	case LiteralStatus::NotANumber:
+		return "Not a number";
+
+	case LiteralStatus::BadDigit:
+		return "Bad digit in number";
+
+	case LiteralStatus::Overflow:
+		return "Number does not fit in 64 bits";
+	}
+
+	return "";
+}
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <optional>
 
 // Formats for literal number types
 enum class LiteralNumType { None, Binary, Decimal, Hexadecimal };
 
+// Outcome of parsing a literal number -- parsing never throws
+enum class LiteralStatus { Ok, NotANumber, BadDigit, Overflow };
+
+// All tokenizing functions work on std::string_view spans into the source text. Consuming
+// a token only moves the front of the view, so no characters are ever copied or erased.
 class parser
 {
 public:
@@ -15,35 +22,40 @@ public:
 		static parser _instance;
 		return _instance;
 	}
-	
-	bool is_command(const std::string& s);
-	bool is_directive(const std::string& s);
-	bool is_label(const std::string &s);
-	bool is_indirect(const std::string& s);
-	bool is_address(const std::string& s);
-	bool is_register(const std::string& s);
-
-	void strip_comment(std::string& s);
-
-	bool try_consume_comma(std::string& s);
-	bool try_consume_equals(std::string& s);
-	bool try_strip_indirect(std::string& s);
-	bool try_strip_label(std::string& s);
-	bool try_strip_address(std::string& s);
-
-	std::optional<std::string> extract_token_ws(std::string& s);
-	std::optional<std::string> extract_token_ws_comma(std::string& s);
-	std::optional<std::string> extract_token_str(std::string& s);
-
-	void trim_leading_ws(std::string& s);
-	void trim_trailing_ws(std::string& s);
-	void trim_ws(std::string& s);
-
-	std::string get_lead_trimmed(std::string s);
-	std::string get_trail_trimmed(std::string s);
-	std::string get_trimmed(std::string s);
-
-	LiteralNumType get_num_type(std::string& s);
-	int parse_literal_num(std::string& s, LiteralNumType t);
-	int parse_literal_num(std::string& s);
-};
\ No newline at end of file
+
+	bool is_command(std::string_view s);
+	bool is_directive(std::string_view s);
+	bool is_label(std::string_view s);
+	bool is_indirect(std::string_view s);
+	bool is_address(std::string_view s);
+	bool is_register(std::string_view s);
+
+	void strip_comment(std::string_view& s);
+
+	bool try_consume_comma(std::string_view& s);
+	bool try_consume_equals(std::string_view& s);
+	bool try_strip_indirect(std::string_view& s);
+	bool try_strip_label(std::string_view& s);
+	bool try_strip_address(std::string_view& s);
+
+	std::optional<std::string_view> extract_token_ws(std::string_view& s);
+	std::optional<std::string_view> extract_token_ws_comma(std::string_view& s);
+	std::optional<std::string_view> extract_token_str(std::string_view& s);
+
+	void trim_leading_ws(std::string_view& s);
+	void trim_trailing_ws(std::string_view& s);
+	void trim_ws(std::string_view& s);
+
+	std::string_view get_lead_trimmed(std::string_view s);
+	std::string_view get_trail_trimmed(std::string_view s);
+	std::string_view get_trimmed(std::string_view s);
+
+	// Detects the number format from its prefix (the keys in config.h, or 0x/0h/0b/0d) and strips
+	// the prefix. Returns None unless every remaining character is a digit of that format.
+	LiteralNumType get_num_type(std::string_view& s);
+
+	// Parses literal numbers of up to 64 bits without allocating or throwing
+	LiteralStatus parse_literal(std::string_view digits, LiteralNumType t, uint64_t& value);
+	LiteralStatus parse_literal(std::string_view s, uint64_t& value);
+	static const char* literal_status_str(LiteralStatus s);
+};
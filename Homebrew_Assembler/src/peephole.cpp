@@ -0,0 +1,160 @@
+#include "peephole.h"
+#include "config.h"
+#include "parser.h"
+
+#include <string>
+
+int peepholeOptimizer::registerBits(std::string_view name) const
+{
+	const symbol* s = _arch.symbols.find(name);
+	return s != nullptr && s->getType() == SymbolType::Register ? s->getAddress() : 0;
+}
+
+void peepholeOptimizer::classify(windowInstruction& i, std::string_view mnemonic, std::string_view operands) const
+{
+	i.move = false;
+	if (mnemonic != MOVE_MNEMONIC)
+		return;
+
+	auto dst = parser::instance().extract_token_ws_comma(operands);
+	auto src = parser::instance().extract_token_ws_comma(operands);
+	parser::instance().trim_ws(operands);
+	if (!dst.has_value() || !src.has_value() || !operands.empty() || src.value().empty())
+		return;
+
+	// nothing that goes through memory
+	if (registerBits(dst.value()) == 0 || src.value().front() == INDIRECT_BEGIN_KEY)
+		return;
+
+	if (registerBits(src.value()) > 0)
+	{
+		i.src = src.value();
+	}
+	else if (i.match.numValues == 1)
+	{
+		i.src = std::string_view();
+	}
+	else
+	{
+		return;
+	}
+
+	i.dst = dst.value();
+	i.move = true;
+}
+
+bool peepholeOptimizer::makeMove(std::string_view dst, const windowInstruction& from, windowInstruction& out) const
+{
+	// a value only has to stand in for the operand class while matching
+	std::string operands = std::string(dst) + ", " + (from.src.empty() ? std::string("#0") : std::string(from.src));
+
+	instructionMatch m;
+	if (!_arch.matcher.match(MOVE_MNEMONIC, operands, m))
+		return false;
+
+	if (from.src.empty())
+	{
+		if (m.numValues != 1 || _arch.operandBytesOf(m, 0) != _arch.operandBytesOf(from.match, 0))
+			return false;
+
+		m.values[0] = from.match.values[0];
+	}
+
+	out.match = m;
+	out.move = true;
+	out.dst = dst;
+	out.src = from.src;
+	return true;
+}
+
+void peepholeOptimizer::optimize(std::vector<windowInstruction>& window)
+{
+	enum class Rewrite { None, DropFirst, DropSecond, Fold };
+
+	size_t i = 0;
+	while (i < window.size())
+	{
+		Rewrite best = Rewrite::None;
+		int saving = 0;
+		windowInstruction folded;
+
+		auto consider = [&](Rewrite r, int cyclesSaved)
+		{
+			if (cyclesSaved > saving)
+			{
+				best = r;
+				saving = cyclesSaved;
+			}
+		};
+
+		const windowInstruction& a = window[i];
+		if (a.move)
+		{
+			const int bits = registerBits(a.dst);
+			auto sameWidth = [&](const windowInstruction& m) { return registerBits(m.dst) == bits && (m.src.empty() || registerBits(m.src) == bits); };
+
+			// mov x, x
+			if (a.src == a.dst)
+				consider(Rewrite::DropFirst, cycles(a));
+
+			if (i + 1 < window.size() && window[i + 1].move && sameWidth(a) && sameWidth(window[i + 1]))
+			{
+				const windowInstruction& b = window[i + 1];
+
+				// the first write is overwritten before anything reads it
+				if (b.dst == a.dst && !reads(b, a.dst))
+					consider(Rewrite::DropFirst, cycles(a));
+
+				// the second one moves a value that is already there
+				if (!a.src.empty() && ((b.dst == a.src && b.src == a.dst) || (b.dst == a.dst && b.src == a.src)))
+					consider(Rewrite::DropSecond, cycles(b));
+
+				// a value passed through a register that is overwritten right after
+				if (i + 2 < window.size() && b.src == a.dst && b.dst != a.dst && b.dst != a.src)
+				{
+					const windowInstruction& c = window[i + 2];
+					windowInstruction candidate = b;
+					if (c.move && sameWidth(c) && c.dst == a.dst && !reads(c, a.dst) && makeMove(b.dst, a, candidate))
+					{
+						const int cyclesSaved = cycles(a) + cycles(b) - cycles(candidate);
+						if (cyclesSaved > saving)
+							folded = candidate;
+
+						consider(Rewrite::Fold, cyclesSaved);
+					}
+				}
+			}
+		}
+
+		if (best == Rewrite::None)
+		{
+			i++;
+			continue;
+		}
+
+		switch (best)
+		{
+		case Rewrite::DropFirst:
+			window.erase(window.begin() + i);
+			break;
+
+		case Rewrite::DropSecond:
+			window.erase(window.begin() + i + 1);
+			break;
+
+		case Rewrite::Fold:
+			window[i + 1] = folded;
+			window.erase(window.begin() + i);
+			break;
+
+		default:
+			break;
+		}
+
+		_removed++;
+		_cyclesSaved += saving;
+
+		// the rewrite may have made a new candidate out of the instructions before it
+		i = i >= 2 ? i - 2 : 0;
+	}
+}
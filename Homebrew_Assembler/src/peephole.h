@@ -0,0 +1,62 @@
+#pragma once
+
+#include "architecture.h"
+#include "include.h"
+#include "matcher.h"
+
+#include <string_view>
+#include <vector>
+
+// An instruction matched but not encoded yet, waiting in the peephole window
+class windowInstruction
+{
+public:
+	instructionMatch match;
+	int line = 0;
+	sourceLocation where;
+
+	// A register transfer or load (mov reg, reg or mov reg, #) -- the only instructions the
+	// optimizer rewrites. src is empty for a load, whose value is match.values[0].
+	bool move = false;
+	std::string_view dst;
+	std::string_view src;
+};
+
+// A peephole pass over straight-line runs of instructions (the assembler flushes the window at
+// every label, directive and include, so nothing can jump into the middle of one). The rules
+// only look at moves, and only between registers of the same width, which are taken to be
+// disjoint and to be all a move changes (the flags are left alone):
+//  - mov x, x                          is dropped
+//  - mov x, S / mov x, T               drops the first (when T does not read x)
+//  - mov x, y / mov y, x (or x, y)     drops the second
+//  - mov t, S / mov d, t / mov t, U    becomes mov d, S / mov t, U (when the architecture has
+//                                      a mov d, S form and U does not read t)
+// Every candidate is costed with the cycle counts of the architecture's microcode, and at each
+// position the one saving the most cycles is taken.
+class peepholeOptimizer
+{
+public:
+	explicit peepholeOptimizer(const architecture& arch) : _arch(arch) {}
+
+	// Fills in the move fields of a matched instruction
+	void classify(windowInstruction& i, std::string_view mnemonic, std::string_view operands) const;
+
+	// Rewrites the window in place
+	void optimize(std::vector<windowInstruction>& window);
+
+	int removed() const { return _removed; }
+	int cyclesSaved() const { return _cyclesSaved; }
+
+private:
+	int cycles(const windowInstruction& i) const { return _arch.microcode.numCycles(i.match.value); }
+	int registerBits(std::string_view name) const;
+	bool reads(const windowInstruction& i, std::string_view reg) const { return !i.move || i.src == reg; }
+
+	// The move d <- the source of from, if the architecture has that form
+	bool makeMove(std::string_view dst, const windowInstruction& from, windowInstruction& out) const;
+
+private:
+	const architecture& _arch;
+	int _removed = 0;
+	int _cyclesSaved = 0;
+};
@@ -0,0 +1,178 @@
+#include "programrom.h"
+#include "util.h"
+
+#include <algorithm>
+
+bool programImage::page::anyWritten(uint32_t first, uint32_t n) const
+{
+	// whole bitmap words where possible
+	uint32_t i = first;
+	const uint32_t end = first + n;
+	while (i < end)
+	{
+		if ((i & 63) == 0 && end - i >= 64)
+		{
+			if (written[i >> 6] != 0)
+				return true;
+
+			i += 64;
+		}
+		else
+		{
+			if (isWritten(i))
+				return true;
+
+			i++;
+		}
+	}
+
+	return false;
+}
+
+void programImage::page::markWritten(uint32_t first, uint32_t n)
+{
+	uint32_t i = first;
+	const uint32_t end = first + n;
+	while (i < end)
+	{
+		if ((i & 63) == 0 && end - i >= 64)
+		{
+			written[i >> 6] = ~uint64_t(0);
+			i += 64;
+		}
+		else
+		{
+			written[i >> 6] |= uint64_t(1) << (i & 63);
+			i++;
+		}
+	}
+}
+
+programImage::programImage(std::pmr::memory_resource* resource)
+	:
+	_resource(resource),
+	_pages(resource)
+{}
+
+void programImage::reset(uint32_t size)
+{
+	// the pages themselves belong to the memory resource, and go back with it
+	resetVector(_pages, _resource);
+	_size = size;
+	_pagesUsed = 0;
+
+	if (size > 0)
+		_pages.assign((size + PAGE_SIZE - 1) / PAGE_SIZE, nullptr);
+}
+
+programImage::page* programImage::pageFor(uint32_t address)
+{
+	page*& p = _pages[address >> PAGE_BITS];
+	if (p == nullptr)
+	{
+		p = static_cast<page*>(_resource->allocate(sizeof(page), alignof(page)));
+		memset(p, 0, sizeof(page));
+		_pagesUsed++;
+	}
+
+	return p;
+}
+
+programImage::WriteStatus programImage::write(uint32_t address, const uint8_t* data, size_t n, uint32_t& at)
+{
+	if (address > _size || n > _size - address)
+	{
+		at = address;
+		return WriteStatus::OutOfRange;
+	}
+
+	// check every page first, so a failed write leaves the image untouched
+	for (uint32_t a = address, left = static_cast<uint32_t>(n); left > 0;)
+	{
+		const uint32_t offset = a & (PAGE_SIZE - 1);
+		const uint32_t chunk = left < PAGE_SIZE - offset ? left : PAGE_SIZE - offset;
+
+		const page* p = _pages[a >> PAGE_BITS];
+		if (p != nullptr && p->anyWritten(offset, chunk))
+		{
+			uint32_t i = offset;
+			while (!p->isWritten(i))
+				i++;
+
+			at = (a & ~(PAGE_SIZE - 1)) + i;
+			return WriteStatus::Overlap;
+		}
+
+		a += chunk;
+		left -= chunk;
+	}
+
+	for (uint32_t a = address, left = static_cast<uint32_t>(n); left > 0;)
+	{
+		const uint32_t offset = a & (PAGE_SIZE - 1);
+		const uint32_t chunk = left < PAGE_SIZE - offset ? left : PAGE_SIZE - offset;
+
+		page* p = pageFor(a);
+		memcpy(p->bytes + offset, data, chunk);
+		p->markWritten(offset, chunk);
+
+		data += chunk;
+		a += chunk;
+		left -= chunk;
+	}
+
+	return WriteStatus::Ok;
+}
+
+void programImage::patch(uint32_t address, const uint8_t* data, size_t n)
+{
+	// a field may straddle two pages, so go byte by byte (fields are only a few bytes)
+	for (size_t i = 0; i < n; i++)
+	{
+		page* p = _pages[(address + i) >> PAGE_BITS];
+		p->bytes[(address + i) & (PAGE_SIZE - 1)] = data[i];
+	}
+}
+
+uint8_t programImage::read(uint32_t address) const
+{
+	if (address >= _size)
+		return 0;
+
+	const page* p = _pages[address >> PAGE_BITS];
+	return p != nullptr ? p->bytes[address & (PAGE_SIZE - 1)] : 0;
+}
+
+void programImage::read(uint32_t address, uint8_t* out, size_t n) const
+{
+	while (n > 0)
+	{
+		if (address >= _size)
+		{
+			memset(out, 0, n);
+			return;
+		}
+
+		const uint32_t offset = address & (PAGE_SIZE - 1);
+		const size_t chunk = std::min<size_t>(n, PAGE_SIZE - offset);
+
+		const page* p = _pages[address >> PAGE_BITS];
+		if (p != nullptr)
+			memcpy(out, p->bytes + offset, chunk);
+		else
+			memset(out, 0, chunk);
+
+		out += chunk;
+		address += static_cast<uint32_t>(chunk);
+		n -= chunk;
+	}
+}
+
+bool programImage::written(uint32_t address) const
+{
+	if (address >= _size)
+		return false;
+
+	const page* p = _pages[address >> PAGE_BITS];
+	return p != nullptr && p->isWritten(address & (PAGE_SIZE - 1));
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The program rom image. Storage is a table of fixed-size pages indexed by address; a page is only
+// allocated (from the given memory resource) the first time something is written into it, so a
+// mostly empty rom costs memory in proportion to the code actually emitted. Every page also keeps
+// a bitmap of the bytes written so far, which is how overlapping output is detected.
+class programImage
+{
+public:
+	static constexpr int PAGE_BITS = 12;
+	static constexpr uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+
+	enum class WriteStatus { Ok, OutOfRange, Overlap };
+
+	explicit programImage(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	// Forgets everything written and makes the image size bytes long (0 = no program rom)
+	void reset(uint32_t size);
+	void clear() { reset(0); }
+
+	uint32_t size() const { return _size; }
+	size_t pagesUsed() const { return _pagesUsed; }
+
+	// Copies n bytes to address, page by page. Nothing is written unless all of them fit and none
+	// of them was written before; on an overlap, at is the first byte that was already written.
+	WriteStatus write(uint32_t address, const uint8_t* data, size_t n, uint32_t& at);
+
+	// Overwrites n bytes that were all written before (to patch a fixup)
+	void patch(uint32_t address, const uint8_t* data, size_t n);
+
+	// 0 for bytes that were never written
+	uint8_t read(uint32_t address) const;
+	bool written(uint32_t address) const;
+
+	// Copies n bytes from address into out, page by page (unwritten bytes read as 0)
+	void read(uint32_t address, uint8_t* out, size_t n) const;
+
+	// Calls f(address, bytes, n) for every page-bounded run of written bytes, in address order
+	template <class f>
+	void forEachRun(f&& fn) const
+	{
+		for (size_t p = 0; p < _pages.size(); p++)
+		{
+			const page* pg = _pages[p];
+			if (pg == nullptr)
+				continue;
+
+			uint32_t i = 0;
+			while (i < PAGE_SIZE)
+			{
+				while (i < PAGE_SIZE && !pg->isWritten(i))
+					i++;
+
+				const uint32_t start = i;
+				while (i < PAGE_SIZE && pg->isWritten(i))
+					i++;
+
+				if (i > start)
+					fn(static_cast<uint32_t>(p << PAGE_BITS) + start, pg->bytes + start, static_cast<size_t>(i - start));
+			}
+		}
+	}
+
+private:
+	class page
+	{
+	public:
+		uint8_t bytes[PAGE_SIZE];
+		uint64_t written[PAGE_SIZE / 64];
+
+		bool isWritten(uint32_t i) const { return (written[i >> 6] >> (i & 63)) & 1; }
+		bool anyWritten(uint32_t first, uint32_t n) const;
+		void markWritten(uint32_t first, uint32_t n);
+	};
+
+	page* pageFor(uint32_t address);
+
+	std::pmr::memory_resource* _resource;
+	std::pmr::vector<page*> _pages;
+	uint32_t _size = 0;
+	size_t _pagesUsed = 0;
+};
+
+// A named view of part of the program rom with its own location counter. Code is emitted into
+// the active segment, which keeps every byte inside [origin, limit).
+class programSegment
+{
+public:
+	std::string name;
+	uint32_t origin = 0;
+	uint32_t limit = 0;
+	uint32_t cursor = 0;
+
+	bool contains(uint32_t address, size_t n) const { return address >= origin && address <= limit && n <= limit - address; }
+	bool overlaps(const programSegment& other) const { return origin < other.limit && other.origin < limit; }
+};
@@ -0,0 +1,158 @@
+#include "redundancy.h"
+#include "logger.h"
+#include "util.h"
+
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+
+// the most used control words shown by summary()
+static constexpr size_t COMMON_WORDS = 8;
+
+static int bitsFor(size_t n)
+{
+	int bits = 0;
+	while ((size_t(1) << bits) < n)
+		bits++;
+
+	return bits;
+}
+
+microcodeRedundancy::microcodeRedundancy(const architecture& arch)
+	:
+	_arch(arch)
+{
+	const microcodeStore& mc = arch.microcode;
+
+	// the layout in use, or the smallest one that fits when there is no decoder rom
+	if (!arch.decoder.empty())
+	{
+		_layout = arch.decoder.layout();
+	}
+	else
+	{
+		_layout.opcodeBits = arch.instructionWidth * 8;
+		_layout.cycleBits = bitsFor(mc.maxCycles());
+		_layout.flagBits = arch.nFlags;
+	}
+
+	_romEntries = size_t(1) << _layout.addressBits();
+
+	const uint32_t flagStates = uint32_t(1) << arch.nFlags;
+	std::unordered_map<uint32_t, size_t> words;
+	std::map<std::vector<uint32_t>, int> rows;
+	std::map<std::vector<uint32_t>, std::vector<int>> sequences;
+
+	std::vector<uint32_t> row(flagStates);
+	std::vector<uint32_t> sequence;
+
+	for (int v = 0; v < mc.limit(); v++)
+	{
+		const int n = mc.numCycles(v);
+		if (n == 0)
+			continue;
+
+		_opcodes++;
+		sequence.clear();
+
+		for (int c = 0; c < n; c++)
+		{
+			const int cycle = mc.firstCycle(v) + c;
+			bool independent = true;
+
+			for (uint32_t f = 0; f < flagStates; f++)
+			{
+				row[f] = mc.word(cycle, f);
+				words[row[f]]++;
+				independent = independent && row[f] == row[0];
+			}
+
+			_rows++;
+			rows[row]++;
+			_flagIndependentRows += independent ? 1 : 0;
+			sequence.insert(sequence.end(), row.begin(), row.end());
+		}
+
+		sequences[sequence].push_back(v);
+	}
+
+	_definedEntries = _rows * flagStates;
+	_uniqueWords = words.size();
+	_uniqueRows = rows.size();
+	_uniqueSequences = static_cast<int>(sequences.size());
+
+	for (const auto& s : sequences)
+	{
+		if (s.second.size() > 1)
+			_duplicates.push_back(s.second);
+	}
+
+	std::sort(_duplicates.begin(), _duplicates.end());
+
+	_commonWords.assign(words.begin(), words.end());
+	std::sort(_commonWords.begin(), _commonWords.end(), [](const auto& x, const auto& y) { return x.second != y.second ? x.second > y.second : x.first < y.first; });
+	if (_commonWords.size() > COMMON_WORDS)
+		_commonWords.resize(COMMON_WORDS);
+}
+
+void microcodeRedundancy::summary() const
+{
+	if (!logEnabled(LogLevel::MajorTasks))
+		return;
+
+	const int flagStates = 1 << _arch.nFlags;
+
+	logLine out;
+	out << "\nDecoder rom redundancy : " << _opcodes << " opcodes, " << _rows << " cycles\n";
+	out << "  entries   : " << _romEntries << " in the rom, " << _definedEntries << " defined, " << _uniqueWords << " distinct control words\n";
+	out << "  rows      : " << _rows << " (opcode, cycle) rows of " << flagStates << " flag states, " << _uniqueRows << " distinct, "
+		<< _flagIndependentRows << " the same for every flag state\n";
+
+	int duplicated = 0;
+	for (const std::vector<int>& group : _duplicates)
+		duplicated += static_cast<int>(group.size()) - 1;
+
+	out << "  sequences : " << _uniqueSequences << " distinct, " << duplicated << " opcode(s) an exact duplicate of another\n";
+
+	for (const std::vector<int>& group : _duplicates)
+	{
+		out << "   ";
+		for (int v : group)
+			out << " $" << hex2 << v << dec << " " << _arch.opcodes[v].getUniqueString();
+
+		out << "\n";
+	}
+
+	// named when a control line (like fetch) is exactly that word
+	out << "  most used control words :\n";
+	for (const auto& [word, entries] : _commonWords)
+	{
+		out << "    $" << hex8 << word << dec << " : " << entries << " entries";
+
+		for (int i = 0; i < _arch.symbols.count(); i++)
+		{
+			const symbol& s = _arch.symbols.at(i);
+			if (s.getType() == SymbolType::ControlLine && static_cast<uint32_t>(s.getAddress()) == word && word != 0)
+			{
+				out << " (" << _arch.symbols.name(s) << ")";
+				break;
+			}
+		}
+
+		out << "\n";
+	}
+
+	// what smaller roms the counts allow
+	const int cycleBits = bitsFor(_arch.microcode.maxCycles());
+	const int rowBits = bitsFor(_uniqueRows);
+	const int wordBits = std::max(_arch.decoder.wordBits(), 1);
+
+	out << "  address split :\n";
+	out << "    in use    : " << _layout.addressBits() << " bits (" << _layout.opcodeBits << " opcode, " << _layout.cycleBits << " cycle, "
+		<< _layout.flagBits << " flag), " << _romEntries << " words\n";
+	out << "    tightest  : " << _layout.opcodeBits + cycleBits + _layout.flagBits << " bits (" << cycleBits << " cycle bits for "
+		<< _arch.microcode.maxCycles() << " cycles), " << (size_t(1) << (_layout.opcodeBits + cycleBits + _layout.flagBits)) << " words\n";
+	out << "    two-level : " << (size_t(1) << (_layout.opcodeBits + cycleBits)) << " x " << rowBits << " bit row index ("
+		<< _layout.opcodeBits + cycleBits << " address bits), then " << (size_t(1) << (rowBits + _layout.flagBits)) << " x " << wordBits
+		<< " bit words for the " << _uniqueRows << " distinct rows (" << rowBits + _layout.flagBits << " address bits)\n";
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "architecture.h"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// How much of the decoder rom is repeated, found from the microcode of an architecture:
+//  - the distinct control words among all the (opcode, cycle, flag state) entries
+//  - the distinct rows, a row being every flag state of one (opcode, cycle), and the rows that
+//    are the same for every flag state (a seq, or seq_if branches that happen to agree)
+//  - the opcodes whose whole sequences are exact duplicates of another
+// and what that leaves for a smaller rom: the address bits of the layout in use, the fewest
+// cycle bits that still fit, and a two-level split (a row index per (opcode, cycle), and one
+// copy of each distinct row behind it).
+class microcodeRedundancy
+{
+public:
+	explicit microcodeRedundancy(const architecture& arch);
+
+	size_t romEntries() const { return _romEntries; }
+	size_t definedEntries() const { return _definedEntries; }
+	size_t uniqueWords() const { return _uniqueWords; }
+	size_t rows() const { return _rows; }
+	size_t uniqueRows() const { return _uniqueRows; }
+	size_t flagIndependentRows() const { return _flagIndependentRows; }
+
+	// Groups of opcode values with identical sequences (in value order, only groups of two or more)
+	const std::vector<std::vector<int>>& duplicates() const { return _duplicates; }
+
+	// Logs the counts, the duplicate opcodes and the most used control words
+	void summary() const;
+
+private:
+	const architecture& _arch;
+	decoderLayout _layout;
+
+	size_t _romEntries = 0;
+	size_t _definedEntries = 0;
+	size_t _uniqueWords = 0;
+	size_t _rows = 0;
+	size_t _uniqueRows = 0;
+	size_t _flagIndependentRows = 0;
+	int _opcodes = 0;
+	int _uniqueSequences = 0;
+
+	std::vector<std::vector<int>> _duplicates;
+	std::vector<std::pair<uint32_t, size_t>> _commonWords;	// word, entries -- the most used first
+};
@@ -0,0 +1,364 @@
+#include "romwriter.h"
+#include "config.h"
+#include "sourcefile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+// every chip word is formatted as one byte
+static_assert(ROM_CHIP_BITS == 8, "rom chips are expected to be byte wide");
+
+// words fetched at a time -- a whole number of hex records and of 64 KB hex segments
+static constexpr size_t BLOCK_WORDS = 4096;
+
+static constexpr size_t HEX_RECORD_BYTES = 16;
+static constexpr size_t HEX_SEGMENT_BYTES = 0x10000;
+static constexpr size_t LOGISIM_ROW_WORDS = 16;
+static constexpr size_t DUMP_ROW_WORDS = 16;
+
+static constexpr const char* LOGISIM_HEADER = "v2.0 raw\n";
+static constexpr const char* HEX_EOF_RECORD = ":00000001FF\n";
+
+// the two hex digits of every byte value
+class hexPairTable
+{
+public:
+	char digits[512];
+
+	constexpr hexPairTable() : digits()
+	{
+		constexpr const char* hex = "0123456789ABCDEF";
+		for (int i = 0; i < 256; i++)
+		{
+			digits[2 * i] = hex[i >> 4];
+			digits[2 * i + 1] = hex[i & 15];
+		}
+	}
+};
+
+class crcTable
+{
+public:
+	uint32_t entries[256];
+
+	constexpr crcTable() : entries()
+	{
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+
+			entries[i] = c;
+		}
+	}
+};
+
+static constexpr hexPairTable HEX_PAIRS;
+static constexpr crcTable CRC_TABLE;
+
+static inline char* putHex(char* p, uint8_t b)
+{
+	p[0] = HEX_PAIRS.digits[2 * b];
+	p[1] = HEX_PAIRS.digits[2 * b + 1];
+	return p + 2;
+}
+
+uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < n; i++)
+		crc = CRC_TABLE.entries[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+int romImage::chips() const
+{
+	return bits <= ROM_CHIP_BITS ? 1 : (bits + ROM_CHIP_BITS - 1) / ROM_CHIP_BITS;
+}
+
+// the size of every format, so the files can be mapped before anything is formatted
+static size_t formatSize(RomFormat format, size_t words)
+{
+	switch (format)
+	{
+	case RawFormat:
+		return words;
+
+	case IntelHexFormat:
+	{
+		// ":LLAAAA00" data "CC\n" per record, an extended address record for every 64 KB past the
+		// first, and the end of file record
+		const size_t full = words / HEX_RECORD_BYTES;
+		const size_t partial = words % HEX_RECORD_BYTES;
+		const size_t extended = words > 0 ? (words - 1) / HEX_SEGMENT_BYTES : 0;
+		return full * (12 + 2 * HEX_RECORD_BYTES) + (partial ? 12 + 2 * partial : 0) + extended * 16 + strlen(HEX_EOF_RECORD);
+	}
+
+	case LogisimFormat:
+		return strlen(LOGISIM_HEADER) + 3 * words;
+
+	case VerilogFormat:
+		return 3 * words;
+
+	default:
+		return 0;
+	}
+}
+
+static const char* formatExt(RomFormat format)
+{
+	switch (format)
+	{
+	case IntelHexFormat: return INTEL_HEX_FILE_EXT;
+	case LogisimFormat: return LOGISIM_FILE_EXT;
+	case VerilogFormat: return VERILOG_FILE_EXT;
+	default: return ROM_FILE_EXT;
+	}
+}
+
+static char* putHexRecord(char* p, uint8_t type, uint16_t address, const uint8_t* data, size_t n)
+{
+	uint8_t sum = static_cast<uint8_t>(n + (address >> 8) + address + type);
+
+	*p++ = ':';
+	p = putHex(p, static_cast<uint8_t>(n));
+	p = putHex(p, static_cast<uint8_t>(address >> 8));
+	p = putHex(p, static_cast<uint8_t>(address));
+	p = putHex(p, type);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		p = putHex(p, data[i]);
+		sum += data[i];
+	}
+
+	p = putHex(p, static_cast<uint8_t>(-sum));
+	*p++ = '\n';
+	return p;
+}
+
+// formats one block of chip bytes (starting at word first) into the given format
+static char* formatBlock(RomFormat format, char* p, size_t first, const uint8_t* bytes, size_t n, size_t words)
+{
+	switch (format)
+	{
+	case RawFormat:
+		memcpy(p, bytes, n);
+		return p + n;
+
+	case IntelHexFormat:
+		for (size_t i = 0; i < n; i += HEX_RECORD_BYTES)
+		{
+			const size_t address = first + i;
+			if (address > 0 && address % HEX_SEGMENT_BYTES == 0)
+			{
+				const uint8_t upper[2] = { static_cast<uint8_t>(address >> 24), static_cast<uint8_t>(address >> 16) };
+				p = putHexRecord(p, 4, 0, upper, 2);
+			}
+
+			p = putHexRecord(p, 0, static_cast<uint16_t>(address), bytes + i, std::min(HEX_RECORD_BYTES, n - i));
+		}
+		return p;
+
+	case LogisimFormat:
+		for (size_t i = 0; i < n; i++)
+		{
+			p = putHex(p, bytes[i]);
+
+			const size_t next = first + i + 1;
+			*p++ = (next % LOGISIM_ROW_WORDS == 0 || next == words) ? '\n' : ' ';
+		}
+		return p;
+
+	case VerilogFormat:
+		for (size_t i = 0; i < n; i++)
+		{
+			p = putHex(p, bytes[i]);
+			*p++ = '\n';
+		}
+		return p;
+
+	default:
+		return p;
+	}
+}
+
+std::vector<romChip> writeRomImage(const romImage& image, const std::string& base, unsigned formats)
+{
+	static constexpr RomFormat ALL[] = { RawFormat, IntelHexFormat, LogisimFormat, VerilogFormat };
+
+	if (image.bits > 32)
+	{
+		std::stringstream msg;
+		msg << "Rom words of " << image.bits << " bits are not supported!";
+		throw std::runtime_error(msg.str());
+	}
+
+	const int chips = image.chips();
+	std::vector<romChip> written(chips);
+
+	// one mapped file (and write position) for every chip and format
+	class output
+	{
+	public:
+		RomFormat format;
+		int chip;
+		outputFile file;
+		char* cursor;
+	};
+
+	std::vector<output> outputs;
+	for (int c = 0; c < chips; c++)
+	{
+		for (RomFormat f : ALL)
+		{
+			if ((formats & f) == 0)
+				continue;
+
+			const std::string filename = chips == 1 ? base + formatExt(f) : base + "_" + std::to_string(c) + formatExt(f);
+			output o{ f, c, outputFile(filename, formatSize(f, image.words)), nullptr };
+			o.cursor = o.file.data();
+
+			if (f == LogisimFormat)
+			{
+				memcpy(o.cursor, LOGISIM_HEADER, strlen(LOGISIM_HEADER));
+				o.cursor += strlen(LOGISIM_HEADER);
+			}
+
+			written[c].files.push_back(filename);
+			outputs.push_back(std::move(o));
+		}
+	}
+
+	std::vector<uint32_t> block(BLOCK_WORDS);
+	std::vector<uint8_t> bytes(BLOCK_WORDS * chips);
+
+	for (size_t first = 0; first < image.words; first += BLOCK_WORDS)
+	{
+		const size_t n = std::min(BLOCK_WORDS, image.words - first);
+		image.fetch(first, n, block.data());
+
+		// slice the block into its chips once, every format reads the same bytes
+		for (int c = 0; c < chips; c++)
+		{
+			uint8_t* slice = bytes.data() + c * BLOCK_WORDS;
+			for (size_t i = 0; i < n; i++)
+				slice[i] = static_cast<uint8_t>(block[i] >> (c * ROM_CHIP_BITS));
+
+			written[c].crc = crc32(slice, n, written[c].crc);
+		}
+
+		for (output& o : outputs)
+			o.cursor = formatBlock(o.format, o.cursor, first, bytes.data() + o.chip * BLOCK_WORDS, n, image.words);
+	}
+
+	for (output& o : outputs)
+	{
+		if (o.format == IntelHexFormat)
+		{
+			memcpy(o.cursor, HEX_EOF_RECORD, strlen(HEX_EOF_RECORD));
+			o.cursor += strlen(HEX_EOF_RECORD);
+		}
+
+		if (o.cursor != o.file.data() + o.file.size())
+		{
+			std::stringstream msg;
+			msg << "Rom output size mismatch in [" << o.file.filename() << "]!";
+			throw std::runtime_error(msg.str());
+		}
+	}
+
+	return written;
+}
+
+void dumpRomImage(std::ostream& out, const romImage& image)
+{
+	const int wordBytes = std::max(1, (image.bits + 7) / 8);
+
+	int addressBytes = 2;
+	while (addressBytes < 4 && image.words > (size_t(1) << (8 * addressBytes)))
+		addressBytes++;
+
+	std::vector<uint32_t> block(BLOCK_WORDS);
+	std::string line;
+	bool skipping = false;
+
+	for (size_t first = 0; first < image.words; first += BLOCK_WORDS)
+	{
+		const size_t n = std::min(BLOCK_WORDS, image.words - first);
+		image.fetch(first, n, block.data());
+
+		for (size_t row = 0; row < n; row += DUMP_ROW_WORDS)
+		{
+			const size_t count = std::min(DUMP_ROW_WORDS, n - row);
+
+			bool zero = true;
+			for (size_t i = 0; i < count && zero; i++)
+				zero = block[row + i] == 0;
+
+			if (zero)
+			{
+				if (!skipping)
+					out << "*\n";
+
+				skipping = true;
+				continue;
+			}
+
+			skipping = false;
+
+			// "$AAAA :" then the words, most significant byte first
+			line.assign(2 + 2 * addressBytes + 2 + count * (1 + 2 * wordBytes) + 1, ' ');
+			char* p = line.data();
+
+			const size_t address = first + row;
+			*p++ = '$';
+			for (int b = addressBytes - 1; b >= 0; b--)
+				p = putHex(p, static_cast<uint8_t>(address >> (8 * b)));
+
+			p++;
+			*p++ = ':';
+
+			for (size_t i = 0; i < count; i++)
+			{
+				p++;
+				for (int b = wordBytes - 1; b >= 0; b--)
+					p = putHex(p, static_cast<uint8_t>(block[row + i] >> (8 * b)));
+			}
+
+			*p++ = '\n';
+			out.write(line.data(), p - line.data());
+		}
+	}
+}
+
+bool parseRomFormats(std::string_view list, unsigned& formats)
+{
+	formats = 0;
+
+	while (!list.empty())
+	{
+		const size_t comma = list.find(',');
+		const std::string_view name = list.substr(0, comma);
+		list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+		if (name == "bin" || name == "raw")
+			formats |= RawFormat;
+		else if (name == "hex" || name == "ihex")
+			formats |= IntelHexFormat;
+		else if (name == "logisim")
+			formats |= LogisimFormat;
+		else if (name == "verilog" || name == "mem")
+			formats |= VerilogFormat;
+		else if (name == "all")
+			formats |= AllFormats;
+		else
+			return false;
+	}
+
+	return formats != 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Rom output formats -- any combination of them is written in the same pass
+enum RomFormat : unsigned
+{
+	RawFormat = 0x01,       // raw binary, one byte per word
+	IntelHexFormat = 0x02,  // Intel HEX, 16 byte data records
+	LogisimFormat = 0x04,   // Logisim "v2.0 raw"
+	VerilogFormat = 0x08,   // Verilog $readmemh
+	AllFormats = 0x0F
+};
+
+// A rom as seen by the writer: words words of bits bits each, handed out in blocks by
+// fetch(first, n, out) so neither the decoder nor the (sparse) program image is copied whole
+class romImage
+{
+public:
+	size_t words = 0;
+	int bits = 0;
+	std::function<void(size_t first, size_t n, uint32_t* out)> fetch;
+
+	// number of ROM_CHIP_BITS wide chips needed side by side
+	int chips() const;
+};
+
+// What was written for one chip
+class romChip
+{
+public:
+	std::vector<std::string> files;
+	uint32_t crc = 0;   // CRC-32 of the chip's raw contents
+};
+
+// Writes every chip of the image in every requested format with a single pass over the words. All
+// the output sizes are known up front, so each file is a fixed-size mapping that the formatters
+// write straight into. Files are named <base>[_<chip>]<ext>, the chip index only being added when
+// there is more than one.
+std::vector<romChip> writeRomImage(const romImage& image, const std::string& base, unsigned formats);
+
+// Prints the image as rows of 16 words; runs of all-zero rows are collapsed into one "*" line
+void dumpRomImage(std::ostream& out, const romImage& image);
+
+// Parses a comma separated list of format names (bin, hex, logisim, verilog or all)
+bool parseRomFormats(std::string_view list, unsigned& formats);
+
+uint32_t crc32(const uint8_t* data, size_t n, uint32_t crc = 0);
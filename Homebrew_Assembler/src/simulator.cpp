@@ -0,0 +1,662 @@
+#include "simulator.h"
+#include "config.h"
+#include "logger.h"
+#include "util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+static const struct { std::string_view name; SimUnit unit; } UNIT_NAMES[] =
+{
+	{ "a", SimUnit::A }, { "b", SimUnit::B }, { "c", SimUnit::C }, { "dl", SimUnit::DL }, { "dh", SimUnit::DH },
+	{ "ir", SimUnit::IR }, { "pc", SimUnit::PC }, { "sp", SimUnit::SP }, { "wi", SimUnit::WI }, { "ri", SimUnit::RI },
+	{ "ra", SimUnit::RA }, { "ax", SimUnit::AX }, { "dx", SimUnit::DX }, { "ah", SimUnit::AH }, { "al", SimUnit::AL },
+	{ "mem", SimUnit::Mem }, { "alu", SimUnit::Alu }, { "int", SimUnit::Int },
+};
+
+static const struct { std::string_view name; AluOp op; } ALU_NAMES[] =
+{
+	{ "pass_lhs", AluOp::PassLhs }, { "pass_rhs", AluOp::PassRhs }, { "inc_lhs", AluOp::IncLhs }, { "inc_inc_lhs", AluOp::IncIncLhs },
+	{ "dec_lhs", AluOp::DecLhs }, { "dec_dec_lhs", AluOp::DecDecLhs }, { "shl_0_lhs", AluOp::Shl0 }, { "shl_1_lhs", AluOp::Shl1 },
+	{ "shr_0_lhs", AluOp::Shr0 }, { "shr_1_lhs", AluOp::Shr1 }, { "mshl_0_lhs_rhs", AluOp::Mshl0 }, { "mshl_1_lhs_rhs", AluOp::Mshl1 },
+	{ "mshr_0_lhs_rhs", AluOp::Mshr0 }, { "mshr_1_lhs_rhs", AluOp::Mshr1 }, { "not_lhs", AluOp::NotLhs }, { "and_lhs_rhs", AluOp::And },
+	{ "or_lhs_rhs", AluOp::Or }, { "xor_lhs_rhs", AluOp::Xor }, { "add_lhs_rhs", AluOp::Add }, { "add_inc_lhs_rhs", AluOp::AddInc },
+	{ "sub_lhs_rhs", AluOp::Sub }, { "sub_dec_lhs_rhs", AluOp::SubDec }, { "mul_lo_lhs_rhs", AluOp::MulLo }, { "mul_hi_lhs_rhs", AluOp::MulHi },
+	{ "div_lhs_rhs", AluOp::Div }, { "mod_lhs_rhs", AluOp::Mod }, { "clc", AluOp::Clc }, { "sec", AluOp::Sec },
+	{ "cid", AluOp::Cid }, { "sid", AluOp::Sid },
+};
+
+static constexpr std::string_view DEVICE_PREFIX = "device";
+static constexpr int MAX_DEVICES = 256;
+static constexpr size_t MEMORY_SIZE = 1 << 16;
+
+static bool unitFor(std::string_view name, SimUnit& unit, uint8_t& device)
+{
+	for (const auto& u : UNIT_NAMES)
+	{
+		if (u.name == name)
+		{
+			unit = u.unit;
+			return true;
+		}
+	}
+
+	if (name.size() > DEVICE_PREFIX.size() && name.substr(0, DEVICE_PREFIX.size()) == DEVICE_PREFIX)
+	{
+		int n = 0;
+		for (char c : name.substr(DEVICE_PREFIX.size()))
+		{
+			if (c < '0' || c > '9')
+				return false;
+
+			n = n * 10 + (c - '0');
+		}
+
+		if (n >= MAX_DEVICES)
+			return false;
+
+		unit = SimUnit::Device;
+		device = static_cast<uint8_t>(n);
+		return true;
+	}
+
+	return false;
+}
+
+bool simulator::parseLine(std::string_view name, lineMeaning& m)
+{
+	// a leading _ marks an active-low line
+	while (!name.empty() && name.front() == '_')
+		name.remove_prefix(1);
+
+	if (name == END_SEQ_LINE)
+	{
+		m.role = LineRole::End;
+		return true;
+	}
+
+	if (name == "ra_read")
+	{
+		m.role = LineRole::RaRead;
+		return true;
+	}
+
+	// (the alu also drives the data bus, as alu_write_data)
+	if (name.substr(0, 4) == "alu_")
+	{
+		for (const auto& a : ALU_NAMES)
+		{
+			if (a.name == name.substr(4))
+			{
+				m.role = LineRole::Alu;
+				m.alu = a.op;
+				return true;
+			}
+		}
+	}
+
+	// unit_action or unit_direction_bus
+	std::string_view parts[3];
+	int n = 0;
+	while (!name.empty() && n < 3)
+	{
+		size_t at = name.find('_');
+		parts[n++] = name.substr(0, at);
+		name = at == std::string_view::npos ? std::string_view() : name.substr(at + 1);
+	}
+
+	if (!name.empty() || n < 2 || !unitFor(parts[0], m.unit, m.device))
+		return false;
+
+	if (n == 2)
+	{
+		const bool pc = m.unit == SimUnit::PC;
+		if (parts[1] == "inc" || parts[1] == "dec")
+		{
+			m.role = pc ? LineRole::Pc : LineRole::IncDec;
+			m.pc = parts[1] == "inc" ? PcOp::Inc : PcOp::Dec;
+			m.decrement = parts[1] == "dec";
+			return true;
+		}
+
+		if (pc && parts[1] == "rti")
+		{
+			m.role = LineRole::Pc;
+			m.pc = PcOp::Rti;
+			return true;
+		}
+
+		return false;
+	}
+
+	const bool write = parts[1] == "write";
+	if (!write && parts[1] != "read")
+		return false;
+
+	if (parts[2] == "data")
+		m.role = write ? LineRole::DataWriter : LineRole::DataReader;
+	else if (parts[2] == "lhs" && write)
+		m.role = LineRole::LhsWriter;
+	else if (parts[2] == "rhs" && write)
+		m.role = LineRole::RhsWriter;
+	else if (parts[2] == "lrhs" && !write)
+		m.role = LineRole::LrhsReader;
+	else if (parts[2] == "addr")
+		m.role = write ? LineRole::AddrWriter : LineRole::AddrReader;
+	else
+		return false;
+
+	return true;
+}
+
+void simulator::apply(const lineMeaning& m, microOp& op)
+{
+	switch (m.role)
+	{
+	case LineRole::DataWriter: op.dataWriter = m.unit; op.writeDevice = m.device; break;
+	case LineRole::LhsWriter: op.lhsWriter = m.unit; break;
+	case LineRole::RhsWriter: op.rhsWriter = m.unit; break;
+	case LineRole::LrhsReader: op.lrhsReader = m.unit; break;
+	case LineRole::AddrWriter: op.addrWriter = m.unit; break;
+	case LineRole::AddrReader: op.axFromAddr = m.unit == SimUnit::AX; break;
+	case LineRole::IncDec: op.incDec = m.unit; op.decrement = m.decrement; break;
+	case LineRole::Pc: op.pc = m.pc; break;
+	case LineRole::Alu: op.alu = m.alu; break;
+	case LineRole::RaRead: op.raFromPc = true; break;
+	case LineRole::End: op.end = true; break;
+
+	case LineRole::DataReader:
+		if (m.unit == SimUnit::Mem)
+			op.store = true;
+		else
+		{
+			op.dataReader = m.unit;
+			op.readDevice = m.device;
+		}
+		break;
+	}
+}
+
+simulator::simulator(const architecture& arch, const programImage& rom)
+	:
+	_arch(arch)
+{
+	// flags by the last letter of their names (flag_c, flag_v, flag_z, flag_s, flag_d)
+	for (int i = 0; i < arch.symbols.count(); i++)
+	{
+		const symbol& s = arch.symbols.at(i);
+		if (s.getType() != SymbolType::Flag)
+			continue;
+
+		const uint32_t bit = uint32_t(1) << (s.getAddress() - 1);
+		switch (arch.symbols.name(s).back())
+		{
+		case 'c': _carry = bit; break;
+		case 'v': _overflow = bit; break;
+		case 'z': _zero = bit; break;
+		case 's': case 'n': _sign = bit; break;
+		case 'd': case 'i': _disable = bit; break;
+		}
+	}
+
+	buildFields();
+	buildTable();
+
+	_romSize = std::min<uint32_t>(rom.size(), MEMORY_SIZE);
+	_memory.assign(MEMORY_SIZE, 0);
+	rom.read(0, _memory.data(), _romSize);
+}
+
+void simulator::buildFields()
+{
+	std::vector<std::pair<uint32_t, std::string_view>> unparsed;
+
+	for (int i = 0; i < _arch.symbols.count(); i++)
+	{
+		const symbol& s = _arch.symbols.at(i);
+		const uint32_t value = static_cast<uint32_t>(s.getAddress());
+		if (s.getType() != SymbolType::ControlLine || value == 0)
+			continue;
+
+		lineMeaning m;
+		if (!parseLine(_arch.symbols.name(s), m))
+		{
+			unparsed.push_back({ value, _arch.symbols.name(s) });
+			continue;
+		}
+
+		// merge every field the line shares bits with
+		controlField field;
+		field.mask = value;
+		field.values.push_back(value);
+		field.meanings.push_back(m);
+
+		for (size_t f = 0; f < _fields.size(); )
+		{
+			if ((_fields[f].mask & value) != 0)
+			{
+				field.mask |= _fields[f].mask;
+				field.values.insert(field.values.end(), _fields[f].values.begin(), _fields[f].values.end());
+				field.meanings.insert(field.meanings.end(), _fields[f].meanings.begin(), _fields[f].meanings.end());
+				_fields.erase(_fields.begin() + f);
+			}
+			else
+			{
+				f++;
+			}
+		}
+
+		_fields.push_back(std::move(field));
+	}
+
+	// a line spanning several fields is a shorthand (like fetch), anything else is unknown
+	for (const auto& [value, name] : unparsed)
+	{
+		int touched = 0;
+		for (const controlField& f : _fields)
+			touched += (f.mask & value) != 0 ? 1 : 0;
+
+		if (touched <= 1)
+			_unknownLines.push_back(std::string(name));
+	}
+}
+
+microOp simulator::decode(uint32_t word) const
+{
+	microOp op;
+	for (const controlField& f : _fields)
+	{
+		const uint32_t v = word & f.mask;
+		if (v == 0)
+			continue;
+
+		for (size_t i = 0; i < f.values.size(); i++)
+		{
+			if (f.values[i] == v)
+			{
+				apply(f.meanings[i], op);
+				break;
+			}
+		}
+	}
+
+	return op;
+}
+
+void simulator::buildTable()
+{
+	const microcodeStore& microcode = _arch.microcode;
+
+	// one row per opcode with a spare cycle at the end, which is never defined
+	_flagBits = _arch.nFlags;
+	_cycleStride = microcode.maxCycles() + 1;
+	const size_t flagStates = size_t(1) << _flagBits;
+
+	microOp invalid;
+	invalid.valid = false;
+	_ops.assign(1, invalid);
+	_index.assign(256 * _cycleStride * flagStates, 0);
+
+	std::unordered_map<uint32_t, uint16_t> known;
+	for (int v = 0; v < std::min(microcode.limit(), 256); v++)
+	{
+		for (int c = 0; c < microcode.numCycles(v); c++)
+		{
+			const int cycle = microcode.firstCycle(v) + c;
+			for (uint32_t f = 0; f < flagStates; f++)
+			{
+				const uint32_t word = microcode.word(cycle, f);
+				auto it = known.find(word);
+				if (it == known.end())
+				{
+					// the index holds 16 bits, which keeps it small enough to stay in the cache
+					if (_ops.size() > UINT16_MAX)
+					{
+						std::stringstream msg;
+						msg << "Can not simulate more than " << UINT16_MAX << " distinct control words!";
+						throw std::runtime_error(msg.str());
+					}
+
+					it = known.emplace(word, static_cast<uint16_t>(_ops.size())).first;
+					_ops.push_back(decode(word));
+				}
+
+				_index[((static_cast<size_t>(v) * _cycleStride + c) << _flagBits) | f] = it->second;
+			}
+		}
+	}
+}
+
+uint8_t simulator::read8(SimUnit u, uint16_t address, bool high) const
+{
+	switch (u)
+	{
+	case SimUnit::A:
+	case SimUnit::B:
+	case SimUnit::C:
+	case SimUnit::DL:
+	case SimUnit::DH:
+	case SimUnit::IR:
+		return static_cast<uint8_t>(_reg[static_cast<int>(u)]);
+
+	// the 16 bit registers put their high byte on lhs and their low byte on rhs
+	case SimUnit::RA:
+	case SimUnit::PC:
+	case SimUnit::SP:
+	case SimUnit::WI:
+	case SimUnit::RI:
+	case SimUnit::AX:
+		return static_cast<uint8_t>(high ? _reg[static_cast<int>(u)] >> 8 : _reg[static_cast<int>(u)]);
+
+	// ah and al are the halves of whatever is on the address bus
+	case SimUnit::AH: return static_cast<uint8_t>(address >> 8);
+	case SimUnit::AL: return static_cast<uint8_t>(address);
+
+	default:
+		return 0;
+	}
+}
+
+uint16_t simulator::read16(SimUnit u) const
+{
+	switch (u)
+	{
+	case SimUnit::PC:
+	case SimUnit::SP:
+	case SimUnit::WI:
+	case SimUnit::RI:
+	case SimUnit::RA:
+	case SimUnit::AX:
+		return _reg[static_cast<int>(u)];
+
+	case SimUnit::DX:
+		return static_cast<uint16_t>((_reg[static_cast<int>(SimUnit::DH)] << 8) | _reg[static_cast<int>(SimUnit::DL)]);
+
+	default:
+		return 0;
+	}
+}
+
+uint8_t simulator::aluResult(AluOp op, uint8_t lhs, uint8_t rhs)
+{
+	unsigned result = 0;
+	bool carry = (_flags & _carry) != 0;
+	bool overflow = false;
+
+	auto add = [&](unsigned l, unsigned r, unsigned in)
+	{
+		result = l + r + in;
+		carry = result > 0xFF;
+		overflow = (~(l ^ r) & (l ^ result) & 0x80) != 0;
+	};
+
+	auto sub = [&](unsigned l, unsigned r, unsigned in)
+	{
+		result = l - r - in;
+		carry = l >= r + in;	// set when nothing was borrowed
+		overflow = ((l ^ r) & (l ^ result) & 0x80) != 0;
+	};
+
+	const unsigned n = rhs & 7;
+
+	switch (op)
+	{
+	case AluOp::PassLhs: return lhs;
+	case AluOp::PassRhs: return rhs;
+
+	case AluOp::Clc: _flags &= ~_carry; return lhs;
+	case AluOp::Sec: _flags |= _carry; return lhs;
+	case AluOp::Cid: _flags &= ~_disable; return lhs;
+	case AluOp::Sid: _flags |= _disable; return lhs;
+
+	case AluOp::IncLhs: add(lhs, 1, 0); break;
+	case AluOp::IncIncLhs: add(lhs, 1, 1); break;
+	case AluOp::DecLhs: sub(lhs, 1, 0); break;
+	case AluOp::DecDecLhs: sub(lhs, 1, 1); break;
+	case AluOp::Add: add(lhs, rhs, 0); break;
+	case AluOp::AddInc: add(lhs, rhs, 1); break;
+	case AluOp::Sub: sub(lhs, rhs, 0); break;
+	case AluOp::SubDec: sub(lhs, rhs, 1); break;
+
+	case AluOp::Shl0:
+	case AluOp::Shl1:
+		result = (lhs << 1) | (op == AluOp::Shl1 ? 1 : 0);
+		carry = (lhs & 0x80) != 0;
+		break;
+
+	case AluOp::Shr0:
+	case AluOp::Shr1:
+		result = (lhs >> 1) | (op == AluOp::Shr1 ? 0x80 : 0);
+		carry = (lhs & 1) != 0;
+		break;
+
+	// lhs shifted by rhs bits, filling with the carry variant of the op
+	case AluOp::Mshl0:
+	case AluOp::Mshl1:
+		result = (lhs << n) | (op == AluOp::Mshl1 ? (1u << n) - 1 : 0);
+		carry = n > 0 && ((lhs >> (8 - n)) & 1) != 0;
+		break;
+
+	case AluOp::Mshr0:
+	case AluOp::Mshr1:
+		result = (lhs >> n) | (op == AluOp::Mshr1 ? (0xFFu << (8 - n)) & 0xFF : 0);
+		carry = n > 0 && ((lhs >> (n - 1)) & 1) != 0;
+		break;
+
+	case AluOp::NotLhs: result = ~lhs; break;
+	case AluOp::And: result = lhs & rhs; break;
+	case AluOp::Or: result = lhs | rhs; break;
+	case AluOp::Xor: result = lhs ^ rhs; break;
+
+	case AluOp::MulLo:
+	case AluOp::MulHi:
+		result = lhs * rhs;
+		carry = result > 0xFF;
+		result = op == AluOp::MulHi ? result >> 8 : result;
+		break;
+
+	case AluOp::Div:
+	case AluOp::Mod:
+		carry = rhs == 0;
+		result = rhs == 0 ? 0xFF : (op == AluOp::Div ? lhs / rhs : lhs % rhs);
+		break;
+	}
+
+	result &= 0xFF;
+	_flags = (_flags & ~(_carry | _overflow | _zero | _sign)) | (carry ? _carry : 0) | (overflow ? _overflow : 0) |
+		(result == 0 ? _zero : 0) | ((result & 0x80) != 0 ? _sign : 0);
+
+	return static_cast<uint8_t>(result);
+}
+
+simResult simulator::run(uint64_t maxCycles)
+{
+	// every run starts from reset, with the rom as assembled and the ram cleared
+	std::fill(std::begin(_reg), std::end(_reg), 0);
+	std::fill(_memory.begin() + _romSize, _memory.end(), 0);
+	_flags = 0;
+	_opcodeCycles.assign(256, 0);
+	_deviceWrites.assign(MAX_DEVICES, 0);
+
+	simResult r;
+	auto start = std::chrono::steady_clock::now();
+
+	const uint16_t* index = _index.data();
+	const microOp* ops = _ops.data();
+	uint16_t* reg = _reg;
+	uint8_t* memory = _memory.data();
+
+	int cycle = 0;
+	uint16_t fetchPc = 0;
+
+	while (r.cycles < maxCycles)
+	{
+		const uint8_t ir = static_cast<uint8_t>(reg[static_cast<int>(SimUnit::IR)]);
+		const microOp& op = ops[index[((static_cast<size_t>(ir) * _cycleStride + cycle) << _flagBits) | _flags]];
+
+		if (!op.valid)
+		{
+			std::stringstream msg;
+			msg << "no microcode for opcode $" << hex2 << static_cast<int>(ir) << " cycle " << dec << cycle;
+			r.stopReason = msg.str();
+			break;
+		}
+
+		if (cycle == 0)
+			fetchPc = reg[static_cast<int>(SimUnit::PC)];
+
+		r.cycles++;
+
+		// the buses, as driven this cycle
+		const uint16_t address = read16(op.addrWriter);
+		const uint8_t lhs = read8(op.lhsWriter, address, true);
+		const uint8_t rhs = read8(op.rhsWriter, address, false);
+		const uint8_t alu = aluResult(op.alu, lhs, rhs);
+
+		uint8_t data = 0;
+		if (op.dataWriter == SimUnit::Mem)
+			data = memory[address];
+		else if (op.dataWriter == SimUnit::Alu)
+			data = alu;
+
+		// and everything that loads at the end of it
+		switch (op.dataReader)
+		{
+		case SimUnit::None: break;
+		case SimUnit::Device: _deviceWrites[op.readDevice]++; break;
+		default: reg[static_cast<int>(op.dataReader)] = data; break;
+		}
+
+		if (op.store && address >= _romSize)
+			memory[address] = data;
+
+		if (op.lrhsReader == SimUnit::DX)
+		{
+			reg[static_cast<int>(SimUnit::DH)] = lhs;
+			reg[static_cast<int>(SimUnit::DL)] = rhs;
+		}
+		else if (op.lrhsReader != SimUnit::None)
+		{
+			reg[static_cast<int>(op.lrhsReader)] = static_cast<uint16_t>((lhs << 8) | rhs);
+		}
+
+		if (op.raFromPc)
+			reg[static_cast<int>(SimUnit::RA)] = reg[static_cast<int>(SimUnit::PC)];
+
+		if (op.axFromAddr)
+			reg[static_cast<int>(SimUnit::AX)] = address;
+
+		if (op.incDec != SimUnit::None)
+			reg[static_cast<int>(op.incDec)] += op.decrement ? 0xFFFF : 1;
+
+		switch (op.pc)
+		{
+		case PcOp::None: break;
+		case PcOp::Inc: reg[static_cast<int>(SimUnit::PC)]++; break;
+		case PcOp::Dec: reg[static_cast<int>(SimUnit::PC)]--; break;
+		case PcOp::Rti: reg[static_cast<int>(SimUnit::PC)] = reg[static_cast<int>(SimUnit::RA)]; break;
+		}
+
+		// counted after the fetch has loaded ir, so the fetch goes to the instruction it fetched
+		_opcodeCycles[static_cast<uint8_t>(reg[static_cast<int>(SimUnit::IR)])]++;
+
+		if (!op.end)
+		{
+			cycle++;
+			continue;
+		}
+
+		cycle = 0;
+		r.instructions++;
+
+		if (reg[static_cast<int>(SimUnit::PC)] == fetchPc)
+		{
+			r.halted = true;
+			r.stopReason = "halted (jump to itself)";
+			break;
+		}
+	}
+
+	if (r.stopReason.empty())
+		r.stopReason = "cycle limit reached";
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	r.ms = elapsed.count();
+	r.pc = fetchPc;
+	return r;
+}
+
+std::string simulator::registers() const
+{
+	static const struct { const char* name; SimUnit unit; bool wide; } shown[] =
+	{
+		{ "a", SimUnit::A, false }, { "b", SimUnit::B, false }, { "c", SimUnit::C, false }, { "dl", SimUnit::DL, false },
+		{ "dh", SimUnit::DH, false }, { "pc", SimUnit::PC, true }, { "sp", SimUnit::SP, true }, { "wi", SimUnit::WI, true },
+		{ "ri", SimUnit::RI, true }, { "ra", SimUnit::RA, true },
+	};
+
+	std::stringstream out;
+	for (const auto& s : shown)
+	{
+		out << s.name << "=$";
+		if (s.wide)
+			out << hex4 << _reg[static_cast<int>(s.unit)] << " ";
+		else
+			out << hex2 << (_reg[static_cast<int>(s.unit)] & 0xFF) << " ";
+	}
+
+	// the last flag first, like the flag patterns of seq_if
+	out << "flags=";
+	for (int f = _arch.nFlags - 1; f >= 0; f--)
+		out << (((_flags >> f) & 1) != 0 ? '1' : '0');
+
+	return out.str();
+}
+
+void simulator::summary(const simResult& r) const
+{
+	const double seconds = r.ms / 1000.0;
+
+	logLine out;
+	out << "\nSimulated " << r.cycles << " cycles, " << r.instructions << " instructions";
+	if (r.instructions > 0)
+		out << " (" << std::fixed << std::setprecision(2) << static_cast<double>(r.cycles) / r.instructions << " cycles each)";
+
+	out << " in " << std::fixed << std::setprecision(2) << r.ms << " ms";
+	if (seconds > 0)
+		out << " (" << std::setprecision(1) << r.cycles / seconds / 1e6 << " M cycles/s)";
+
+	out << "\n  stopped at $" << hex4 << r.pc << " : " << r.stopReason << "\n";
+	out << "  " << registers() << "\n";
+
+	// where the cycles went
+	std::vector<int> busiest;
+	for (int v = 0; v < static_cast<int>(_opcodeCycles.size()); v++)
+	{
+		if (_opcodeCycles[v] > 0)
+			busiest.push_back(v);
+	}
+
+	std::sort(busiest.begin(), busiest.end(), [this](int x, int y) { return _opcodeCycles[x] > _opcodeCycles[y]; });
+	if (busiest.size() > 8)
+		busiest.resize(8);
+
+	for (int v : busiest)
+	{
+		const std::string mnemonic = v < static_cast<int>(_arch.opcodes.size()) ? _arch.opcodes[v].mnemonic() : std::string();
+		out << "  opcode $" << hex2 << v << " " << std::left << std::setfill(' ') << std::setw(8) << mnemonic << std::right << dec
+			<< _opcodeCycles[v] << " cycles\n";
+	}
+
+	for (int d = 0; d < static_cast<int>(_deviceWrites.size()); d++)
+	{
+		if (_deviceWrites[d] > 0)
+			out << "  device" << d << " : " << _deviceWrites[d] << " writes\n";
+	}
+
+	for (const std::string& name : _unknownLines)
+		out << "  WARNING: control line [" << name << "] has no meaning in the simulator\n";
+}
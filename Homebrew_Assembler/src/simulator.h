@@ -0,0 +1,152 @@
+#pragma once
+
+#include "architecture.h"
+#include "programrom.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The units a control line can name, as the first part of its name (a_read_data, _dx_write_addr)
+enum class SimUnit : uint8_t
+{
+	None, A, B, C, DL, DH, IR, PC, SP, WI, RI, RA, AX, DX, AH, AL, Mem, Alu, Int, Device,
+	Count
+};
+
+enum class AluOp : uint8_t
+{
+	PassLhs, PassRhs, IncLhs, IncIncLhs, DecLhs, DecDecLhs, Shl0, Shl1, Shr0, Shr1,
+	Mshl0, Mshl1, Mshr0, Mshr1, NotLhs, And, Or, Xor, Add, AddInc, Sub, SubDec,
+	MulLo, MulHi, Div, Mod, Clc, Sec, Cid, Sid
+};
+
+enum class PcOp : uint8_t { None, Inc, Dec, Rti };
+
+// One control word, decoded once: what drives and reads each bus, what the alu does, and what
+// happens to the counters. The simulator runs on these and never looks at control bits.
+class microOp
+{
+public:
+	SimUnit dataWriter = SimUnit::None;
+	SimUnit dataReader = SimUnit::None;
+	SimUnit lhsWriter = SimUnit::None;
+	SimUnit rhsWriter = SimUnit::None;
+	SimUnit lrhsReader = SimUnit::None;
+	SimUnit addrWriter = SimUnit::None;
+	uint8_t writeDevice = 0;	// when a device drives or reads the data bus
+	uint8_t readDevice = 0;
+	SimUnit incDec = SimUnit::None;
+	bool decrement = false;
+	PcOp pc = PcOp::None;
+	AluOp alu = AluOp::PassLhs;
+	bool store = false;			// memory reads the data bus
+	bool raFromPc = false;
+	bool axFromAddr = false;
+	bool end = false;			// end of the instruction (back to cycle 0)
+	bool valid = true;			// false for cycles no opcode defines
+};
+
+// What a run did, and why it stopped
+class simResult
+{
+public:
+	uint64_t cycles = 0;
+	uint64_t instructions = 0;
+	double ms = 0;
+	bool halted = false;		// an instruction jumped to itself
+	std::string stopReason;
+	uint16_t pc = 0;
+};
+
+// Runs a program rom on the machine its architecture describes, one clock cycle at a time.
+//
+// Control lines mean what their names say, in the convention of homebrew.arch: unit_write_bus
+// drives a bus (data, lhs, rhs or addr), unit_read_bus loads from one (lrhs is lhs:rhs), alu_op
+// picks the alu operation, reg_inc / reg_dec count, pc_inc / pc_dec / pc_rti move the program
+// counter, ra_read saves the pc in ra, and tcuEndSeq ends the instruction (a leading _ only marks
+// an active-low line). The fields are found from the line values -- lines whose bits overlap
+// share a field -- and every (opcode, cycle, flag state) is decoded into a microOp up front, so
+// the inner loop is a table lookup and a few switches. Memory is the program rom from address 0
+// up, and ram above it; device reads return 0 and device writes are counted.
+class simulator
+{
+public:
+	simulator(const architecture& arch, const programImage& rom);
+
+	// Runs until an instruction jumps to itself, something undefined runs, or maxCycles
+	simResult run(uint64_t maxCycles);
+
+	// Cycles spent in each opcode (by value) during the last run
+	const std::vector<uint64_t>& opcodeCycles() const { return _opcodeCycles; }
+	const std::vector<uint64_t>& deviceWrites() const { return _deviceWrites; }
+
+	// The registers as text (a=$00 b=$00 ... flags=xxxxx)
+	std::string registers() const;
+
+	// Logs the cycle counts of a run, the busiest opcodes and the registers
+	void summary(const simResult& r) const;
+
+	// Control lines the simulator does not know the meaning of (ignored when they are set)
+	const std::vector<std::string>& unknownLines() const { return _unknownLines; }
+
+private:
+	enum class LineRole : uint8_t { DataWriter, DataReader, LhsWriter, RhsWriter, LrhsReader, AddrWriter, AddrReader, IncDec, Pc, Alu, RaRead, End };
+
+	// What one control line means, parsed from its name
+	class lineMeaning
+	{
+	public:
+		LineRole role = LineRole::End;
+		SimUnit unit = SimUnit::None;
+		uint8_t device = 0;
+		AluOp alu = AluOp::PassLhs;
+		PcOp pc = PcOp::None;
+		bool decrement = false;
+	};
+
+	// Lines that share bits -- a field of the control word holds one of them at a time
+	class controlField
+	{
+	public:
+		uint32_t mask = 0;
+		std::vector<uint32_t> values;
+		std::vector<lineMeaning> meanings;
+	};
+
+	static bool parseLine(std::string_view name, lineMeaning& m);
+	static void apply(const lineMeaning& m, microOp& op);
+
+	void buildFields();
+	microOp decode(uint32_t word) const;
+	void buildTable();
+	uint8_t aluResult(AluOp op, uint8_t lhs, uint8_t rhs);
+
+	uint8_t read8(SimUnit u, uint16_t address, bool high) const;
+	uint16_t read16(SimUnit u) const;
+
+private:
+	const architecture& _arch;
+
+	std::vector<controlField> _fields;
+	std::vector<std::string> _unknownLines;
+
+	// microOp index for every (opcode, cycle, flag state), and the distinct microOps
+	int _cycleStride = 0;
+	int _flagBits = 0;
+	std::vector<uint16_t> _index;
+	std::vector<microOp> _ops;
+
+	// flag bits by meaning (0 if the architecture has no such flag)
+	uint32_t _carry = 0, _overflow = 0, _zero = 0, _sign = 0, _disable = 0;
+
+	// machine state
+	uint16_t _reg[static_cast<int>(SimUnit::Count)] = {};
+	uint32_t _flags = 0;
+	std::vector<uint8_t> _memory;
+	uint32_t _romSize = 0;
+
+	std::vector<uint64_t> _opcodeCycles;
+	std::vector<uint64_t> _deviceWrites;
+};
@@ -0,0 +1,259 @@
+#include "sourcefile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+sourceFile& sourceFile::operator=(sourceFile&& donor) noexcept
+{
+	if (this != &donor)
+	{
+		close();
+
+		_filename = std::move(donor._filename);
+		_data = donor._data;
+		_size = donor._size;
+		_cursor = donor._cursor;
+		_open = donor._open;
+		_fileHandle = donor._fileHandle;
+		_mapHandle = donor._mapHandle;
+
+		donor._data = nullptr;
+		donor._size = 0;
+		donor._cursor = 0;
+		donor._open = false;
+		donor._fileHandle = nullptr;
+		donor._mapHandle = nullptr;
+	}
+
+	return *this;
+}
+
+void sourceFile::open(const std::string& filename)
+{
+	close();
+
+	std::stringstream msg;
+	msg << "Unable to open source file [" << filename << "]!";
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error(msg.str());
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		throw std::runtime_error(msg.str());
+	}
+
+	_fileHandle = file;
+	_size = static_cast<size_t>(size.QuadPart);
+
+	// zero-length files cannot be mapped, they simply have no lines
+	if (_size > 0)
+	{
+		HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		const void* view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (view == nullptr)
+		{
+			if (map) CloseHandle(map);
+			CloseHandle(file);
+			_fileHandle = nullptr;
+			_size = 0;
+			throw std::runtime_error(msg.str());
+		}
+
+		_mapHandle = map;
+		_data = static_cast<const char*>(view);
+	}
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error(msg.str());
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		throw std::runtime_error(msg.str());
+	}
+
+	_size = static_cast<size_t>(st.st_size);
+
+	// zero-length files cannot be mapped, they simply have no lines
+	if (_size > 0)
+	{
+		void* view = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			::close(fd);
+			_size = 0;
+			throw std::runtime_error(msg.str());
+		}
+
+		madvise(view, _size, MADV_SEQUENTIAL);
+		_data = static_cast<const char*>(view);
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	::close(fd);
+#endif
+
+	_filename = filename;
+	_cursor = 0;
+	_open = true;
+}
+
+void sourceFile::close()
+{
+	if (!_open)
+		return;
+
+#ifdef _WIN32
+	if (_data) UnmapViewOfFile(_data);
+	if (_mapHandle) CloseHandle(_mapHandle);
+	if (_fileHandle) CloseHandle(_fileHandle);
+#else
+	if (_data) munmap(const_cast<char*>(_data), _size);
+#endif
+
+	_data = nullptr;
+	_size = 0;
+	_cursor = 0;
+	_open = false;
+	_fileHandle = nullptr;
+	_mapHandle = nullptr;
+}
+
+bool sourceFile::line_at(size_t& offset, std::string_view& line) const
+{
+	if (offset >= _size)
+		return false;
+
+	const char* begin = _data + offset;
+	const char* end = static_cast<const char*>(memchr(begin, '\n', _size - offset));
+
+	size_t length = end ? static_cast<size_t>(end - begin) : _size - offset;
+	offset += end ? length + 1 : length;
+
+	// tolerate CRLF line endings
+	if (length > 0 && begin[length - 1] == '\r')
+		length--;
+
+	line = std::string_view(begin, length);
+	return true;
+}
+
+outputFile& outputFile::operator=(outputFile&& donor) noexcept
+{
+	if (this != &donor)
+	{
+		close();
+
+		_filename = std::move(donor._filename);
+		_data = donor._data;
+		_size = donor._size;
+		_open = donor._open;
+		_fileHandle = donor._fileHandle;
+		_mapHandle = donor._mapHandle;
+
+		donor._data = nullptr;
+		donor._size = 0;
+		donor._open = false;
+		donor._fileHandle = nullptr;
+		donor._mapHandle = nullptr;
+	}
+
+	return *this;
+}
+
+void outputFile::create(const std::string& filename, size_t size)
+{
+	close();
+
+	std::stringstream msg;
+	msg << "Unable to write file [" << filename << "]!";
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error(msg.str());
+
+	_fileHandle = file;
+
+	// an empty file is created, but there is nothing to map
+	if (size > 0)
+	{
+		const uint64_t wide = size;
+		HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(wide >> 32), static_cast<DWORD>(wide), nullptr);
+		void* view = map ? MapViewOfFile(map, FILE_MAP_WRITE, 0, 0, size) : nullptr;
+		if (view == nullptr)
+		{
+			if (map) CloseHandle(map);
+			CloseHandle(file);
+			_fileHandle = nullptr;
+			throw std::runtime_error(msg.str());
+		}
+
+		_mapHandle = map;
+		_data = static_cast<char*>(view);
+	}
+#else
+	int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		throw std::runtime_error(msg.str());
+
+	if (size > 0)
+	{
+		void* view = ftruncate(fd, static_cast<off_t>(size)) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+		if (view == MAP_FAILED)
+		{
+			::close(fd);
+			throw std::runtime_error(msg.str());
+		}
+
+		_data = static_cast<char*>(view);
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	::close(fd);
+#endif
+
+	_filename = filename;
+	_size = size;
+	_open = true;
+}
+
+void outputFile::close()
+{
+	if (!_open)
+		return;
+
+#ifdef _WIN32
+	if (_data) UnmapViewOfFile(_data);
+	if (_mapHandle) CloseHandle(_mapHandle);
+	if (_fileHandle) CloseHandle(_fileHandle);
+#else
+	if (_data) munmap(_data, _size);
+#endif
+
+	_data = nullptr;
+	_size = 0;
+	_open = false;
+	_fileHandle = nullptr;
+	_mapHandle = nullptr;
+}
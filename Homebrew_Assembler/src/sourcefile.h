@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// A read-only, memory-mapped view of a source file. Lines are handed out as
+// std::string_view spans directly into the mapping, so nothing is copied
+// between the disk cache and the tokenizer.
+class sourceFile
+{
+public:
+	sourceFile() = default;
+	explicit sourceFile(const std::string& filename) { open(filename); }
+	~sourceFile() { close(); }
+
+	sourceFile(const sourceFile&) = delete;
+	sourceFile& operator=(const sourceFile&) = delete;
+
+	sourceFile(sourceFile&& donor) noexcept { *this = std::move(donor); }
+	sourceFile& operator=(sourceFile&& donor) noexcept;
+
+	void open(const std::string& filename);
+	void close();
+
+	bool is_open() const { return _open; }
+	const std::string& filename() const { return _filename; }
+
+	// The whole mapped file
+	std::string_view text() const { return std::string_view(_data, _size); }
+
+	// Line cursor -- returns the next line (without the line terminator) and
+	// advances, or false once the end of the mapping is reached
+	bool next_line(std::string_view& line) { return line_at(_cursor, line); }
+
+	// Same as above, but with a caller-owned cursor so several readers can share the mapping
+	bool line_at(size_t& offset, std::string_view& line) const;
+	size_t offset() const { return _cursor; }
+	void seek(size_t offset) { _cursor = offset < _size ? offset : _size; }
+
+private:
+	std::string _filename;
+	const char* _data = nullptr;
+	size_t _size = 0;
+	size_t _cursor = 0;
+	bool _open = false;
+
+	// platform mapping handles
+	void* _fileHandle = nullptr;
+	void* _mapHandle = nullptr;
+};
+
+// A writable, memory-mapped file whose size is fixed when it is created. Output that can be
+// sized up front is formatted straight into the mapping, without a stream or buffer in between.
+class outputFile
+{
+public:
+	outputFile() = default;
+	outputFile(const std::string& filename, size_t size) { create(filename, size); }
+	~outputFile() { close(); }
+
+	outputFile(const outputFile&) = delete;
+	outputFile& operator=(const outputFile&) = delete;
+
+	outputFile(outputFile&& donor) noexcept { *this = std::move(donor); }
+	outputFile& operator=(outputFile&& donor) noexcept;
+
+	// Creates (or truncates) the file and maps all size bytes of it
+	void create(const std::string& filename, size_t size);
+	void close();
+
+	bool is_open() const { return _open; }
+	const std::string& filename() const { return _filename; }
+
+	char* data() { return _data; }
+	size_t size() const { return _size; }
+
+private:
+	std::string _filename;
+	char* _data = nullptr;
+	size_t _size = 0;
+	bool _open = false;
+
+	// platform mapping handles
+	void* _fileHandle = nullptr;
+	void* _mapHandle = nullptr;
+};
@@ -0,0 +1,99 @@
+#include "symboltable.h"
+#include "util.h"
+
+#include <algorithm>
+
+// multiplying by an odd constant scatters the (mostly sequential) name ids over the table
+static size_t idHash(int nameId)
+{
+	return static_cast<size_t>(static_cast<uint32_t>(nameId) * 2654435769u);
+}
+
+symbolTable::symbolTable(std::pmr::memory_resource* resource)
+	:
+	_resource(resource),
+	_names(resource),
+	_symbols(resource),
+	_slots(resource)
+{
+	for (int i = 0; i < KINDS; i++)
+		_addresses.emplace_back(resource);
+}
+
+size_t symbolTable::findSlot(int nameId) const
+{
+	const size_t mask = _slots.size() - 1;
+	for (size_t i = idHash(nameId) & mask; ; i = (i + 1) & mask)
+	{
+		const int index = _slots[i];
+		if (index == -1 || _symbols[index].getName() == nameId)
+			return i;
+	}
+}
+
+bool symbolTable::add(std::string_view name, SymbolType t, int address, int line)
+{
+	// keep the table at most half full
+	if ((_symbols.size() + 1) * 2 > _slots.size())
+		grow();
+
+	const int nameId = _names.intern(name);
+	const size_t slot = findSlot(nameId);
+	if (_slots[slot] != -1)
+		return false;
+
+	switch (t)
+	{
+	case SymbolType::Constant: _symbols.push_back(symbol::makeConstant(nameId, address, line)); break;
+	case SymbolType::Variable: _symbols.push_back(symbol::makeVariable(nameId, address, line)); break;
+	case SymbolType::Label: _symbols.push_back(symbol::makeLabel(nameId, address, line)); break;
+	case SymbolType::Register: _symbols.push_back(symbol::makeRegister(nameId, address, line)); break;
+	case SymbolType::Flag: _symbols.push_back(symbol::makeFlag(nameId, address, line)); break;
+	case SymbolType::ControlLine: _symbols.push_back(symbol::makeControlLine(nameId, address, line)); break;
+	default: return false;
+	}
+
+	_slots[slot] = static_cast<int>(_symbols.size()) - 1;
+	_addresses[static_cast<int>(t)].push_back(address);
+
+	return true;
+}
+
+const symbol* symbolTable::find(int nameId) const
+{
+	if (nameId == stringPool::NONE || _slots.empty())
+		return nullptr;
+
+	const int index = _slots[findSlot(nameId)];
+	return index != -1 ? &_symbols[index] : nullptr;
+}
+
+const symbol* symbolTable::find(std::string_view name) const
+{
+	return find(_names.find(name));
+}
+
+void symbolTable::clear()
+{
+	_names.clear();
+	resetVector(_symbols, _resource);
+	resetVector(_slots, _resource);
+
+	for (std::pmr::vector<int>& addresses : _addresses)
+		resetVector(addresses, _resource);
+}
+
+void symbolTable::grow()
+{
+	_slots.assign(_slots.empty() ? 64 : _slots.size() * 2, -1);
+
+	const size_t mask = _slots.size() - 1;
+	for (int index = 0; index < static_cast<int>(_symbols.size()); index++)
+	{
+		size_t i = idHash(_symbols[index].getName()) & mask;
+		while (_slots[i] != -1)
+			i = (i + 1) & mask;
+
+		_slots[i] = index;
+	}
+}
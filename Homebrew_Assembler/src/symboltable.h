@@ -0,0 +1,52 @@
+#pragma once
+
+#include "intern.h"
+#include "symbol.h"
+
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// All symbols of one assembly. Names are interned, and the symbols are kept densely in definition
+// order and found through an open-addressing table keyed by the interned name id, so a lookup is
+// one string hash plus one probe into a flat array. The per-kind address lists are kept up to
+// date as symbols are added. Everything is allocated from the given memory resource.
+class symbolTable
+{
+public:
+	explicit symbolTable(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+	// Adds a symbol -- returns false (and keeps the first definition) if the name already exists
+	bool add(std::string_view name, SymbolType t, int address, int line);
+
+	// The id a name has (or will have) in this table, whether or not a symbol is defined for it yet
+	int nameId(std::string_view name) { return _names.intern(name); }
+
+	// nullptr if there is no such symbol
+	const symbol* find(std::string_view name) const;
+	const symbol* find(int nameId) const;
+
+	std::string_view name(const symbol& s) const { return _names.name(s.getName()); }
+	std::string_view name(int nameId) const { return _names.name(nameId); }
+	const std::pmr::vector<int>& addresses(SymbolType t) const { return _addresses[static_cast<int>(t)]; }
+	int count() const { return static_cast<int>(_symbols.size()); }
+
+	// in definition order, 0 .. count()-1
+	const symbol& at(int i) const { return _symbols[i]; }
+
+	// Forgets every symbol and returns all storage to the memory resource
+	void clear();
+
+private:
+	size_t findSlot(int nameId) const;
+	void grow();
+
+private:
+	static constexpr int KINDS = static_cast<int>(SymbolType::ControlLine) + 1;
+
+	std::pmr::memory_resource* _resource;
+	stringPool _names;
+	std::pmr::vector<symbol> _symbols;
+	std::pmr::vector<int> _slots;		// index into _symbols, or -1 for an empty slot
+	std::vector<std::pmr::vector<int>> _addresses;	// indexed by SymbolType
+};
@@ -0,0 +1,136 @@
+#include "threadpool.h"
+
+// the pool a thread works for, and its index there (-1 for any other thread)
+static thread_local const threadPool* t_pool = nullptr;
+static thread_local int t_index = -1;
+
+threadPool::threadPool(unsigned threads)
+{
+	if (threads == 0)
+		threads = 1;
+
+	for (unsigned i = 0; i < threads; i++)
+		_local.push_back(std::make_unique<taskQueue>());
+
+	for (unsigned i = 0; i < threads; i++)
+		_threads.emplace_back(&threadPool::worker, this, static_cast<int>(i));
+}
+
+threadPool::~threadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stopping = true;
+	}
+
+	_wake.notify_all();
+
+	for (std::thread& t : _threads)
+		t.join();
+}
+
+bool threadPool::onWorker() const
+{
+	return t_pool == this;
+}
+
+void threadPool::push(std::function<void()> task)
+{
+	taskQueue& queue = t_pool == this ? *_local[t_index] : _shared;
+
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(std::move(task));
+	}
+
+	_queued.fetch_add(1, std::memory_order_release);
+
+	// taking the lock makes sure a worker about to sleep sees the new task
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+	}
+	_wake.notify_one();
+}
+
+bool threadPool::pop(std::function<void()>& task, bool shared)
+{
+	if (_queued.load(std::memory_order_acquire) == 0)
+		return false;
+
+	const int self = t_pool == this ? t_index : -1;
+
+	// own tasks first, newest first
+	if (self >= 0)
+	{
+		taskQueue& own = *_local[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	if (shared)
+	{
+		std::lock_guard<std::mutex> lock(_shared.mutex);
+		if (!_shared.tasks.empty())
+		{
+			task = std::move(_shared.tasks.front());
+			_shared.tasks.pop_front();
+			_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// steal the oldest task of another worker, starting with the next one along
+	const size_t n = _local.size();
+	for (size_t i = 1; i <= n; i++)
+	{
+		const size_t victim = (static_cast<size_t>(self + 1) + i - 1) % n;
+		if (static_cast<int>(victim) == self)
+			continue;
+
+		taskQueue& other = *_local[victim];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		if (!other.tasks.empty())
+		{
+			task = std::move(other.tasks.front());
+			other.tasks.pop_front();
+			_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool threadPool::runOne(bool shared)
+{
+	std::function<void()> task;
+	if (!pop(task, shared))
+		return false;
+
+	task();
+	return true;
+}
+
+void threadPool::worker(int index)
+{
+	t_pool = this;
+	t_index = index;
+
+	for (;;)
+	{
+		if (runOne(true))
+			continue;
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_wake.wait(lock, [this]() { return _stopping || _queued.load(std::memory_order_acquire) != 0; });
+
+		if (_stopping && _queued.load(std::memory_order_acquire) == 0)
+			return;
+	}
+}
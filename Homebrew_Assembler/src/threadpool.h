@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed-size, work-stealing pool of worker threads shared by the whole process. Every worker
+// has a deque of its own: tasks a worker submits go to the back of its deque and it takes them
+// back from there (newest first, while their data is still in cache), tasks from any other thread
+// go to a shared queue, and a worker that runs dry steals the oldest task of another worker.
+class threadPool
+{
+public:
+	// singleton
+	static threadPool& instance()
+	{
+		static threadPool _instance;
+		return _instance;
+	}
+
+	explicit threadPool(unsigned threads = std::thread::hardware_concurrency());
+	~threadPool();
+
+	threadPool(const threadPool&) = delete;
+	threadPool& operator=(const threadPool&) = delete;
+
+	unsigned size() const { return static_cast<unsigned>(_threads.size()); }
+
+	// Queue a task and get a future for its result
+	template <class f>
+	auto submit(f&& task) -> std::future<decltype(task())>
+	{
+		using result = decltype(task());
+
+		auto packaged = std::make_shared<std::packaged_task<result()>>(std::forward<f>(task));
+		std::future<result> future = packaged->get_future();
+
+		push([packaged]() { (*packaged)(); });
+		return future;
+	}
+
+	// Waits for a future. A worker runs other queued tasks in the meantime, so a task can wait on
+	// tasks it submitted itself without holding up a worker (or deadlocking a busy pool); it only
+	// helps with tasks submitted by workers though, never with new top-level ones from the shared
+	// queue, so what it waits for is not held up behind a whole unrelated job. Any other thread
+	// simply blocks.
+	template <class r>
+	void wait(const std::future<r>& future)
+	{
+		if (!onWorker())
+		{
+			future.wait();
+			return;
+		}
+
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			if (!runOne(false))
+				future.wait_for(std::chrono::microseconds(100));
+		}
+	}
+
+private:
+	class taskQueue
+	{
+	public:
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	bool onWorker() const;
+	void push(std::function<void()> task);
+	bool pop(std::function<void()>& task, bool shared);
+	bool runOne(bool shared);
+	void worker(int index);
+
+private:
+	std::vector<std::unique_ptr<taskQueue>> _local;
+	taskQueue _shared;
+	std::atomic<size_t> _queued{ 0 };
+
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	bool _stopping = false;
+};
@@ -0,0 +1,378 @@
+#include "timing.h"
+#include "config.h"
+#include "logger.h"
+#include "util.h"
+
+#include <algorithm>
+#include <climits>
+
+std::string cycleRange::str() const
+{
+	return min == max ? std::to_string(max) : std::to_string(min) + "-" + std::to_string(max);
+}
+
+static bool hasValue(const opcode& oc)
+{
+	for (int a = 0; a < oc.numArgs(); a++)
+	{
+		const ArgType t = oc.getArg(a)._type;
+		if (t == ArgType::Numeral || t == ArgType::Ascii)
+			return true;
+	}
+
+	return false;
+}
+
+cycleAnalyzer::cycleAnalyzer(const architecture& arch)
+	:
+	_arch(arch)
+{
+	// the end of sequence line, and every line sharing its field
+	uint32_t endValue = 0;
+	for (int i = 0; i < arch.symbols.count(); i++)
+	{
+		const symbol& s = arch.symbols.at(i);
+		std::string_view name = arch.symbols.name(s);
+		while (!name.empty() && name.front() == '_')
+			name.remove_prefix(1);
+
+		if (s.getType() == SymbolType::ControlLine && name == END_SEQ_LINE)
+			endValue = static_cast<uint32_t>(s.getAddress());
+	}
+
+	uint32_t endMask = 0;
+	for (int i = 0; i < arch.symbols.count() && endValue != 0; i++)
+	{
+		const symbol& s = arch.symbols.at(i);
+		const uint32_t value = static_cast<uint32_t>(s.getAddress());
+		if (s.getType() == SymbolType::ControlLine && (value & endValue) != 0)
+			endMask |= value;
+	}
+
+	const microcodeStore& mc = arch.microcode;
+	const uint32_t states = uint32_t(1) << arch.nFlags;
+
+	_opcodeCycles.assign(std::max<size_t>(mc.limit(), arch.opcodes.size()), cycleRange());
+	for (int v = 0; v < mc.limit(); v++)
+	{
+		const int n = mc.numCycles(v);
+		if (n == 0)
+			continue;
+
+		cycleRange r{ INT_MAX, 0 };
+		for (uint32_t s = 0; s < states; s++)
+		{
+			int length = n;
+			for (int c = 0; c < n && endValue != 0; c++)
+			{
+				if ((mc.word(mc.firstCycle(v) + c, s) & endMask) == endValue)
+				{
+					length = c + 1;
+					break;
+				}
+			}
+
+			r.min = std::min<int64_t>(r.min, length);
+			r.max = std::max<int64_t>(r.max, length);
+		}
+
+		_opcodeCycles[v] = r;
+	}
+
+	auto flow = [](const opcode& oc)
+	{
+		const std::string mnemonic = oc.mnemonic();
+		if (mnemonic == RETURN_MNEMONIC)
+			return Flow::Return;
+
+		const bool call = mnemonic == CALL_MNEMONIC;
+		if (!call && (mnemonic.empty() || mnemonic.front() != JUMP_PREFIX))
+			return Flow::Next;
+
+		if (!hasValue(oc))
+			return Flow::Indirect;
+
+		return call ? Flow::Call : mnemonic == JUMP_MNEMONIC ? Flow::Jump : Flow::Branch;
+	};
+
+	for (const opcode& oc : arch.opcodes)
+		_opcodeFlow.push_back(flow(oc));
+
+	for (const opcode& oc : arch.opcodeAliases)
+		_aliasFlow.push_back(flow(oc));
+}
+
+cycleAnalyzer::Flow cycleAnalyzer::flowOf(const programInstruction& i) const
+{
+	const std::vector<Flow>& flows = i.alias ? _aliasFlow : _opcodeFlow;
+	return i.value < static_cast<int>(flows.size()) ? flows[i.value] : Flow::Next;
+}
+
+uint32_t cycleAnalyzer::targetOf(const programInstruction& i, const programImage& rom) const
+{
+	uint8_t field[8] = {};
+	const int bytes = std::min<int>(i.targetBytes, 4);
+	rom.read(i.address + std::max(_arch.instructionWidth, 1), field, bytes);
+
+	uint32_t target = 0;
+	for (int b = 0; b < bytes; b++)
+		target |= static_cast<uint32_t>(field[b]) << (8 * b);
+
+	return target;
+}
+
+void cycleAnalyzer::analyze(const std::pmr::vector<programInstruction>& code, const programImage& rom, const symbolTable& symbols)
+{
+	_code.assign(code.begin(), code.end());
+	std::stable_sort(_code.begin(), _code.end(), [](const programInstruction& x, const programInstruction& y) { return x.address < y.address; });
+
+	const int n = static_cast<int>(_code.size());
+	_at.clear();
+	for (int i = 0; i < n; i++)
+		_at[_code[i].address] = i;
+
+	_labels.clear();
+	for (int s = 0; s < symbols.count(); s++)
+	{
+		if (symbols.at(s).getType() == SymbolType::Label)
+			_labels.push_back({ static_cast<uint32_t>(symbols.at(s).getAddress()), symbols.name(symbols.at(s)) });
+	}
+
+	std::stable_sort(_labels.begin(), _labels.end(), [](const auto& x, const auto& y) { return x.first < y.first; });
+
+	// jump and call targets, by instruction (-1 when there is no code there)
+	std::vector<int> target(n, -1);
+	std::vector<char> leader(n, 0);
+	if (n > 0)
+		leader[0] = 1;
+
+	for (const auto& label : _labels)
+	{
+		auto it = _at.find(label.first);
+		if (it != _at.end())
+			leader[it->second] = 1;
+	}
+
+	for (int i = 0; i < n; i++)
+	{
+		const Flow f = flowOf(_code[i]);
+		if (f == Flow::Jump || f == Flow::Branch || f == Flow::Call)
+		{
+			auto it = _at.find(targetOf(_code[i], rom));
+			if (it != _at.end())
+			{
+				target[i] = it->second;
+				leader[it->second] = 1;
+			}
+		}
+
+		// control leaves the block, or the code does not go on from here
+		if (i + 1 < n && (f == Flow::Jump || f == Flow::Branch || f == Flow::Return || f == Flow::Indirect ||
+			_code[i + 1].address != _code[i].address + _code[i].size))
+			leader[i + 1] = 1;
+	}
+
+	_blocks.clear();
+	_blockOf.assign(n, -1);
+	for (int i = 0; i < n; i++)
+	{
+		if (leader[i])
+		{
+			_blocks.emplace_back();
+			_blocks.back().first = i;
+		}
+
+		block& b = _blocks.back();
+		b.count++;
+		b.cycles.add(_opcodeCycles[_code[i].value]);
+		_blockOf[i] = static_cast<int>(_blocks.size()) - 1;
+	}
+
+	for (block& b : _blocks)
+	{
+		for (int i = b.first; i < b.first + b.count; i++)
+		{
+			if (flowOf(_code[i]) != Flow::Call)
+				continue;
+
+			if (target[i] == -1)
+				b.indirect = true;
+			else
+				b.callees.push_back(_blockOf[target[i]]);
+		}
+
+		const int last = b.first + b.count - 1;
+		const bool falls = last + 1 < n && _code[last + 1].address == _code[last].address + _code[last].size;
+
+		switch (flowOf(_code[last]))
+		{
+		case Flow::Next:
+		case Flow::Call:
+			if (falls)
+				b.next.push_back(_blockOf[last + 1]);
+			break;
+
+		case Flow::Branch:
+			if (falls)
+				b.next.push_back(_blockOf[last + 1]);
+			[[fallthrough]];
+
+		case Flow::Jump:
+			// a jmp to itself halts
+			if (target[last] == -1)
+				b.indirect = true;
+			else if (target[last] != last || flowOf(_code[last]) == Flow::Branch)
+				b.next.push_back(_blockOf[target[last]]);
+			break;
+
+		case Flow::Indirect:
+			b.indirect = true;
+			break;
+
+		case Flow::Return:
+			break;
+		}
+	}
+}
+
+void cycleAnalyzer::solve(int root)
+{
+	if (_blocks[root].state == 2)
+		return;
+
+	// depth first, without recursion (the code can be one long chain of blocks)
+	std::vector<std::pair<int, size_t>> stack;
+	stack.push_back({ root, 0 });
+	_blocks[root].state = 1;
+
+	while (!stack.empty())
+	{
+		const int b = stack.back().first;
+		const size_t k = stack.back().second++;
+		block& current = _blocks[b];
+
+		if (k < current.callees.size() + current.next.size())
+		{
+			const int d = k < current.callees.size() ? current.callees[k] : current.next[k - current.callees.size()];
+			if (_blocks[d].state == 0)
+			{
+				_blocks[d].state = 1;
+				stack.push_back({ d, 0 });
+			}
+			else if (_blocks[d].state == 1 && current.bounded)
+			{
+				current.bounded = false;
+				current.loopAt = _code[_blocks[d].first].address;
+			}
+
+			continue;
+		}
+
+		// every block it depends on is done
+		if (current.indirect && current.bounded)
+		{
+			current.bounded = false;
+			current.loopAt = _code[current.first + current.count - 1].address;
+		}
+
+		int64_t worst = current.cycles.max;
+		for (int c : current.callees)
+		{
+			worst += _blocks[c].worst;
+			if (!_blocks[c].bounded && current.bounded)
+			{
+				current.bounded = false;
+				current.loopAt = _blocks[c].loopAt;
+			}
+		}
+
+		int64_t after = 0;
+		for (int d : current.next)
+		{
+			after = std::max(after, _blocks[d].worst);
+			if (!_blocks[d].bounded && current.bounded)
+			{
+				current.bounded = false;
+				current.loopAt = _blocks[d].loopAt;
+			}
+		}
+
+		current.worst = current.bounded ? worst + after : 0;
+		current.state = 2;
+		stack.pop_back();
+	}
+}
+
+bool cycleAnalyzer::worstCase(uint32_t address, int64_t& cycles, uint32_t& loopAt)
+{
+	auto it = _at.find(address);
+	if (it == _at.end())
+	{
+		loopAt = address;
+		return false;
+	}
+
+	const int b = _blockOf[it->second];
+	solve(b);
+
+	cycles = _blocks[b].worst;
+	loopAt = _blocks[b].loopAt;
+	return _blocks[b].bounded;
+}
+
+void cycleAnalyzer::listing(const std::function<std::string(const sourceLocation&)>& where)
+{
+	LOG(LogLevel::MajorTasks) << "\nCycle analysis : " << _code.size() << " instruction(s) in " << _blocks.size() << " block(s)\n";
+
+	if (logEnabled(LogLevel::ParsedMajor))
+	{
+		for (const block& b : _blocks)
+		{
+			logLine out;
+			out << "  block $" << hex4 << _code[b.first].address << dec << " : " << b.count << " instruction(s), " << b.cycles.str() << " cycles\n";
+
+			for (int i = b.first; i < b.first + b.count && logEnabled(LogLevel::ParsedMinor); i++)
+			{
+				const programInstruction& pi = _code[i];
+				const std::pmr::vector<opcode>& opcodes = pi.alias ? _arch.opcodeAliases : _arch.opcodes;
+				const std::string mnemonic = pi.value < static_cast<int>(opcodes.size()) ? opcodes[pi.value].mnemonic() : std::string();
+
+				out << "          $" << hex4 << pi.address << "  " << std::left << std::setfill(' ') << std::setw(8) << mnemonic
+					<< std::setw(6) << _opcodeCycles[pi.value].str() << std::right << dec << "(" << where(pi.where) << ")\n";
+			}
+		}
+	}
+
+	if (!logEnabled(LogLevel::MajorTasks))
+		return;
+
+	for (size_t l = 0; l < _labels.size(); l++)
+	{
+		const uint32_t address = _labels[l].first;
+		auto it = _at.find(address);
+		if (it == _at.end())
+			continue;
+
+		// up to the next label (at a higher address)
+		size_t next = l + 1;
+		while (next < _labels.size() && _labels[next].first == address)
+			next++;
+
+		cycleRange section;
+		for (int i = it->second; i < static_cast<int>(_code.size()) && (next == _labels.size() || _code[i].address < _labels[next].first); i++)
+			section.add(_opcodeCycles[_code[i].value]);
+
+		int64_t worst = 0;
+		uint32_t loopAt = 0;
+		const bool bounded = worstCase(address, worst, loopAt);
+
+		logLine out;
+		out << "  " << std::left << std::setfill(' ') << std::setw(16) << _labels[l].second << std::right << " $" << hex4 << address << dec
+			<< " : " << section.str() << " cycles to the next label, worst case ";
+
+		if (bounded)
+			out << worst << " cycles\n";
+		else
+			out << "unbounded (loops or jumps away at $" << hex4 << loopAt << ")\n";
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "architecture.h"
+#include "include.h"
+#include "programrom.h"
+#include "symboltable.h"
+
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The cycles something can take, over every flag state it can run in
+class cycleRange
+{
+public:
+	int64_t min = 0;
+	int64_t max = 0;
+
+	void add(const cycleRange& r) { min += r.min; max += r.max; }
+
+	// "4", or "3-5" when the flags make a difference
+	std::string str() const;
+};
+
+// An instruction as it was encoded, kept for the cycle analysis (see assembler::encodeInstruction)
+class programInstruction
+{
+public:
+	uint32_t address = 0;
+	int value = 0;
+	bool alias = false;
+	uint8_t size = 0;			// opcode and values, in bytes
+	uint8_t targetBytes = 0;	// of the first value (the target of a jump or call), 0 if none
+	sourceLocation where;
+};
+
+// A cycle budget set with .assert_cycles
+class cycleBudget
+{
+public:
+	int symbol = -1;			// interned label name
+	int64_t max = 0;
+	sourceLocation where;
+};
+
+// Static timing of a program, from the microcode of its architecture.
+//
+// An instruction takes the cycles of its opcode up to (and including) the first one that ends the
+// sequence (tcuEndSeq) -- for every flag state, so seq_if branches that end at different cycles
+// give a range. The code is split into basic blocks at labels, jump targets and after every jump,
+// branch and ret, and the cost of each block and of each label (up to the next label) is summed.
+// The worst case of a routine is the longest path from its label to a ret: a call adds the worst
+// case of the routine it calls, and a jmp to itself (the usual halt) ends a path too. A path that
+// can loop, recurse or jump through a register has no static worst case.
+//
+// Control flow is known by mnemonic: call, ret, jmp, and every other mnemonic starting with j is a
+// conditional jump (see config.h).
+class cycleAnalyzer
+{
+public:
+	cycleAnalyzer(const architecture& arch);
+
+	// Cycles of one opcode
+	const cycleRange& opcodeCycles(int value) const { return _opcodeCycles[value]; }
+
+	// Splits the code into blocks (the targets are read from the rom, after the fixups)
+	void analyze(const std::pmr::vector<programInstruction>& code, const programImage& rom, const symbolTable& symbols);
+
+	// Worst case from the instruction at address to the end of its routine -- false if there is
+	// none (or no instruction there), with the address of a block on the loop in loopAt
+	bool worstCase(uint32_t address, int64_t& cycles, uint32_t& loopAt);
+
+	// Logs the cycles of every instruction, block and label
+	void listing(const std::function<std::string(const sourceLocation&)>& where);
+
+	int blockCount() const { return static_cast<int>(_blocks.size()); }
+
+private:
+	enum class Flow : uint8_t { Next, Jump, Branch, Call, Return, Indirect };
+
+	class block
+	{
+	public:
+		int first = 0;				// index into _code
+		int count = 0;
+		cycleRange cycles;			// of its own instructions (not the routines they call)
+		std::vector<int> callees;	// blocks
+		std::vector<int> next;		// blocks control can go to after this one
+		bool indirect = false;		// ends with a jump through a register
+
+		// worst case to the end of the routine (see worstCase)
+		uint8_t state = 0;			// 0 : not visited, 1 : in progress, 2 : done
+		bool bounded = true;
+		int64_t worst = 0;
+		uint32_t loopAt = 0;
+	};
+
+	Flow flowOf(const programInstruction& i) const;
+	uint32_t targetOf(const programInstruction& i, const programImage& rom) const;
+	void solve(int root);
+
+private:
+	const architecture& _arch;
+	std::vector<cycleRange> _opcodeCycles;
+	std::vector<Flow> _opcodeFlow;
+	std::vector<Flow> _aliasFlow;
+
+	// the code in address order, and its blocks
+	std::vector<programInstruction> _code;
+	std::vector<int> _blockOf;				// by instruction
+	std::vector<block> _blocks;
+	std::unordered_map<uint32_t, int> _at;	// instruction by address
+	std::vector<std::pair<uint32_t, std::string_view>> _labels;	// by address
+};
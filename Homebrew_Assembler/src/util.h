@@ -3,8 +3,33 @@
 #include <iomanip>
 #include <bitset>
 #include <climits>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
 
 #define hex8 std::setfill('0') << std::setw(8) << std::hex << std::uppercase
 #define hex4 std::setfill('0') << std::setw(4) << std::hex << std::uppercase
 #define hex2 std::setfill('0') << std::setw(2) << std::hex << std::uppercase
-#define dec std::dec
\ No newline at end of file
+#define dec std::dec
+
+// 64-bit FNV-1a, used for content hashes and fingerprints
+constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+inline uint64_t fnv1a(std::string_view s, uint64_t hash = FNV_OFFSET_BASIS)
+{
+	for (char c : s)
+		hash = (hash ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+
+	return hash;
+}
+
+// Empties a vector that allocates from a memory resource, capacity and all, so it no longer points
+// into the resource (clear() alone keeps the capacity, which an arena release would pull out from
+// under it)
+template <class t>
+void resetVector(std::pmr::vector<t>& v, std::pmr::memory_resource* resource)
+{
+	v = std::pmr::vector<t>(resource);
+}
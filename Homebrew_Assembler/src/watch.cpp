@@ -0,0 +1,81 @@
+#include "watch.h"
+
+#include <chrono>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+void watcher::run()
+{
+	if (_assembler.getIncludes().count() == 0)
+	{
+		LOG(LogLevel::Status) << "Nothing to watch!\n";
+		return;
+	}
+
+	snapshot();
+	LOG(LogLevel::Status) << "\nWatching " << _assembler.getIncludes().count() << " files for changes (Ctrl+C to stop)...\n";
+
+	for (;;)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(_interval));
+
+		std::vector<int> changed = poll();
+		if (changed.empty())
+			continue;
+
+		for (int id : changed)
+			LOG(LogLevel::Status) << "\nChanged : " << _assembler.getIncludes().name(id) << "\n";
+
+		auto start = std::chrono::steady_clock::now();
+
+		try
+		{
+			bool rebuilt = _assembler.reassemble(changed);
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			LOG(LogLevel::Status) << "Reassembled in " << elapsed.count() << " ms (" << changed.size() << " file(s) lexed, architecture "
+				<< (rebuilt ? "rebuilt" : "reused") << ")\n";
+		}
+		catch (const std::exception& e)
+		{
+			LOG(LogLevel::Status) << "Fatal error: " << e.what() << "\n";
+		}
+
+		// a rebuild may have pulled in new include files
+		snapshot();
+	}
+}
+
+void watcher::snapshot()
+{
+	const includeCache& includes = _assembler.getIncludes();
+
+	_times.resize(includes.count());
+	for (int id = 0; id < includes.count(); id++)
+	{
+		std::error_code ec;
+		_times[id] = fs::last_write_time(includes.name(id), ec);
+	}
+}
+
+std::vector<int> watcher::poll()
+{
+	const includeCache& includes = _assembler.getIncludes();
+
+	std::vector<int> changed;
+	for (int id = 0; id < static_cast<int>(_times.size()); id++)
+	{
+		std::error_code ec;
+		fs::file_time_type t = fs::last_write_time(includes.name(id), ec);
+
+		// files that are mid-save (or were removed) are picked up on a later poll
+		if (!ec && t != _times[id])
+		{
+			_times[id] = t;
+			changed.push_back(id);
+		}
+	}
+
+	return changed;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "assembler.h"
+
+#include <filesystem>
+#include <vector>
+
+// Watch mode: keeps an assembler (and everything it has parsed) alive and reassembles
+// incrementally whenever one of its source files changes on disk.
+class watcher
+{
+public:
+	watcher(assembler& a, int intervalMs = WATCH_INTERVAL_MS)
+		:
+		_assembler(a),
+		_interval(intervalMs)
+	{}
+
+	// Poll forever
+	void run();
+
+private:
+	void snapshot();
+	std::vector<int> poll();
+
+private:
+	assembler& _assembler;
+	int _interval;
+	std::vector<std::filesystem::file_time_type> _times;
+};